@@ -0,0 +1,355 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <math.h>
+
+#include "gstaudiokernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS 1
+#include <immintrin.h>
+#define GST_TARGET(t) __attribute__ ((target (t)))
+#elif defined(__aarch64__)
+#define HAVE_NEON_KERNELS 1
+#include <arm_neon.h>
+#endif
+
+/* Portable kernels, also used for the tail the vector loops leave */
+
+static void
+gain_s16_c (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gint16 *s = samples;
+  gfloat g = (gfloat) gain;
+  gsize i;
+
+  for (i = 0; i < n_samples; i++) {
+    gfloat v = CLAMP (s[i] * g, (gfloat) G_MININT16, (gfloat) G_MAXINT16);
+
+    s[i] = (gint16) lrintf (v);
+  }
+}
+
+static void
+gain_s32_c (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gint32 *s = samples;
+  gsize i;
+
+  /* doubles hold every 32 bit sample exactly */
+  for (i = 0; i < n_samples; i++) {
+    gdouble v = CLAMP (s[i] * gain, (gdouble) G_MININT32,
+        (gdouble) G_MAXINT32);
+
+    s[i] = (gint32) lrint (v);
+  }
+}
+
+static void
+gain_f32_c (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gfloat *s = samples;
+  gfloat g = (gfloat) gain;
+  gsize i;
+
+  for (i = 0; i < n_samples; i++)
+    s[i] *= g;
+}
+
+#ifdef HAVE_X86_KERNELS
+
+GST_TARGET ("sse2")
+static void
+gain_s16_sse2 (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gint16 *s = samples;
+  __m128 g = _mm_set1_ps ((gfloat) gain);
+  __m128 min = _mm_set1_ps (G_MININT16);
+  __m128 max = _mm_set1_ps (G_MAXINT16);
+  gsize i;
+
+  /* clamped before converting, a huge gain would overflow int32 */
+  for (i = 0; i + 8 <= n_samples; i += 8) {
+    __m128i x = _mm_loadu_si128 ((const __m128i *) (s + i));
+    /* sign extend by putting each sample in the high half */
+    __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (x, x), 16);
+    __m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (x, x), 16);
+
+    lo = _mm_cvtps_epi32 (_mm_min_ps (_mm_max_ps (_mm_mul_ps
+                (_mm_cvtepi32_ps (lo), g), min), max));
+    hi = _mm_cvtps_epi32 (_mm_min_ps (_mm_max_ps (_mm_mul_ps
+                (_mm_cvtepi32_ps (hi), g), min), max));
+    _mm_storeu_si128 ((__m128i *) (s + i), _mm_packs_epi32 (lo, hi));
+  }
+  gain_s16_c (s + i, n_samples - i, gain);
+}
+
+GST_TARGET ("sse2")
+static void
+gain_s32_sse2 (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gint32 *s = samples;
+  __m128d g = _mm_set1_pd (gain);
+  __m128d min = _mm_set1_pd ((gdouble) G_MININT32);
+  __m128d max = _mm_set1_pd ((gdouble) G_MAXINT32);
+  gsize i;
+
+  for (i = 0; i + 4 <= n_samples; i += 4) {
+    __m128i x = _mm_loadu_si128 ((const __m128i *) (s + i));
+    __m128d lo = _mm_cvtepi32_pd (x);
+    __m128d hi = _mm_cvtepi32_pd (_mm_srli_si128 (x, 8));
+
+    lo = _mm_min_pd (_mm_max_pd (_mm_mul_pd (lo, g), min), max);
+    hi = _mm_min_pd (_mm_max_pd (_mm_mul_pd (hi, g), min), max);
+    _mm_storeu_si128 ((__m128i *) (s + i),
+        _mm_unpacklo_epi64 (_mm_cvtpd_epi32 (lo), _mm_cvtpd_epi32 (hi)));
+  }
+  gain_s32_c (s + i, n_samples - i, gain);
+}
+
+GST_TARGET ("sse2")
+static void
+gain_f32_sse2 (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gfloat *s = samples;
+  __m128 g = _mm_set1_ps ((gfloat) gain);
+  gsize i;
+
+  for (i = 0; i + 4 <= n_samples; i += 4)
+    _mm_storeu_ps (s + i, _mm_mul_ps (_mm_loadu_ps (s + i), g));
+  gain_f32_c (s + i, n_samples - i, gain);
+}
+
+GST_TARGET ("avx2")
+static void
+gain_s16_avx2 (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gint16 *s = samples;
+  __m256 g = _mm256_set1_ps ((gfloat) gain);
+  __m256 min = _mm256_set1_ps (G_MININT16);
+  __m256 max = _mm256_set1_ps (G_MAXINT16);
+  gsize i;
+
+  for (i = 0; i + 16 <= n_samples; i += 16) {
+    __m256i x = _mm256_loadu_si256 ((const __m256i *) (s + i));
+    __m256i lo = _mm256_cvtepi16_epi32 (_mm256_castsi256_si128 (x));
+    __m256i hi = _mm256_cvtepi16_epi32 (_mm256_extracti128_si256 (x, 1));
+
+    lo = _mm256_cvtps_epi32 (_mm256_min_ps (_mm256_max_ps (_mm256_mul_ps
+                (_mm256_cvtepi32_ps (lo), g), min), max));
+    hi = _mm256_cvtps_epi32 (_mm256_min_ps (_mm256_max_ps (_mm256_mul_ps
+                (_mm256_cvtepi32_ps (hi), g), min), max));
+    /* packs works per 128 bit lane, put the quarters back in order */
+    x = _mm256_permute4x64_epi64 (_mm256_packs_epi32 (lo, hi), 0xd8);
+    _mm256_storeu_si256 ((__m256i *) (s + i), x);
+  }
+  gain_s16_sse2 (s + i, n_samples - i, gain);
+}
+
+GST_TARGET ("avx2")
+static void
+gain_s32_avx2 (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gint32 *s = samples;
+  __m256d g = _mm256_set1_pd (gain);
+  __m256d min = _mm256_set1_pd ((gdouble) G_MININT32);
+  __m256d max = _mm256_set1_pd ((gdouble) G_MAXINT32);
+  gsize i;
+
+  for (i = 0; i + 8 <= n_samples; i += 8) {
+    __m256i x = _mm256_loadu_si256 ((const __m256i *) (s + i));
+    __m256d lo = _mm256_cvtepi32_pd (_mm256_castsi256_si128 (x));
+    __m256d hi = _mm256_cvtepi32_pd (_mm256_extracti128_si256 (x, 1));
+
+    lo = _mm256_min_pd (_mm256_max_pd (_mm256_mul_pd (lo, g), min), max);
+    hi = _mm256_min_pd (_mm256_max_pd (_mm256_mul_pd (hi, g), min), max);
+    x = _mm256_set_m128i (_mm256_cvtpd_epi32 (hi), _mm256_cvtpd_epi32 (lo));
+    _mm256_storeu_si256 ((__m256i *) (s + i), x);
+  }
+  gain_s32_sse2 (s + i, n_samples - i, gain);
+}
+
+GST_TARGET ("avx2")
+static void
+gain_f32_avx2 (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gfloat *s = samples;
+  __m256 g = _mm256_set1_ps ((gfloat) gain);
+  gsize i;
+
+  for (i = 0; i + 8 <= n_samples; i += 8)
+    _mm256_storeu_ps (s + i, _mm256_mul_ps (_mm256_loadu_ps (s + i), g));
+  gain_f32_sse2 (s + i, n_samples - i, gain);
+}
+
+#endif /* HAVE_X86_KERNELS */
+
+#ifdef HAVE_NEON_KERNELS
+
+static void
+gain_s16_neon (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gint16 *s = samples;
+  float32x4_t g = vdupq_n_f32 ((gfloat) gain);
+  gsize i;
+
+  for (i = 0; i + 8 <= n_samples; i += 8) {
+    int16x8_t x = vld1q_s16 (s + i);
+    float32x4_t lo = vcvtq_f32_s32 (vmovl_s16 (vget_low_s16 (x)));
+    float32x4_t hi = vcvtq_f32_s32 (vmovl_s16 (vget_high_s16 (x)));
+
+    lo = vmulq_f32 (lo, g);
+    hi = vmulq_f32 (hi, g);
+    vst1q_s16 (s + i, vcombine_s16 (vqmovn_s32 (vcvtnq_s32_f32 (lo)),
+            vqmovn_s32 (vcvtnq_s32_f32 (hi))));
+  }
+  gain_s16_c (s + i, n_samples - i, gain);
+}
+
+static void
+gain_s32_neon (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gint32 *s = samples;
+  float64x2_t g = vdupq_n_f64 (gain);
+  gsize i;
+
+  for (i = 0; i + 4 <= n_samples; i += 4) {
+    int32x4_t x = vld1q_s32 (s + i);
+    float64x2_t lo = vcvtq_f64_s64 (vmovl_s32 (vget_low_s32 (x)));
+    float64x2_t hi = vcvtq_f64_s64 (vmovl_s32 (vget_high_s32 (x)));
+
+    /* the saturating narrow does the clamping */
+    lo = vmulq_f64 (lo, g);
+    hi = vmulq_f64 (hi, g);
+    vst1q_s32 (s + i, vcombine_s32 (vqmovn_s64 (vcvtnq_s64_f64 (lo)),
+            vqmovn_s64 (vcvtnq_s64_f64 (hi))));
+  }
+  gain_s32_c (s + i, n_samples - i, gain);
+}
+
+static void
+gain_f32_neon (gpointer samples, gsize n_samples, gdouble gain)
+{
+  gfloat *s = samples;
+  float32x4_t g = vdupq_n_f32 ((gfloat) gain);
+  gsize i;
+
+  for (i = 0; i + 4 <= n_samples; i += 4)
+    vst1q_f32 (s + i, vmulq_f32 (vld1q_f32 (s + i), g));
+  gain_f32_c (s + i, n_samples - i, gain);
+}
+
+#endif /* HAVE_NEON_KERNELS */
+
+typedef struct
+{
+  const gchar *name;
+  GstAudioGainFunc s16;
+  GstAudioGainFunc s32;
+  GstAudioGainFunc f32;
+} GstAudioKernels;
+
+static const GstAudioKernels *
+gst_audio_kernels_get (void)
+{
+  static const GstAudioKernels c = { "c", gain_s16_c, gain_s32_c, gain_f32_c };
+#ifdef HAVE_X86_KERNELS
+  static const GstAudioKernels sse2 = { "sse2", gain_s16_sse2, gain_s32_sse2,
+    gain_f32_sse2
+  };
+  static const GstAudioKernels avx2 = { "avx2", gain_s16_avx2, gain_s32_avx2,
+    gain_f32_avx2
+  };
+#endif
+#ifdef HAVE_NEON_KERNELS
+  static const GstAudioKernels neon = { "neon", gain_s16_neon, gain_s32_neon,
+    gain_f32_neon
+  };
+#endif
+  static const GstAudioKernels *kernels = NULL;
+
+  if (g_once_init_enter (&kernels)) {
+    const GstAudioKernels *k = &c;
+
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+      k = &avx2;
+    else if (__builtin_cpu_supports ("sse2"))
+      k = &sse2;
+#endif
+#ifdef HAVE_NEON_KERNELS
+    k = &neon;
+#endif
+    g_once_init_leave (&kernels, k);
+  }
+
+  return kernels;
+}
+
+GstAudioGainFunc
+gst_audio_kernels_get_gain (GstAudioFormat format)
+{
+  const GstAudioKernels *k = gst_audio_kernels_get ();
+
+  switch (format) {
+    case GST_AUDIO_FORMAT_S16:
+      return k->s16;
+    case GST_AUDIO_FORMAT_S32:
+      return k->s32;
+    case GST_AUDIO_FORMAT_F32:
+      return k->f32;
+    default:
+      return NULL;
+  }
+}
+
+const gchar *
+gst_audio_kernels_get_name (void)
+{
+  return gst_audio_kernels_get ()->name;
+}
@@ -0,0 +1,351 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE
+#endif
+
+#include "gstgzaffinity.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* from <numaif.h>, to not need libnuma for a few syscalls */
+#define GZ_MPOL_PREFERRED 1
+/* MAX_NUMNODES of the largest kernel configs, get_mempolicy wants a mask
+ * at least that long */
+#define GZ_NODE_MASK_BITS 1024
+
+typedef gulong GstGzNodeMask[GZ_NODE_MASK_BITS / (8 * sizeof (gulong))];
+
+struct _GstGzAffinity
+{
+  cpu_set_t cpus;
+  gint numa_node;
+};
+
+struct _GstGzAffinitySaved
+{
+  gboolean have_cpus;
+  cpu_set_t cpus;
+  gboolean have_policy;
+  int policy;
+  GstGzNodeMask nodes;
+};
+
+static gboolean
+gst_gz_affinity_node_mask (gint numa_node, GstGzNodeMask mask)
+{
+  guint bits = 8 * sizeof (gulong);
+
+  memset (mask, 0, sizeof (GstGzNodeMask));
+  if (numa_node < 0 || (guint) numa_node >= GZ_NODE_MASK_BITS)
+    return FALSE;
+  mask[numa_node / bits] |= 1UL << (numa_node % bits);
+
+  return TRUE;
+}
+
+/* adds a list like "0-3,8,10-11" to set */
+static gboolean
+gst_gz_affinity_parse (const gchar * list, cpu_set_t * set)
+{
+  const gchar *p = list;
+
+  while (*p) {
+    gchar *end;
+    guint64 first, last;
+
+    first = g_ascii_strtoull (p, &end, 10);
+    if (end == p)
+      return FALSE;
+    last = first;
+    p = end;
+    if (*p == '-') {
+      p++;
+      last = g_ascii_strtoull (p, &end, 10);
+      if (end == p || last < first)
+        return FALSE;
+      p = end;
+    }
+    if (last >= CPU_SETSIZE)
+      return FALSE;
+    for (; first <= last; first++)
+      CPU_SET (first, set);
+
+    while (*p == ' ' || *p == '\n')
+      p++;
+    if (*p == ',')
+      p++;
+    else if (*p)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+GstGzAffinity *
+gst_gz_affinity_new (const gchar * cpu_set, gint numa_node, GError ** error)
+{
+  GstGzAffinity *affinity = g_new0 (GstGzAffinity, 1);
+  cpu_set_t set;
+
+  CPU_ZERO (&affinity->cpus);
+  affinity->numa_node = numa_node;
+
+  if (cpu_set && !gst_gz_affinity_parse (cpu_set, &affinity->cpus)) {
+    g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS,
+        "invalid CPU list \"%s\"", cpu_set);
+    goto failed;
+  }
+
+  if (numa_node >= 0) {
+    gchar *path, *list = NULL;
+    GError *err = NULL;
+
+    path = g_strdup_printf ("/sys/devices/system/node/node%d/cpulist",
+        numa_node);
+    if (!g_file_get_contents (path, &list, NULL, &err)) {
+      g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_NOT_FOUND,
+          "no NUMA node %d: %s", numa_node, err->message);
+      g_clear_error (&err);
+      g_free (path);
+      goto failed;
+    }
+    g_free (path);
+
+    CPU_ZERO (&set);
+    g_strstrip (list);
+    if (!gst_gz_affinity_parse (list, &set)) {
+      g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS,
+          "unexpected CPU list \"%s\" for NUMA node %d", list, numa_node);
+      g_free (list);
+      goto failed;
+    }
+    g_free (list);
+
+    if (cpu_set)
+      CPU_AND (&affinity->cpus, &affinity->cpus, &set);
+    else
+      affinity->cpus = set;
+  }
+
+  if (CPU_COUNT (&affinity->cpus) == 0) {
+    g_set_error (error, GST_RESOURCE_ERROR, GST_RESOURCE_ERROR_SETTINGS,
+        "no CPUs left to run on");
+    goto failed;
+  }
+
+  return affinity;
+
+failed:
+  g_free (affinity);
+  return NULL;
+}
+
+void
+gst_gz_affinity_free (GstGzAffinity * affinity)
+{
+  g_free (affinity);
+}
+
+gint
+gst_gz_affinity_get_numa_node (const GstGzAffinity * affinity)
+{
+  return affinity ? affinity->numa_node : -1;
+}
+
+gboolean
+gst_gz_affinity_apply (const GstGzAffinity * affinity)
+{
+  gboolean ret = TRUE;
+
+  if (pthread_setaffinity_np (pthread_self (), sizeof (affinity->cpus),
+          &affinity->cpus) != 0)
+    ret = FALSE;
+
+#ifdef SYS_set_mempolicy
+  /* pages the thread touches first, its output buffers and the inflate
+   * window, come from the node while it has any free */
+  if (affinity->numa_node >= 0) {
+    GstGzNodeMask mask;
+
+    if (gst_gz_affinity_node_mask (affinity->numa_node, mask) &&
+        syscall (SYS_set_mempolicy, GZ_MPOL_PREFERRED, mask,
+            GZ_NODE_MASK_BITS + 1) != 0)
+      ret = FALSE;
+  }
+#endif
+
+  return ret;
+}
+
+gboolean
+gst_gz_affinity_bind (const GstGzAffinity * affinity,
+    GstGzAffinitySaved ** saved)
+{
+  GstGzAffinitySaved *s = g_new0 (GstGzAffinitySaved, 1);
+
+  s->have_cpus = pthread_getaffinity_np (pthread_self (), sizeof (s->cpus),
+      &s->cpus) == 0;
+#ifdef SYS_get_mempolicy
+  if (affinity->numa_node >= 0)
+    s->have_policy = syscall (SYS_get_mempolicy, &s->policy, s->nodes,
+        GZ_NODE_MASK_BITS + 1, NULL, 0) == 0;
+#endif
+  *saved = s;
+
+  /* without a way back the thread is left alone */
+  if (!s->have_cpus || (affinity->numa_node >= 0 && !s->have_policy))
+    return FALSE;
+
+  return gst_gz_affinity_apply (affinity);
+}
+
+void
+gst_gz_affinity_restore (GstGzAffinitySaved * saved)
+{
+  if (saved->have_cpus)
+    pthread_setaffinity_np (pthread_self (), sizeof (saved->cpus),
+        &saved->cpus);
+#ifdef SYS_set_mempolicy
+  if (saved->have_policy)
+    syscall (SYS_set_mempolicy, saved->policy, saved->nodes,
+        GZ_NODE_MASK_BITS + 1);
+#endif
+  g_free (saved);
+}
+
+gboolean
+gst_gz_affinity_bind_memory (gpointer mem, gsize size, gint numa_node)
+{
+#ifdef SYS_mbind
+  GstGzNodeMask mask;
+
+  if (!gst_gz_affinity_node_mask (numa_node, mask))
+    return FALSE;
+
+  return syscall (SYS_mbind, mem, size, GZ_MPOL_PREFERRED, mask,
+      GZ_NODE_MASK_BITS + 1, 0) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+#else /* !__linux__ */
+
+/* Elsewhere there are no CPU lists or NUMA nodes to read, nor the calls to
+ * bind threads and memory. The numa-node is still kept, so the pools stay
+ * keyed by it, and binding fails without touching the thread. */
+
+struct _GstGzAffinity
+{
+  gint numa_node;
+};
+
+struct _GstGzAffinitySaved
+{
+  gint unused;
+};
+
+GstGzAffinity *
+gst_gz_affinity_new (const gchar * cpu_set, gint numa_node, GError ** error)
+{
+  GstGzAffinity *affinity = g_new0 (GstGzAffinity, 1);
+
+  affinity->numa_node = numa_node;
+
+  return affinity;
+}
+
+void
+gst_gz_affinity_free (GstGzAffinity * affinity)
+{
+  g_free (affinity);
+}
+
+gint
+gst_gz_affinity_get_numa_node (const GstGzAffinity * affinity)
+{
+  return affinity ? affinity->numa_node : -1;
+}
+
+gboolean
+gst_gz_affinity_apply (const GstGzAffinity * affinity)
+{
+  return FALSE;
+}
+
+gboolean
+gst_gz_affinity_bind (const GstGzAffinity * affinity,
+    GstGzAffinitySaved ** saved)
+{
+  *saved = g_new0 (GstGzAffinitySaved, 1);
+
+  return FALSE;
+}
+
+void
+gst_gz_affinity_restore (GstGzAffinitySaved * saved)
+{
+  g_free (saved);
+}
+
+gboolean
+gst_gz_affinity_bind_memory (gpointer mem, gsize size, gint numa_node)
+{
+  return FALSE;
+}
+
+#endif /* __linux__ */
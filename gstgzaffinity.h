@@ -0,0 +1,86 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_AFFINITY_H__
+#define __GST_GZ_AFFINITY_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* CPUs, and optionally the NUMA node to take memory from, that decoding
+ * threads are kept on. Only Linux binds anything, elsewhere binding
+ * reports failure and leaves threads and memory alone. */
+typedef struct _GstGzAffinity GstGzAffinity;
+
+/* cpu_set is a list like "0-7,16-23" and numa_node -1 for none. With both
+ * the threads run on the CPUs of the node that are also in the list. */
+GstGzAffinity * gst_gz_affinity_new (const gchar * cpu_set, gint numa_node,
+    GError ** error);
+void gst_gz_affinity_free (GstGzAffinity * affinity);
+
+/* -1 for none, or when affinity is NULL */
+gint gst_gz_affinity_get_numa_node (const GstGzAffinity * affinity);
+
+/* binds the calling thread, and makes its allocations prefer the node.
+ * For threads that are ours for good. */
+gboolean gst_gz_affinity_apply (const GstGzAffinity * affinity);
+
+/* What a borrowed thread (a GstTaskPool one) had before it was bound.
+ * gst_gz_affinity_bind() always sets *saved, also when it fails, and
+ * gst_gz_affinity_restore() has to run on the same thread before it is
+ * handed back. */
+typedef struct _GstGzAffinitySaved GstGzAffinitySaved;
+
+gboolean gst_gz_affinity_bind (const GstGzAffinity * affinity,
+    GstGzAffinitySaved ** saved);
+void gst_gz_affinity_restore (GstGzAffinitySaved * saved);
+
+/* places the not yet touched pages of mem on the node, whichever thread
+ * touches them first */
+gboolean gst_gz_affinity_bind_memory (gpointer mem, gsize size,
+    gint numa_node);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_AFFINITY_H__ */
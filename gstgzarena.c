@@ -0,0 +1,279 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "gstgzaffinity.h"
+#include "gstgzarena.h"
+
+/* one slot holds zlib's inflate state and 32 KiB window with room to
+ * spare, a chunk of slots is one huge page */
+#define GZ_ARENA_SLOT_SIZE (64 * 1024)
+#define GZ_ARENA_CHUNK_SIZE (2 * 1024 * 1024)
+#define GZ_ARENA_SLOTS (GZ_ARENA_CHUNK_SIZE / GZ_ARENA_SLOT_SIZE)
+#define GZ_ARENA_ALIGN 64
+
+typedef struct _GstGzArenaChunk GstGzArenaChunk;
+
+struct _GstGzArenaChunk
+{
+  guint8 *base;
+  gpointer mem;                 /* what base was cut from, without mmap */
+  guint32 used;                 /* bit per slot */
+  gint numa_node;               /* -1 when first touch decides */
+};
+
+/* sits right in front of every block, one cache line so the block after
+ * it stays aligned */
+typedef union
+{
+  struct
+  {
+    gsize size;
+    gboolean in_use;
+    /* NULL inside a slot, else the allocation the block was aligned in */
+    gpointer heap;
+  } h;
+  guint8 pad[GZ_ARENA_ALIGN];
+} GstGzArenaBlock;
+
+struct _GstGzArena
+{
+  GstGzArenaChunk *chunk;
+  guint slot;
+  guint8 *base;
+  gsize used;
+};
+
+static GMutex arena_lock;
+static GPtrArray *arena_chunks = NULL;
+
+/* room for size bytes aligned to align, the start to free goes to mem */
+static gpointer
+gst_gz_arena_alloc_aligned (gsize size, gsize align, gpointer * mem)
+{
+  *mem = g_try_malloc (size + align - 1);
+  if (!*mem)
+    return NULL;
+
+  return (gpointer) (((guintptr) * mem + align - 1) & ~((guintptr) align - 1));
+}
+
+static GstGzArenaChunk *
+gst_gz_arena_chunk_new (gint numa_node)
+{
+  GstGzArenaChunk *chunk;
+  gpointer mem = NULL;
+  void *base;
+
+#ifdef __linux__
+  /* twice the size, to cut out a huge page aligned chunk */
+  base = mmap (NULL, 2 * GZ_ARENA_CHUNK_SIZE, PROT_READ | PROT_WRITE,
+      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  {
+    guintptr start = (guintptr) base;
+    guintptr aligned = (start + GZ_ARENA_CHUNK_SIZE - 1) &
+        ~((guintptr) GZ_ARENA_CHUNK_SIZE - 1);
+
+    if (aligned > start)
+      munmap (base, aligned - start);
+    munmap ((void *) (aligned + GZ_ARENA_CHUNK_SIZE),
+        start + 2 * GZ_ARENA_CHUNK_SIZE - aligned - GZ_ARENA_CHUNK_SIZE);
+    base = (void *) aligned;
+  }
+
+  /* only a hint. Pages are placed on first touch, which for the window is
+   * the first inflate() on the streaming thread, unless a node was asked
+   * for: then slots handed out again later stay on it too. */
+#ifdef MADV_HUGEPAGE
+  madvise (base, GZ_ARENA_CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+  if (numa_node >= 0)
+    gst_gz_affinity_bind_memory (base, GZ_ARENA_CHUNK_SIZE, numa_node);
+#else
+  /* no huge pages or page placement, just one block of the heap */
+  base = gst_gz_arena_alloc_aligned (GZ_ARENA_CHUNK_SIZE, GZ_ARENA_ALIGN,
+      &mem);
+  if (!base)
+    return NULL;
+#endif
+
+  chunk = g_new0 (GstGzArenaChunk, 1);
+  chunk->base = base;
+  chunk->mem = mem;
+  chunk->numa_node = numa_node;
+
+  return chunk;
+}
+
+GstGzArena *
+gst_gz_arena_new (gint numa_node)
+{
+  GstGzArenaChunk *chunk = NULL;
+  GstGzArena *arena;
+  guint i, slot = 0;
+
+  g_mutex_lock (&arena_lock);
+  if (!arena_chunks)
+    arena_chunks = g_ptr_array_new ();
+
+  for (i = 0; i < arena_chunks->len && !chunk; i++) {
+    GstGzArenaChunk *c = g_ptr_array_index (arena_chunks, i);
+
+    if (c->used != G_MAXUINT32 && c->numa_node == numa_node)
+      chunk = c;
+  }
+  if (!chunk) {
+    chunk = gst_gz_arena_chunk_new (numa_node);
+    if (chunk)
+      g_ptr_array_add (arena_chunks, chunk);
+  }
+  if (chunk) {
+    while (chunk->used & (1u << slot))
+      slot++;
+    chunk->used |= 1u << slot;
+  }
+  g_mutex_unlock (&arena_lock);
+
+  if (!chunk)
+    return NULL;
+
+  arena = g_new0 (GstGzArena, 1);
+  arena->chunk = chunk;
+  arena->slot = slot;
+  arena->base = chunk->base + slot * GZ_ARENA_SLOT_SIZE;
+  arena->used = 0;
+
+  return arena;
+}
+
+void
+gst_gz_arena_free (GstGzArena * arena)
+{
+  GstGzArenaChunk *chunk = arena->chunk;
+
+  g_mutex_lock (&arena_lock);
+  chunk->used &= ~(1u << arena->slot);
+  /* keep one chunk around for the next stream */
+  if (chunk->used == 0 && arena_chunks->len > 1) {
+    g_ptr_array_remove_fast (arena_chunks, chunk);
+#ifdef __linux__
+    munmap (chunk->base, GZ_ARENA_CHUNK_SIZE);
+#else
+    g_free (chunk->mem);
+#endif
+    g_free (chunk);
+  }
+  g_mutex_unlock (&arena_lock);
+
+  g_free (arena);
+}
+
+gint
+gst_gz_arena_get_numa_node (GstGzArena * arena)
+{
+  return arena->chunk->numa_node;
+}
+
+voidpf
+gst_gz_arena_zalloc (voidpf opaque, uInt items, uInt size)
+{
+  GstGzArena *arena = opaque;
+  GstGzArenaBlock *block;
+  gpointer mem;
+  gsize n, pos;
+
+  if (size != 0 && items > (G_MAXSIZE - 2 * GZ_ARENA_ALIGN) / size)
+    return Z_NULL;
+  n = ((gsize) items * size + GZ_ARENA_ALIGN - 1) & ~(gsize) (GZ_ARENA_ALIGN - 1);
+
+  /* a freed block that is big enough */
+  for (pos = 0; pos < arena->used; pos += sizeof (GstGzArenaBlock) +
+      block->h.size) {
+    block = (GstGzArenaBlock *) (arena->base + pos);
+    if (!block->h.in_use && block->h.size >= n) {
+      block->h.in_use = TRUE;
+      return block + 1;
+    }
+  }
+
+  if (arena->used + sizeof (GstGzArenaBlock) + n <= GZ_ARENA_SLOT_SIZE) {
+    block = (GstGzArenaBlock *) (arena->base + arena->used);
+    block->h.size = n;
+    block->h.in_use = TRUE;
+    block->h.heap = NULL;
+    arena->used += sizeof (GstGzArenaBlock) + n;
+    return block + 1;
+  }
+
+  block = gst_gz_arena_alloc_aligned (sizeof (GstGzArenaBlock) + n,
+      GZ_ARENA_ALIGN, &mem);
+  if (!block)
+    return Z_NULL;
+  block->h.size = n;
+  block->h.in_use = TRUE;
+  block->h.heap = mem;
+
+  return block + 1;
+}
+
+void
+gst_gz_arena_zfree (voidpf opaque, voidpf address)
+{
+  GstGzArenaBlock *block = (GstGzArenaBlock *) address - 1;
+
+  if (block->h.heap)
+    g_free (block->h.heap);
+  else
+    block->h.in_use = FALSE;
+}
@@ -0,0 +1,75 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_ARENA_H__
+#define __GST_GZ_ARENA_H__
+
+#include <gst/gst.h>
+#include <zlib.h>
+
+G_BEGIN_DECLS
+
+/* Memory for the internals of one inflate state, its state struct and
+ * window, given to zlib through zalloc/zfree. Each arena is a slot out of
+ * large chunks that are hinted to be backed by huge pages. Blocks are
+ * cache-line aligned, and a block freed by zlib is handed out again for a
+ * request of the same size or smaller, so resets that drop and reallocate
+ * the window stay inside the slot. Requests that do not fit fall back to
+ * the heap. */
+typedef struct _GstGzArena GstGzArena;
+
+/* numa_node >= 0 places the arena's memory on that node, -1 leaves it to
+ * the first thread touching it */
+GstGzArena * gst_gz_arena_new (gint numa_node);
+/* every block must have been freed through zfree */
+void gst_gz_arena_free (GstGzArena * arena);
+/* the numa_node the arena was made for */
+gint gst_gz_arena_get_numa_node (GstGzArena * arena);
+
+/* zalloc and zfree for a z_stream with the arena as opaque */
+voidpf gst_gz_arena_zalloc (voidpf opaque, uInt items, uInt size);
+void gst_gz_arena_zfree (voidpf opaque, voidpf address);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_ARENA_H__ */
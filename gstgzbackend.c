@@ -0,0 +1,346 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <errno.h>
+
+#include <glib/gstdio.h>
+
+#include "gstgzarena.h"
+#include "gstgzbackend.h"
+
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#elif defined (HAVE_ISAL)
+#include <isa-l/igzip_lib.h>
+#endif
+
+struct _GstGzMemberDecoder
+{
+#ifdef HAVE_LIBDEFLATE
+  struct libdeflate_decompressor *decompressor;
+#elif defined (HAVE_ISAL)
+  struct inflate_state *isal;
+#else
+  z_stream *stream;
+#endif
+};
+
+/* idle inflate states, beyond this many they are freed on release */
+#define GZ_INFLATE_POOL_MAX 16
+
+static GMutex inflate_pool_lock;
+static GQueue inflate_pool = G_QUEUE_INIT;
+
+typedef struct
+{
+  GBytes *bytes;
+  gint64 mtime;
+  goffset size;
+} GstGzDictionary;
+
+static GMutex dictionary_lock;
+/* location -> GstGzDictionary */
+static GHashTable *dictionaries = NULL;
+
+const gchar *
+gst_gz_backend_get_name (void)
+{
+  static gchar *name = NULL;
+
+  if (g_once_init_enter (&name)) {
+    const gchar *stream_name;
+    gchar *tmp;
+
+#ifdef ZLIBNG_VERSION
+    stream_name = "zlib-ng " ZLIBNG_VERSION;
+#else
+    stream_name = "zlib " ZLIB_VERSION;
+#endif
+
+#ifdef HAVE_LIBDEFLATE
+    tmp = g_strdup_printf ("%s, libdeflate %s for whole members", stream_name,
+        LIBDEFLATE_VERSION_STRING);
+#elif defined (HAVE_ISAL)
+    tmp = g_strdup_printf ("%s, ISA-L for whole members", stream_name);
+#else
+    tmp = g_strdup (stream_name);
+#endif
+    g_once_init_leave (&name, tmp);
+  }
+
+  return name;
+}
+
+static void
+gst_gz_inflate_free (z_stream * stream)
+{
+  GstGzArena *arena = stream->zalloc == gst_gz_arena_zalloc ?
+      stream->opaque : NULL;
+
+  (void) inflateEnd (stream);
+  if (arena)
+    gst_gz_arena_free (arena);
+  g_free (stream);
+}
+
+static gint
+gst_gz_inflate_get_numa_node (z_stream * stream)
+{
+  if (stream->zalloc != gst_gz_arena_zalloc)
+    return -1;
+
+  return gst_gz_arena_get_numa_node (stream->opaque);
+}
+
+z_stream *
+gst_gz_inflate_acquire (gint window_bits, gint numa_node)
+{
+  z_stream *stream = NULL;
+  GList *l;
+
+  /* only a state whose window is on the node asked for */
+  g_mutex_lock (&inflate_pool_lock);
+  for (l = inflate_pool.head; l; l = l->next) {
+    if (gst_gz_inflate_get_numa_node (l->data) == numa_node) {
+      stream = l->data;
+      g_queue_delete_link (&inflate_pool, l);
+      break;
+    }
+  }
+  g_mutex_unlock (&inflate_pool_lock);
+
+  /* a reset keeps the window as long as its size stays the same */
+  if (stream) {
+    if (inflateReset2 (stream, window_bits) == Z_OK)
+      return stream;
+    gst_gz_inflate_free (stream);
+  }
+
+  /* zlib's state and window come from an arena of their own, or from the
+   * heap if no arena could be mapped */
+  stream = g_new0 (z_stream, 1);
+  stream->opaque = gst_gz_arena_new (numa_node);
+  if (stream->opaque) {
+    stream->zalloc = gst_gz_arena_zalloc;
+    stream->zfree = gst_gz_arena_zfree;
+  }
+  if (inflateInit2 (stream, window_bits) != Z_OK) {
+    if (stream->opaque)
+      gst_gz_arena_free (stream->opaque);
+    g_free (stream);
+    return NULL;
+  }
+
+  return stream;
+}
+
+void
+gst_gz_inflate_release (z_stream * stream)
+{
+  if (!stream)
+    return;
+
+  /* the user's buffers must not be referenced from the pool */
+  stream->next_in = Z_NULL;
+  stream->avail_in = 0;
+  stream->next_out = Z_NULL;
+  stream->avail_out = 0;
+
+  g_mutex_lock (&inflate_pool_lock);
+  if (inflate_pool.length < GZ_INFLATE_POOL_MAX) {
+    g_queue_push_head (&inflate_pool, stream);
+    stream = NULL;
+  }
+  g_mutex_unlock (&inflate_pool_lock);
+
+  if (stream)
+    gst_gz_inflate_free (stream);
+}
+
+static void
+gst_gz_dictionary_free (GstGzDictionary * dict)
+{
+  g_bytes_unref (dict->bytes);
+  g_free (dict);
+}
+
+GBytes *
+gst_gz_dictionary_load (const gchar * location, GError ** error)
+{
+  GstGzDictionary *dict;
+  GStatBuf st;
+  gchar *contents;
+  gsize length;
+  GBytes *bytes = NULL;
+
+  if (g_stat (location, &st) != 0) {
+    g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+        "could not stat %s: %s", location, g_strerror (errno));
+    return NULL;
+  }
+
+  g_mutex_lock (&dictionary_lock);
+  if (!dictionaries)
+    dictionaries = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) gst_gz_dictionary_free);
+
+  dict = g_hash_table_lookup (dictionaries, location);
+  if (dict && dict->mtime == st.st_mtime && dict->size == st.st_size) {
+    bytes = g_bytes_ref (dict->bytes);
+  } else if (g_file_get_contents (location, &contents, &length, error)) {
+    dict = g_new0 (GstGzDictionary, 1);
+    dict->bytes = g_bytes_new_take (contents, length);
+    dict->mtime = st.st_mtime;
+    dict->size = st.st_size;
+    g_hash_table_replace (dictionaries, g_strdup (location), dict);
+    bytes = g_bytes_ref (dict->bytes);
+  }
+  g_mutex_unlock (&dictionary_lock);
+
+  return bytes;
+}
+
+GstGzMemberDecoder *
+gst_gz_member_decoder_new (gint numa_node)
+{
+  GstGzMemberDecoder *dec = g_new0 (GstGzMemberDecoder, 1);
+
+#ifdef HAVE_LIBDEFLATE
+  dec->decompressor = libdeflate_alloc_decompressor ();
+  if (!dec->decompressor) {
+    g_free (dec);
+    return NULL;
+  }
+#elif defined (HAVE_ISAL)
+  /* tens of KiB with its tables, allocated on the bound worker thread */
+  dec->isal = g_new (struct inflate_state, 1);
+#else
+  dec->stream = gst_gz_inflate_acquire (16 + MAX_WBITS, numa_node);
+  if (!dec->stream) {
+    g_free (dec);
+    return NULL;
+  }
+#endif
+
+  return dec;
+}
+
+void
+gst_gz_member_decoder_free (GstGzMemberDecoder * dec)
+{
+#ifdef HAVE_LIBDEFLATE
+  libdeflate_free_decompressor (dec->decompressor);
+#elif defined (HAVE_ISAL)
+  g_free (dec->isal);
+#else
+  gst_gz_inflate_release (dec->stream);
+#endif
+  g_free (dec);
+}
+
+gint
+gst_gz_member_decoder_decode (GstGzMemberDecoder * dec, const guint8 * in,
+    gsize in_size, guint8 * out, gsize out_size, gsize * out_written)
+{
+#ifdef HAVE_LIBDEFLATE
+  size_t in_used = 0, out_used = 0;
+  enum libdeflate_result res;
+
+  *out_written = 0;
+  res = libdeflate_gzip_decompress_ex (dec->decompressor, in, in_size, out,
+      out_size, &in_used, &out_used);
+  switch (res) {
+    case LIBDEFLATE_SUCCESS:
+      *out_written = out_used;
+      return in_used == in_size ? Z_STREAM_END : Z_DATA_ERROR;
+    case LIBDEFLATE_INSUFFICIENT_SPACE:
+      return Z_BUF_ERROR;
+    default:
+      return Z_DATA_ERROR;
+  }
+#elif defined (HAVE_ISAL)
+  struct inflate_state *state = dec->isal;
+  gint ret;
+
+  *out_written = 0;
+  if (in_size > G_MAXUINT32)
+    return Z_DATA_ERROR;
+
+  /* parses the gzip header and checks the trailer itself */
+  isal_inflate_init (state);
+  state->crc_flag = ISAL_GZIP;
+  state->next_in = (guint8 *) in;
+  state->avail_in = (guint32) in_size;
+  state->next_out = out;
+  state->avail_out = (guint32) MIN (out_size, G_MAXUINT32);
+
+  ret = isal_inflate (state);
+  *out_written = state->next_out - out;
+  if (ret != ISAL_DECOMP_OK)
+    return Z_DATA_ERROR;
+  if (state->block_state != ISAL_BLOCK_FINISH)
+    return state->avail_out == 0 ? Z_BUF_ERROR : Z_DATA_ERROR;
+
+  return state->avail_in == 0 ? Z_STREAM_END : Z_DATA_ERROR;
+#else
+  z_stream *stream = dec->stream;
+  gint ret;
+
+  inflateReset (stream);
+  stream->next_in = (z_const Bytef *) in;
+  stream->avail_in = (uInt) in_size;
+  stream->next_out = out;
+  stream->avail_out = (uInt) MIN (out_size, G_MAXUINT);
+
+  ret = inflate (stream, Z_FINISH);
+  *out_written = stream->next_out - out;
+  if (ret == Z_STREAM_END && stream->avail_in != 0)
+    ret = Z_DATA_ERROR;
+
+  return ret;
+#endif
+}
@@ -0,0 +1,91 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_BACKEND_H__
+#define __GST_GZ_BACKEND_H__
+
+#include <gst/gst.h>
+#include <zlib.h>
+
+G_BEGIN_DECLS
+
+/* Streaming decode always goes through the zlib API, which is either stock
+ * zlib or zlib-ng built in compat mode, whichever meson found as "zlib".
+ * Whole members that are already in memory (BGZF blocks) can be handed to
+ * a one-shot decoder instead: libdeflate or ISA-L, as picked with the
+ * inflate-backend meson option. */
+
+typedef struct _GstGzMemberDecoder GstGzMemberDecoder;
+
+/* human readable name of the inflate implementations in use */
+const gchar * gst_gz_backend_get_name (void);
+
+/* Inflate states are kept in a process-wide pool once their user is done
+ * with them, together with the 32 KiB window zlib allocated on first use,
+ * so restarting a stream or a whole pipeline does not allocate them again.
+ * An acquired state is reset for window_bits, NULL only when zlib fails to
+ * set up a new one. With numa_node >= 0 the state and window live on that
+ * node and only states from the same node are reused, -1 takes those
+ * placed by first touch. */
+z_stream * gst_gz_inflate_acquire (gint window_bits, gint numa_node);
+void gst_gz_inflate_release (z_stream * stream);
+
+/* Preset dictionaries read from files are loaded once per process and
+ * shared read-only by every element using them. Reloaded when the file
+ * changed since. */
+GBytes * gst_gz_dictionary_load (const gchar * location, GError ** error);
+
+/* numa_node as for gst_gz_inflate_acquire() */
+GstGzMemberDecoder * gst_gz_member_decoder_new (gint numa_node);
+void gst_gz_member_decoder_free (GstGzMemberDecoder * dec);
+
+/* decodes the single gzip member in[0..in_size) into out. Returns
+ * Z_STREAM_END when the member decoded completely and used up all of in,
+ * a zlib error code otherwise. */
+gint gst_gz_member_decoder_decode (GstGzMemberDecoder * dec,
+    const guint8 * in, gsize in_size, guint8 * out, gsize out_size,
+    gsize * out_written);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_BACKEND_H__ */
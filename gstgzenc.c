@@ -0,0 +1,830 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-gzenc
+ *
+ * gzip encoder, the counterpart of gzdec. The input is cut into blocks that
+ * are compressed in parallel, pigz style: every block gets the 32 KiB of
+ * input before it as dictionary and ends in a sync flush, so the blocks
+ * join into one ordinary gzip stream. With format=bgzf every block is a
+ * gzip member of its own instead, which gzdec threads=N decodes in
+ * parallel again.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch -v -m filesrc location=file.txt ! gzenc threads=0 ! filesink location="file.txt.gz"
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gstgzenc.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_gzenc_debug);
+#define GST_CAT_DEFAULT gst_gzenc_debug
+
+enum
+{
+  PROP_0,
+  PROP_LEVEL,
+  PROP_STRATEGY,
+  PROP_BLOCK_SIZE,
+  PROP_THREADS,
+  PROP_FORMAT
+};
+
+#define DEFAULT_LEVEL 6
+#define DEFAULT_STRATEGY Z_DEFAULT_STRATEGY
+#define DEFAULT_BLOCK_SIZE (128 * 1024)
+#define DEFAULT_THREADS 0
+#define DEFAULT_FORMAT GST_GZENC_FORMAT_GZIP
+
+/* deflate window, the dictionary handed from block to block */
+#define GZENC_WINDOW_SIZE 32768
+#define GZENC_GZIP_HEADER_SIZE 10
+#define GZENC_TRAILER_SIZE 8
+/* BGZF blocks hold at most 64 KiB compressed, bgzip stops input at 0xff00 */
+#define GZENC_BGZF_HEADER_SIZE 18
+#define GZENC_BGZF_MAX_INPUT 0xff00
+#define GZENC_BGZF_MAX_BLOCK 65536
+/* room for the sync flush marker on top of compressBound() */
+#define GZENC_FLUSH_SLACK 16
+
+/* empty BGZF block marking the end of the file */
+static const guint8 bgzf_eof[28] = {
+  0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+  0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00
+};
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("ANY")
+);
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("application/x-gzip")
+    );
+
+#define GST_TYPE_GZENC_STRATEGY (gst_gzenc_strategy_get_type ())
+static GType
+gst_gzenc_strategy_get_type (void)
+{
+  static GType strategy_type = 0;
+  static const GEnumValue strategies[] = {
+    {Z_DEFAULT_STRATEGY, "Default", "default"},
+    {Z_FILTERED, "Filtered, for data from filters or predictors", "filtered"},
+    {Z_HUFFMAN_ONLY, "Huffman coding only, no string matching",
+        "huffman-only"},
+    {Z_RLE, "Run-length encoding only", "rle"},
+    {Z_FIXED, "Fixed Huffman codes only", "fixed"},
+    {0, NULL, NULL},
+  };
+
+  if (!strategy_type)
+    strategy_type = g_enum_register_static ("GstGzencStrategy", strategies);
+
+  return strategy_type;
+}
+
+#define GST_TYPE_GZENC_FORMAT (gst_gzenc_format_get_type ())
+static GType
+gst_gzenc_format_get_type (void)
+{
+  static GType format_type = 0;
+  static const GEnumValue formats[] = {
+    {GST_GZENC_FORMAT_GZIP, "A single gzip stream", "gzip"},
+    {GST_GZENC_FORMAT_BGZF, "Blocked gzip, one member per block", "bgzf"},
+    {0, NULL, NULL},
+  };
+
+  if (!format_type)
+    format_type = g_enum_register_static ("GstGzencFormat", formats);
+
+  return format_type;
+}
+
+#define gst_gzenc_parent_class parent_class
+G_DEFINE_TYPE (Gstgzenc, gst_gzenc, GST_TYPE_ELEMENT);
+
+static void gst_gzenc_finalize (GObject * object);
+static void gst_gzenc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_gzenc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static GstStateChangeReturn gst_gzenc_change_state (GstElement * element,
+    GstStateChange transition);
+static gboolean gst_gzenc_sink_event (GstPad * pad, GstObject * parent, GstEvent * event);
+static GstFlowReturn gst_gzenc_chain (GstPad * pad, GstObject * parent, GstBuffer * buf);
+static void gst_gzenc_encode_job (GstGzJob * job, gpointer user_data);
+
+static void
+gst_gzenc_class_init (GstgzencClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+
+  gobject_class->finalize = gst_gzenc_finalize;
+  gobject_class->set_property = gst_gzenc_set_property;
+  gobject_class->get_property = gst_gzenc_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_LEVEL,
+      g_param_spec_int ("level", "Level",
+          "Compression level (0 = store only, 9 = smallest)",
+          0, 9, DEFAULT_LEVEL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STRATEGY,
+      g_param_spec_enum ("strategy", "Strategy",
+          "deflate compression strategy",
+          GST_TYPE_GZENC_STRATEGY, DEFAULT_STRATEGY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_BLOCK_SIZE,
+      g_param_spec_uint ("block-size", "Block size",
+          "Input bytes compressed per job. BGZF blocks are capped at 65280",
+          1024, 64 * 1024 * 1024, DEFAULT_BLOCK_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads compressing blocks in parallel "
+          "(0 = one per CPU, 1 = on the streaming thread)",
+          0, 256, DEFAULT_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_FORMAT,
+      g_param_spec_enum ("format", "Format",
+          "Container the compressed blocks are written in",
+          GST_TYPE_GZENC_FORMAT, DEFAULT_FORMAT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_gzenc_change_state);
+
+  gst_element_class_set_details_simple(gstelement_class,
+    "gzip encoder",
+    "Encoder/File",
+    "Compresses a stream with gzip on several threads",
+    "Sebastian Ovelar <<sebastianrovelar@gmail.com>>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_factory));
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&sink_factory));
+
+  GST_DEBUG_CATEGORY_INIT (gst_gzenc_debug, "gzenc", 0, "gzip encoder");
+}
+
+static void
+gst_gzenc_init (Gstgzenc * enc)
+{
+  enc->sinkpad = gst_pad_new_from_static_template (&sink_factory, "sink");
+  gst_pad_set_event_function (enc->sinkpad,
+                              GST_DEBUG_FUNCPTR(gst_gzenc_sink_event));
+  gst_pad_set_chain_function (enc->sinkpad,
+                              GST_DEBUG_FUNCPTR(gst_gzenc_chain));
+  gst_element_add_pad (GST_ELEMENT (enc), enc->sinkpad);
+
+  enc->srcpad = gst_pad_new_from_static_template (&src_factory, "src");
+  gst_pad_use_fixed_caps (enc->srcpad);
+  gst_element_add_pad (GST_ELEMENT (enc), enc->srcpad);
+
+  enc->level = DEFAULT_LEVEL;
+  enc->strategy = DEFAULT_STRATEGY;
+  enc->block_size = DEFAULT_BLOCK_SIZE;
+  enc->threads = DEFAULT_THREADS;
+  enc->format = DEFAULT_FORMAT;
+  enc->workers = NULL;
+  enc->adapter = gst_adapter_new ();
+  enc->dict = NULL;
+  enc->header_sent = FALSE;
+  enc->crc = crc32 (0L, Z_NULL, 0);
+  enc->size = 0;
+  enc->offset = 0;
+}
+
+static void
+gst_gzenc_finalize (GObject * object)
+{
+  Gstgzenc *enc = GST_GZENC (object);
+
+  g_object_unref (enc->adapter);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_gzenc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  Gstgzenc *enc = GST_GZENC (object);
+
+  GST_OBJECT_LOCK (enc);
+  switch (prop_id) {
+    case PROP_LEVEL:
+      enc->level = g_value_get_int (value);
+      break;
+    case PROP_STRATEGY:
+      enc->strategy = g_value_get_enum (value);
+      break;
+    case PROP_BLOCK_SIZE:
+      enc->block_size = g_value_get_uint (value);
+      break;
+    case PROP_THREADS:
+      enc->threads = g_value_get_uint (value);
+      break;
+    case PROP_FORMAT:
+      enc->format = g_value_get_enum (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (enc);
+}
+
+static void
+gst_gzenc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  Gstgzenc *enc = GST_GZENC (object);
+
+  GST_OBJECT_LOCK (enc);
+  switch (prop_id) {
+    case PROP_LEVEL:
+      g_value_set_int (value, enc->level);
+      break;
+    case PROP_STRATEGY:
+      g_value_set_enum (value, enc->strategy);
+      break;
+    case PROP_BLOCK_SIZE:
+      g_value_set_uint (value, enc->block_size);
+      break;
+    case PROP_THREADS:
+      g_value_set_uint (value, enc->threads);
+      break;
+    case PROP_FORMAT:
+      g_value_set_enum (value, enc->format);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (enc);
+}
+
+/* a deflate state per worker thread, re-created when the settings of the
+ * stream it works for change */
+typedef struct
+{
+  z_stream stream;
+  gint level;
+  gint strategy;
+} GstGzencDeflater;
+
+static void
+gst_gzenc_deflater_free (gpointer data)
+{
+  GstGzencDeflater *deflater = data;
+
+  deflateEnd (&deflater->stream);
+  g_free (deflater);
+}
+
+static GPrivate worker_deflater = G_PRIVATE_INIT (gst_gzenc_deflater_free);
+
+static GstGzencDeflater *
+gst_gzenc_get_deflater (gint level, gint strategy)
+{
+  GstGzencDeflater *deflater = g_private_get (&worker_deflater);
+
+  if (deflater && deflater->level == level && deflater->strategy == strategy) {
+    deflateReset (&deflater->stream);
+    return deflater;
+  }
+
+  deflater = g_new0 (GstGzencDeflater, 1);
+  deflater->level = level;
+  deflater->strategy = strategy;
+  /* raw deflate, the gzip framing is written by us */
+  if (deflateInit2 (&deflater->stream, level, Z_DEFLATED, -MAX_WBITS, 8,
+          strategy) != Z_OK) {
+    g_free (deflater);
+    return NULL;
+  }
+  g_private_replace (&worker_deflater, deflater);
+
+  return deflater;
+}
+
+static void
+gst_gzenc_write_le32 (guint8 * dest, guint32 value)
+{
+  GST_WRITE_UINT32_LE (dest, value);
+}
+
+/* Compresses one block. In gzip format the block continues the stream of
+ * the one before it and ends in a sync flush, or finishes the stream. In
+ * BGZF format it becomes a complete gzip member. Runs on a worker thread,
+ * or on the streaming thread with threads=1. */
+static void
+gst_gzenc_encode_job (GstGzJob * job, gpointer user_data)
+{
+  Gstgzenc *enc = user_data;
+  gboolean bgzf = enc->cur_format == GST_GZENC_FORMAT_BGZF;
+  GstBuffer *block = gst_buffer_list_get (job->input, 0);
+  GstBuffer *dict = NULL;
+  GstGzencDeflater *deflater;
+  GstMapInfo in, out, window;
+  gsize head = bgzf ? GZENC_BGZF_HEADER_SIZE : 0;
+  gsize tail = bgzf ? GZENC_TRAILER_SIZE : 0;
+  gint ret;
+
+  if (gst_buffer_list_length (job->input) > 1)
+    dict = gst_buffer_list_get (job->input, 1);
+
+  deflater = gst_gzenc_get_deflater (enc->cur_level, enc->cur_strategy);
+  if (!deflater) {
+    job->result = Z_MEM_ERROR;
+    return;
+  }
+
+  if (!gst_buffer_map (block, &in, GST_MAP_READ)) {
+    job->result = Z_MEM_ERROR;
+    return;
+  }
+  if (!gst_buffer_map (job->output, &out, GST_MAP_WRITE)) {
+    gst_buffer_unmap (block, &in);
+    job->result = Z_MEM_ERROR;
+    return;
+  }
+
+  ret = Z_OK;
+  if (dict) {
+    if (gst_buffer_map (dict, &window, GST_MAP_READ)) {
+      ret = deflateSetDictionary (&deflater->stream, window.data,
+          (uInt) window.size);
+      gst_buffer_unmap (dict, &window);
+    } else {
+      ret = Z_MEM_ERROR;
+    }
+  }
+
+  if (ret == Z_OK) {
+    z_stream *stream = &deflater->stream;
+
+    stream->next_in = (z_const Bytef *) in.data;
+    stream->avail_in = (uInt) in.size;
+    stream->next_out = out.data + head;
+    stream->avail_out = (uInt) (out.size - head - tail);
+
+    /* the output is sized for the whole block, one call does it */
+    ret = deflate (stream, (job->last || bgzf) ? Z_FINISH : Z_SYNC_FLUSH);
+    if (ret == Z_STREAM_END || (ret == Z_OK && stream->avail_in == 0 &&
+            stream->avail_out > 0))
+      ret = Z_OK;
+    else if (ret == Z_OK)
+      ret = Z_BUF_ERROR;
+
+    job->output_size = head + stream->total_out + tail;
+  }
+
+  job->check = crc32 (crc32 (0L, Z_NULL, 0), in.data, (uInt) in.size);
+
+  if (ret == Z_OK && bgzf) {
+    static const guint8 header[16] = {
+      0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x06, 0x00,
+      0x42, 0x43, 0x02, 0x00
+    };
+
+    if (job->output_size > GZENC_BGZF_MAX_BLOCK) {
+      ret = Z_BUF_ERROR;
+    } else {
+      memcpy (out.data, header, sizeof (header));
+      GST_WRITE_UINT16_LE (out.data + 16, job->output_size - 1);
+      gst_gzenc_write_le32 (out.data + job->output_size - 8, job->check);
+      gst_gzenc_write_le32 (out.data + job->output_size - 4, (guint32) in.size);
+    }
+  }
+
+  gst_buffer_unmap (job->output, &out);
+  gst_buffer_unmap (block, &in);
+  job->result = ret;
+}
+
+static GstFlowReturn
+gst_gzenc_push_bytes (Gstgzenc * enc, const guint8 * data, gsize size)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, size, NULL);
+
+  gst_buffer_fill (buf, 0, data, size);
+  GST_BUFFER_OFFSET (buf) = enc->offset;
+  enc->offset += size;
+  GST_BUFFER_OFFSET_END (buf) = enc->offset;
+
+  return gst_pad_push (enc->srcpad, buf);
+}
+
+/* push the compressed block of a finished job, after the gzip header if
+ * this is the first */
+static GstFlowReturn
+gst_gzenc_push_job (Gstgzenc * enc, GstGzJob * job)
+{
+  GstBuffer *block = gst_buffer_list_get (job->input, 0);
+  gsize size = gst_buffer_get_size (block);
+  GstFlowReturn flow;
+  GstBuffer *buf;
+
+  if (job->result != Z_OK) {
+    GST_ELEMENT_ERROR (enc, STREAM, ENCODE, (NULL),
+        ("Failed to deflate block (%d)", job->result));
+    return GST_FLOW_ERROR;
+  }
+
+  if (enc->cur_format == GST_GZENC_FORMAT_GZIP && !enc->header_sent) {
+    guint8 header[GZENC_GZIP_HEADER_SIZE] = {
+      0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03
+    };
+
+    /* XFL tells readers the fastest or best method was used */
+    header[8] = enc->cur_level == 9 ? 2 : (enc->cur_level == 1 ? 4 : 0);
+    flow = gst_gzenc_push_bytes (enc, header, sizeof (header));
+    if (flow != GST_FLOW_OK)
+      return flow;
+    enc->header_sent = TRUE;
+  }
+
+  /* the blocks were checksummed separately, for gzip the stream gets one
+   * crc32 over all of them */
+  enc->crc = crc32_combine (enc->crc, job->check, (z_off_t) size);
+  enc->size += size;
+
+  buf = job->output;
+  job->output = NULL;
+  gst_buffer_resize (buf, 0, job->output_size);
+  GST_BUFFER_OFFSET (buf) = enc->offset;
+  enc->offset += job->output_size;
+  GST_BUFFER_OFFSET_END (buf) = enc->offset;
+
+  GST_LOG_OBJECT (enc, "%" G_GSIZE_FORMAT " bytes compressed to %"
+      G_GSIZE_FORMAT, size, job->output_size);
+
+  return gst_pad_push (enc->srcpad, buf);
+}
+
+/* push the finished jobs in order, waiting until no more than max_pending
+ * are left */
+static GstFlowReturn
+gst_gzenc_finish_jobs (Gstgzenc * enc, guint max_pending)
+{
+  GstFlowReturn flow = GST_FLOW_OK;
+  GstGzJob *job;
+
+  if (!enc->workers)
+    return GST_FLOW_OK;
+
+  while (flow == GST_FLOW_OK) {
+    gboolean wait = gst_gz_workers_get_pending (enc->workers) > max_pending;
+
+    job = gst_gz_workers_pop (enc->workers, wait);
+    if (!job)
+      break;
+
+    flow = gst_gzenc_push_job (enc, job);
+    gst_gz_job_free (job);
+  }
+
+  return flow;
+}
+
+static void
+gst_gzenc_discard_jobs (Gstgzenc * enc)
+{
+  GstGzJob *job;
+
+  if (!enc->workers)
+    return;
+
+  while ((job = gst_gz_workers_pop (enc->workers, TRUE)))
+    gst_gz_job_free (job);
+}
+
+/* keep the last 32 KiB of input, whichever blocks it came from */
+static void
+gst_gzenc_update_dict (Gstgzenc * enc, GstBuffer * block)
+{
+  GstBuffer *window;
+  gsize size;
+
+  if (enc->dict)
+    window = gst_buffer_append (enc->dict, gst_buffer_ref (block));
+  else
+    window = gst_buffer_ref (block);
+  enc->dict = NULL;
+
+  size = gst_buffer_get_size (window);
+  if (size > GZENC_WINDOW_SIZE) {
+    enc->dict = gst_buffer_copy_region (window, GST_BUFFER_COPY_MEMORY,
+        size - GZENC_WINDOW_SIZE, GZENC_WINDOW_SIZE);
+    gst_buffer_unref (window);
+  } else {
+    enc->dict = window;
+  }
+}
+
+/* compress a block, on the workers or right here */
+static GstFlowReturn
+gst_gzenc_submit (Gstgzenc * enc, GstBuffer * block, gboolean last)
+{
+  GstGzJob *job;
+  GstFlowReturn flow;
+  gsize size = gst_buffer_get_size (block);
+
+  job = gst_gz_job_new ();
+  job->last = last;
+  job->output = gst_buffer_new_allocate (NULL, GZENC_BGZF_HEADER_SIZE +
+      compressBound ((uLong) size) + GZENC_FLUSH_SLACK + GZENC_TRAILER_SIZE,
+      NULL);
+  gst_buffer_list_add (job->input, block);
+
+  if (enc->cur_format == GST_GZENC_FORMAT_GZIP) {
+    if (enc->dict)
+      gst_buffer_list_add (job->input, gst_buffer_ref (enc->dict));
+    gst_gzenc_update_dict (enc, block);
+  }
+
+  if (!enc->workers) {
+    gst_gzenc_encode_job (job, enc);
+    flow = gst_gzenc_push_job (enc, job);
+    gst_gz_job_free (job);
+    return flow;
+  }
+
+  /* keep one job queued behind every busy worker, no more */
+  flow = gst_gzenc_finish_jobs (enc,
+      2 * gst_gz_workers_get_n_threads (enc->workers) - 1);
+  if (flow != GST_FLOW_OK) {
+    gst_gz_job_free (job);
+    return flow;
+  }
+
+  if (!gst_gz_workers_push (enc->workers, job)) {
+    gst_gz_job_free (job);
+    GST_ELEMENT_ERROR (enc, CORE, THREAD, (NULL),
+        ("Failed to queue deflate job"));
+    return GST_FLOW_ERROR;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* compress what is left and close the stream */
+static GstFlowReturn
+gst_gzenc_finish (Gstgzenc * enc)
+{
+  gsize avail = gst_adapter_available (enc->adapter);
+  GstFlowReturn flow = GST_FLOW_OK;
+  guint8 trailer[GZENC_TRAILER_SIZE];
+
+  if (enc->cur_format == GST_GZENC_FORMAT_BGZF) {
+    if (avail > 0)
+      flow = gst_gzenc_submit (enc,
+          gst_adapter_take_buffer (enc->adapter, avail), TRUE);
+    if (flow == GST_FLOW_OK)
+      flow = gst_gzenc_finish_jobs (enc, 0);
+    if (flow == GST_FLOW_OK)
+      flow = gst_gzenc_push_bytes (enc, bgzf_eof, sizeof (bgzf_eof));
+    return flow;
+  }
+
+  /* the last block finishes the deflate stream, even an empty one */
+  flow = gst_gzenc_submit (enc, avail > 0 ?
+      gst_adapter_take_buffer (enc->adapter, avail) : gst_buffer_new (), TRUE);
+  if (flow == GST_FLOW_OK)
+    flow = gst_gzenc_finish_jobs (enc, 0);
+  if (flow != GST_FLOW_OK)
+    return flow;
+
+  gst_gzenc_write_le32 (trailer, enc->crc);
+  gst_gzenc_write_le32 (trailer + 4, (guint32) enc->size);
+
+  return gst_gzenc_push_bytes (enc, trailer, sizeof (trailer));
+}
+
+static void
+gst_gzenc_reset (Gstgzenc * enc)
+{
+  gst_gzenc_discard_jobs (enc);
+  gst_adapter_clear (enc->adapter);
+  if (enc->dict) {
+    gst_buffer_unref (enc->dict);
+    enc->dict = NULL;
+  }
+  enc->header_sent = FALSE;
+  enc->crc = crc32 (0L, Z_NULL, 0);
+  enc->size = 0;
+  enc->offset = 0;
+}
+
+static gboolean
+gst_gzenc_start (Gstgzenc * enc)
+{
+  guint threads;
+
+  GST_OBJECT_LOCK (enc);
+  enc->cur_level = enc->level;
+  enc->cur_strategy = enc->strategy;
+  enc->cur_block_size = enc->block_size;
+  enc->cur_format = enc->format;
+  threads = enc->threads;
+  GST_OBJECT_UNLOCK (enc);
+
+  if (enc->cur_format == GST_GZENC_FORMAT_BGZF)
+    enc->cur_block_size = MIN (enc->cur_block_size, GZENC_BGZF_MAX_INPUT);
+
+  if (threads == 0)
+    threads = g_get_num_processors ();
+  if (threads > 1) {
+    enc->workers = gst_gz_workers_new (threads, gst_gzenc_encode_job, enc);
+    if (!enc->workers)
+      GST_WARNING_OBJECT (enc, "failed to start %u worker threads, "
+          "compressing serially", threads);
+  }
+
+  GST_DEBUG_OBJECT (enc, "level %d, %" G_GSIZE_FORMAT " byte blocks on %u "
+      "threads", enc->cur_level, enc->cur_block_size,
+      enc->workers ? threads : 1);
+
+  gst_gzenc_reset (enc);
+
+  return TRUE;
+}
+
+static void
+gst_gzenc_stop (Gstgzenc * enc)
+{
+  gst_gzenc_reset (enc);
+  if (enc->workers) {
+    gst_gz_workers_free (enc->workers);
+    enc->workers = NULL;
+  }
+}
+
+static GstStateChangeReturn
+gst_gzenc_change_state (GstElement * element, GstStateChange transition)
+{
+  Gstgzenc *enc = GST_GZENC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_gzenc_start (enc))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_gzenc_stop (enc);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_gzenc_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  Gstgzenc *enc = GST_GZENC (parent);
+  gboolean ret;
+
+  GST_LOG_OBJECT (enc, "Received %s event: %" GST_PTR_FORMAT,
+      GST_EVENT_TYPE_NAME (event), event);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps;
+
+      /* whatever comes in, gzip goes out */
+      gst_event_unref (event);
+      caps = gst_pad_get_pad_template_caps (enc->srcpad);
+      ret = gst_pad_push_event (enc->srcpad, gst_event_new_caps (caps));
+      gst_caps_unref (caps);
+      break;
+    }
+    case GST_EVENT_SEGMENT:
+    {
+      GstSegment segment;
+      GstEvent *ev;
+
+      /* the output is a byte stream of its own */
+      gst_segment_init (&segment, GST_FORMAT_BYTES);
+      ev = gst_event_new_segment (&segment);
+      gst_event_set_seqnum (ev, gst_event_get_seqnum (event));
+      gst_event_unref (event);
+      ret = gst_pad_push_event (enc->srcpad, ev);
+      break;
+    }
+    case GST_EVENT_EOS:
+      if (gst_gzenc_finish (enc) != GST_FLOW_OK)
+        GST_DEBUG_OBJECT (enc, "failed to push the end of the stream");
+      ret = gst_pad_event_default (pad, parent, event);
+      gst_gzenc_reset (enc);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      gst_gzenc_reset (enc);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    default:
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_gzenc_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  Gstgzenc *enc = GST_GZENC (parent);
+  GstFlowReturn flow = GST_FLOW_OK;
+
+  gst_adapter_push (enc->adapter, buf);
+
+  /* whole blocks go out as soon as they are there, the rest waits for more
+   * input or EOS */
+  while (flow == GST_FLOW_OK &&
+      gst_adapter_available (enc->adapter) >= enc->cur_block_size)
+    flow = gst_gzenc_submit (enc,
+        gst_adapter_take_buffer (enc->adapter, enc->cur_block_size), FALSE);
+
+  /* push whatever the workers finished meanwhile */
+  if (flow == GST_FLOW_OK && enc->workers)
+    flow = gst_gzenc_finish_jobs (enc,
+        2 * gst_gz_workers_get_n_threads (enc->workers));
+
+  return flow;
+}
@@ -0,0 +1,118 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZENC_H__
+#define __GST_GZENC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstadapter.h>
+#include <zlib.h>
+
+#include "gstgzworkers.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_GZENC \
+  (gst_gzenc_get_type())
+#define GST_GZENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_GZENC,Gstgzenc))
+#define GST_GZENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_GZENC,GstgzencClass))
+#define GST_IS_GZENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_GZENC))
+#define GST_IS_GZENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_GZENC))
+
+typedef enum
+{
+  GST_GZENC_FORMAT_GZIP,        /* one gzip member, blocks joined by sync flushes */
+  GST_GZENC_FORMAT_BGZF         /* one gzip member per block */
+} GstGzencFormat;
+
+typedef struct _Gstgzenc      Gstgzenc;
+typedef struct _GstgzencClass GstgzencClass;
+
+struct _Gstgzenc
+{
+  GstElement element;
+
+  GstPad *sinkpad, *srcpad;
+
+  /* properties, copied to the fields below in READY->PAUSED */
+  gint level;
+  gint strategy;
+  guint block_size;
+  guint threads;
+  GstGzencFormat format;
+
+  /* settings the running stream uses, read by the worker threads */
+  gint cur_level;
+  gint cur_strategy;
+  gsize cur_block_size;
+  GstGzencFormat cur_format;
+
+  /* NULL when compressing on the streaming thread */
+  GstGzWorkers *workers;
+  /* input not yet cut into blocks */
+  GstAdapter *adapter;
+  /* last 32 KiB of input, the dictionary of the next block */
+  GstBuffer *dict;
+
+  /* gzip header written, crc32 and size of the input so far */
+  gboolean header_sent;
+  guint32 crc;
+  guint64 size;
+  /* bytes pushed so far, used for the output buffer offsets */
+  guint64 offset;
+};
+
+struct _GstgzencClass
+{
+  GstElementClass parent_class;
+};
+
+GType gst_gzenc_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_GZENC_H__ */
@@ -0,0 +1,398 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/**
+ * SECTION:element-gzfiledec
+ *
+ * Reads a gzip file and outputs it decompressed, like
+ * filesrc ! gzdec but without the read() copies in between: the file is
+ * mmapped and inflated straight from the mapping into the output buffers.
+ * Concatenated members are decoded one after the other. Several
+ * gzfiledec reading the same file share its pages in the page cache.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch -v -m gzfiledec location=file.txt.gz ! filesink location="file.txt"
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+
+#include "gstgzfiledec.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_gzfiledec_debug);
+#define GST_CAT_DEFAULT gst_gzfiledec_debug
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION
+};
+
+#define DEFAULT_LOCATION NULL
+/* output buffer size, large enough that the per buffer overhead vanishes */
+#define DEFAULT_BLOCKSIZE (256 * 1024)
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("ANY")
+    );
+
+#define gst_gzfiledec_parent_class parent_class
+G_DEFINE_TYPE (Gstgzfiledec, gst_gzfiledec, GST_TYPE_BASE_SRC);
+
+static void gst_gzfiledec_finalize (GObject * object);
+static void gst_gzfiledec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_gzfiledec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
+static gboolean gst_gzfiledec_start (GstBaseSrc * src);
+static gboolean gst_gzfiledec_stop (GstBaseSrc * src);
+static gboolean gst_gzfiledec_is_seekable (GstBaseSrc * src);
+static GstFlowReturn gst_gzfiledec_fill (GstBaseSrc * src, guint64 offset,
+    guint length, GstBuffer * buf);
+
+static void
+gst_gzfiledec_class_init (GstgzfiledecClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *gstelement_class;
+  GstBaseSrcClass *gstbasesrc_class;
+
+  gobject_class = (GObjectClass *) klass;
+  gstelement_class = (GstElementClass *) klass;
+  gstbasesrc_class = (GstBaseSrcClass *) klass;
+
+  gobject_class->finalize = gst_gzfiledec_finalize;
+  gobject_class->set_property = gst_gzfiledec_set_property;
+  gobject_class->get_property = gst_gzfiledec_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "File Location",
+          "Location of the gzip file to read", DEFAULT_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  gst_element_class_set_details_simple(gstelement_class,
+    "gzip file decoder",
+    "Source/File/Decoder",
+    "Decodes a gzip file read through a memory mapping",
+    "Sebastian Ovelar <<sebastianrovelar@gmail.com>>");
+
+  gst_element_class_add_pad_template (gstelement_class,
+      gst_static_pad_template_get (&src_factory));
+
+  gstbasesrc_class->start = GST_DEBUG_FUNCPTR (gst_gzfiledec_start);
+  gstbasesrc_class->stop = GST_DEBUG_FUNCPTR (gst_gzfiledec_stop);
+  gstbasesrc_class->is_seekable = GST_DEBUG_FUNCPTR (gst_gzfiledec_is_seekable);
+  gstbasesrc_class->fill = GST_DEBUG_FUNCPTR (gst_gzfiledec_fill);
+
+  GST_DEBUG_CATEGORY_INIT (gst_gzfiledec_debug, "gzfiledec", 0,
+      "gzip file decoder");
+}
+
+static void
+gst_gzfiledec_init (Gstgzfiledec * filter)
+{
+  filter->location = g_strdup (DEFAULT_LOCATION);
+  filter->fd = -1;
+  filter->data = NULL;
+  filter->size = 0;
+  filter->strm_init = FALSE;
+  filter->member_end = FALSE;
+
+  gst_base_src_set_format (GST_BASE_SRC (filter), GST_FORMAT_BYTES);
+  gst_base_src_set_blocksize (GST_BASE_SRC (filter), DEFAULT_BLOCKSIZE);
+}
+
+static void
+gst_gzfiledec_finalize (GObject * object)
+{
+  Gstgzfiledec *filter = GST_GZFILEDEC (object);
+
+  g_free (filter->location);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_gzfiledec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  Gstgzfiledec *filter = GST_GZFILEDEC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->location);
+      filter->location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_gzfiledec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  Gstgzfiledec *filter = GST_GZFILEDEC (object);
+
+  switch (prop_id) {
+    case PROP_LOCATION:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->location);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+/* map the file and tell the kernel it is read once from start to end */
+static gboolean
+gst_gzfiledec_map (Gstgzfiledec * filter, const gchar * location)
+{
+  struct stat st;
+  void *data;
+
+  filter->fd = g_open (location, O_RDONLY, 0);
+  if (filter->fd < 0) {
+    GST_ELEMENT_ERROR (filter, RESOURCE, OPEN_READ, (NULL),
+        ("could not open %s: %s", location, g_strerror (errno)));
+    return FALSE;
+  }
+
+  if (fstat (filter->fd, &st) != 0 || !S_ISREG (st.st_mode)) {
+    GST_ELEMENT_ERROR (filter, RESOURCE, OPEN_READ, (NULL),
+        ("%s is not a regular file", location));
+    return FALSE;
+  }
+
+  filter->size = st.st_size;
+  if (filter->size == 0)
+    return TRUE;
+
+  data = mmap (NULL, filter->size, PROT_READ, MAP_PRIVATE, filter->fd, 0);
+  if (data == MAP_FAILED) {
+    GST_ELEMENT_ERROR (filter, RESOURCE, OPEN_READ, (NULL),
+        ("could not map %s: %s", location, g_strerror (errno)));
+    filter->size = 0;
+    return FALSE;
+  }
+  filter->data = data;
+
+  /* only hints, failing them costs nothing but speed */
+#ifdef MADV_SEQUENTIAL
+  if (madvise (data, filter->size, MADV_SEQUENTIAL) != 0)
+    GST_DEBUG_OBJECT (filter, "MADV_SEQUENTIAL: %s", g_strerror (errno));
+#endif
+#ifdef MADV_HUGEPAGE
+  if (madvise (data, filter->size, MADV_HUGEPAGE) != 0)
+    GST_DEBUG_OBJECT (filter, "MADV_HUGEPAGE: %s", g_strerror (errno));
+#endif
+
+  GST_DEBUG_OBJECT (filter, "mapped %" G_GSIZE_FORMAT " bytes of %s",
+      filter->size, location);
+
+  return TRUE;
+}
+
+static void
+gst_gzfiledec_unmap (Gstgzfiledec * filter)
+{
+  if (filter->data)
+    munmap ((void *) filter->data, filter->size);
+  if (filter->fd >= 0)
+    close (filter->fd);
+
+  filter->data = NULL;
+  filter->size = 0;
+  filter->fd = -1;
+}
+
+static gboolean
+gst_gzfiledec_start (GstBaseSrc * src)
+{
+  Gstgzfiledec *filter = GST_GZFILEDEC (src);
+  gchar *location;
+  gboolean ok;
+
+  GST_OBJECT_LOCK (filter);
+  location = g_strdup (filter->location);
+  GST_OBJECT_UNLOCK (filter);
+
+  if (!location) {
+    GST_ELEMENT_ERROR (filter, RESOURCE, NOT_FOUND, (NULL),
+        ("no file location set"));
+    return FALSE;
+  }
+
+  ok = gst_gzfiledec_map (filter, location);
+  g_free (location);
+  if (!ok) {
+    gst_gzfiledec_unmap (filter);
+    return FALSE;
+  }
+
+  memset (&filter->strm, 0, sizeof (filter->strm));
+  /* 32 more than the window bits takes gzip and zlib headers alike */
+  if (inflateInit2 (&filter->strm, 15 + 32) != Z_OK) {
+    GST_ELEMENT_ERROR (filter, LIBRARY, INIT, (NULL),
+        ("inflateInit2 failed: %s", filter->strm.msg));
+    gst_gzfiledec_unmap (filter);
+    return FALSE;
+  }
+  filter->strm_init = TRUE;
+  filter->strm.next_in = (Bytef *) filter->data;
+  filter->strm.avail_in = 0;
+  filter->member_end = FALSE;
+
+  return TRUE;
+}
+
+static gboolean
+gst_gzfiledec_stop (GstBaseSrc * src)
+{
+  Gstgzfiledec *filter = GST_GZFILEDEC (src);
+
+  if (filter->strm_init)
+    inflateEnd (&filter->strm);
+  filter->strm_init = FALSE;
+  gst_gzfiledec_unmap (filter);
+
+  return TRUE;
+}
+
+static gboolean
+gst_gzfiledec_is_seekable (GstBaseSrc * src)
+{
+  /* the output has no index into the input */
+  return FALSE;
+}
+
+/* input left in the mapping after what inflate has taken */
+static gsize
+gst_gzfiledec_remaining (Gstgzfiledec * filter)
+{
+  return filter->size - (filter->strm.next_in - filter->data) -
+      filter->strm.avail_in;
+}
+
+static GstFlowReturn
+gst_gzfiledec_fill (GstBaseSrc * src, guint64 offset, guint length,
+    GstBuffer * buf)
+{
+  Gstgzfiledec *filter = GST_GZFILEDEC (src);
+  z_stream *strm = &filter->strm;
+  GstMapInfo map;
+  gsize written;
+  int ret = Z_OK;
+
+  if (!gst_buffer_map (buf, &map, GST_MAP_WRITE))
+    return GST_FLOW_ERROR;
+
+  strm->next_out = map.data;
+  strm->avail_out = map.size;
+
+  while (strm->avail_out > 0) {
+    /* feed the mapping in pieces that fit avail_in */
+    if (strm->avail_in == 0) {
+      gsize left = gst_gzfiledec_remaining (filter);
+
+      if (left == 0)
+        break;
+      strm->avail_in = MIN (left, G_MAXUINT32);
+    }
+
+    if (filter->member_end) {
+      inflateReset (strm);
+      filter->member_end = FALSE;
+    }
+
+    ret = inflate (strm, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      filter->member_end = TRUE;
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+      gst_buffer_unmap (buf, &map);
+      GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+          ("inflate failed at input byte %" G_GSIZE_FORMAT ": %s",
+              (gsize) (strm->next_in - filter->data),
+              strm->msg ? strm->msg : "unknown error"));
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  written = map.size - strm->avail_out;
+  gst_buffer_unmap (buf, &map);
+
+  if (written == 0) {
+    if (!filter->member_end && filter->size > 0) {
+      GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+          ("file ends in the middle of a gzip member"));
+      return GST_FLOW_ERROR;
+    }
+    return GST_FLOW_EOS;
+  }
+
+  gst_buffer_resize (buf, 0, written);
+
+  return GST_FLOW_OK;
+}
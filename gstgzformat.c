@@ -0,0 +1,333 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <zlib.h>
+
+#include "gstgzformat.h"
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4frame.h>
+#endif
+#ifdef HAVE_BZIP2
+#include <bzlib.h>
+#endif
+
+struct _GstGzStreamDecoder
+{
+  GstGzFormat format;
+
+#ifdef HAVE_ZSTD
+  ZSTD_DStream *zstd;
+#endif
+#ifdef HAVE_LZ4
+  LZ4F_dctx *lz4;
+#endif
+#ifdef HAVE_BZIP2
+  bz_stream bz;
+#endif
+};
+
+GstGzFormat
+gst_gz_format_sniff (const guint8 * data, gsize size)
+{
+  if (size >= 2 && data[0] == 0x1f && data[1] == 0x8b)
+    return GST_GZ_FORMAT_GZIP;
+  if (size >= 4 && GST_READ_UINT32_LE (data) == 0xfd2fb528)
+    return GST_GZ_FORMAT_ZSTD;
+  if (size >= 4 && GST_READ_UINT32_LE (data) == 0x184d2204)
+    return GST_GZ_FORMAT_LZ4;
+  if (size >= 4 && data[0] == 'B' && data[1] == 'Z' && data[2] == 'h' &&
+      data[3] >= '1' && data[3] <= '9')
+    return GST_GZ_FORMAT_BZIP2;
+  /* CMF/FLG: deflate with a window of at most 32 KiB and a valid check */
+  if (size >= 2 && (data[0] & 0x0f) == 8 && (data[0] >> 4) <= 7 &&
+      (GST_READ_UINT16_BE (data) % 31) == 0)
+    return GST_GZ_FORMAT_ZLIB;
+
+  return GST_GZ_FORMAT_UNKNOWN;
+}
+
+gint
+gst_gz_format_parse_file_name (const guint8 * data, gsize size,
+    gchar ** name)
+{
+  const guint8 *end;
+  gsize pos = 10;
+  guint8 flags;
+
+  *name = NULL;
+  if (size < 10)
+    return size < 3 || (data[0] == 0x1f && data[1] == 0x8b) ? -1 : 0;
+  if (data[0] != 0x1f || data[1] != 0x8b || data[2] != 8)
+    return 0;
+
+  flags = data[3];
+  if (!(flags & 0x08))
+    return 0;
+  if (flags & 0x04) {
+    if (size < pos + 2)
+      return -1;
+    pos += 2 + GST_READ_UINT16_LE (data + pos);
+  }
+  if (size <= pos)
+    return -1;
+
+  end = memchr (data + pos, 0, size - pos);
+  if (!end)
+    return -1;
+  /* ISO 8859-1 in the header */
+  *name = g_convert ((const gchar *) data + pos, end - (data + pos), "UTF-8",
+      "ISO-8859-1", NULL, NULL, NULL);
+
+  return *name ? 1 : 0;
+}
+
+GstGzFormat
+gst_gz_format_from_caps (const GstCaps * caps)
+{
+  const gchar *name;
+
+  if (!caps || gst_caps_get_size (caps) == 0)
+    return GST_GZ_FORMAT_UNKNOWN;
+
+  name = gst_structure_get_name (gst_caps_get_structure (caps, 0));
+  if (g_str_equal (name, "application/x-gzip"))
+    return GST_GZ_FORMAT_GZIP;
+  if (g_str_equal (name, "application/x-zlib"))
+    return GST_GZ_FORMAT_ZLIB;
+  if (g_str_equal (name, "application/x-deflate"))
+    return GST_GZ_FORMAT_DEFLATE;
+  if (g_str_equal (name, "application/zstd"))
+    return GST_GZ_FORMAT_ZSTD;
+  if (g_str_equal (name, "application/x-lz4"))
+    return GST_GZ_FORMAT_LZ4;
+  if (g_str_equal (name, "application/x-bzip"))
+    return GST_GZ_FORMAT_BZIP2;
+
+  return GST_GZ_FORMAT_UNKNOWN;
+}
+
+const gchar *
+gst_gz_format_get_name (GstGzFormat format)
+{
+  switch (format) {
+    case GST_GZ_FORMAT_GZIP:
+      return "gzip";
+    case GST_GZ_FORMAT_ZLIB:
+      return "zlib";
+    case GST_GZ_FORMAT_DEFLATE:
+      return "deflate";
+    case GST_GZ_FORMAT_ZSTD:
+      return "zstd";
+    case GST_GZ_FORMAT_LZ4:
+      return "lz4";
+    case GST_GZ_FORMAT_BZIP2:
+      return "bzip2";
+    default:
+      return "unknown";
+  }
+}
+
+gboolean
+gst_gz_format_is_deflate (GstGzFormat format)
+{
+  return format == GST_GZ_FORMAT_GZIP || format == GST_GZ_FORMAT_ZLIB ||
+      format == GST_GZ_FORMAT_DEFLATE;
+}
+
+gint
+gst_gz_format_get_window_bits (GstGzFormat format)
+{
+  switch (format) {
+    case GST_GZ_FORMAT_ZLIB:
+      return MAX_WBITS;
+    case GST_GZ_FORMAT_DEFLATE:
+      return -MAX_WBITS;
+    default:
+      return 16 + MAX_WBITS;
+  }
+}
+
+GstGzStreamDecoder *
+gst_gz_stream_decoder_new (GstGzFormat format)
+{
+  GstGzStreamDecoder *dec = g_new0 (GstGzStreamDecoder, 1);
+
+  dec->format = format;
+
+  switch (format) {
+#ifdef HAVE_ZSTD
+    case GST_GZ_FORMAT_ZSTD:
+      dec->zstd = ZSTD_createDStream ();
+      if (dec->zstd && !ZSTD_isError (ZSTD_initDStream (dec->zstd)))
+        return dec;
+      break;
+#endif
+#ifdef HAVE_LZ4
+    case GST_GZ_FORMAT_LZ4:
+      if (!LZ4F_isError (LZ4F_createDecompressionContext (&dec->lz4,
+                  LZ4F_VERSION)))
+        return dec;
+      break;
+#endif
+#ifdef HAVE_BZIP2
+    case GST_GZ_FORMAT_BZIP2:
+      if (BZ2_bzDecompressInit (&dec->bz, 0, 0) == BZ_OK)
+        return dec;
+      dec->format = GST_GZ_FORMAT_UNKNOWN;
+      break;
+#endif
+    default:
+      dec->format = GST_GZ_FORMAT_UNKNOWN;
+      break;
+  }
+
+  gst_gz_stream_decoder_free (dec);
+  return NULL;
+}
+
+void
+gst_gz_stream_decoder_free (GstGzStreamDecoder * dec)
+{
+#ifdef HAVE_ZSTD
+  if (dec->zstd)
+    ZSTD_freeDStream (dec->zstd);
+#endif
+#ifdef HAVE_LZ4
+  if (dec->lz4)
+    LZ4F_freeDecompressionContext (dec->lz4);
+#endif
+#ifdef HAVE_BZIP2
+  if (dec->format == GST_GZ_FORMAT_BZIP2)
+    BZ2_bzDecompressEnd (&dec->bz);
+#endif
+  g_free (dec);
+}
+
+GstGzDecodeResult
+gst_gz_stream_decoder_decode (GstGzStreamDecoder * dec, const guint8 ** in,
+    gsize * in_size, guint8 ** out, gsize * out_size, const gchar ** error)
+{
+  switch (dec->format) {
+#ifdef HAVE_ZSTD
+    case GST_GZ_FORMAT_ZSTD:
+    {
+      ZSTD_inBuffer src = { *in, *in_size, 0 };
+      ZSTD_outBuffer dst = { *out, *out_size, 0 };
+      size_t ret = ZSTD_decompressStream (dec->zstd, &dst, &src);
+
+      if (ZSTD_isError (ret)) {
+        *error = ZSTD_getErrorName (ret);
+        return GST_GZ_DECODE_ERROR;
+      }
+      *in += src.pos;
+      *in_size -= src.pos;
+      *out += dst.pos;
+      *out_size -= dst.pos;
+      /* 0 once a frame is complete and flushed, the next call starts
+       * on the next frame */
+      return ret == 0 ? GST_GZ_DECODE_END : GST_GZ_DECODE_OK;
+    }
+#endif
+#ifdef HAVE_LZ4
+    case GST_GZ_FORMAT_LZ4:
+    {
+      size_t src_size = *in_size, dst_size = *out_size;
+      size_t ret = LZ4F_decompress (dec->lz4, *out, &dst_size, *in, &src_size,
+          NULL);
+
+      if (LZ4F_isError (ret)) {
+        *error = LZ4F_getErrorName (ret);
+        return GST_GZ_DECODE_ERROR;
+      }
+      *in += src_size;
+      *in_size -= src_size;
+      *out += dst_size;
+      *out_size -= dst_size;
+      return ret == 0 ? GST_GZ_DECODE_END : GST_GZ_DECODE_OK;
+    }
+#endif
+#ifdef HAVE_BZIP2
+    case GST_GZ_FORMAT_BZIP2:
+    {
+      /* the counts are unsigned ints, the caller loops for the rest */
+      guint avail_in = (guint) MIN (*in_size, G_MAXUINT);
+      guint avail_out = (guint) MIN (*out_size, G_MAXUINT);
+      int ret;
+
+      dec->bz.next_in = (char *) *in;
+      dec->bz.avail_in = avail_in;
+      dec->bz.next_out = (char *) *out;
+      dec->bz.avail_out = avail_out;
+      ret = BZ2_bzDecompress (&dec->bz);
+      if (ret != BZ_OK && ret != BZ_STREAM_END) {
+        *error = "invalid bzip2 data";
+        return GST_GZ_DECODE_ERROR;
+      }
+      *in += avail_in - dec->bz.avail_in;
+      *in_size -= avail_in - dec->bz.avail_in;
+      *out += avail_out - dec->bz.avail_out;
+      *out_size -= avail_out - dec->bz.avail_out;
+      if (ret != BZ_STREAM_END)
+        return GST_GZ_DECODE_OK;
+
+      /* unlike zstd and lz4 the state can't take another stream as is */
+      BZ2_bzDecompressEnd (&dec->bz);
+      if (BZ2_bzDecompressInit (&dec->bz, 0, 0) != BZ_OK)
+        dec->format = GST_GZ_FORMAT_UNKNOWN;
+      return GST_GZ_DECODE_END;
+    }
+#endif
+    default:
+      *error = "unsupported format";
+      return GST_GZ_DECODE_ERROR;
+  }
+}
@@ -0,0 +1,125 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_FORMAT_H__
+#define __GST_GZ_FORMAT_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Compressed formats gzdec can take. The deflate based ones go through the
+ * zlib inflate state, the others through a GstGzStreamDecoder when their
+ * library was found at build time. */
+typedef enum
+{
+  GST_GZ_FORMAT_UNKNOWN,
+  GST_GZ_FORMAT_GZIP,
+  GST_GZ_FORMAT_ZLIB,
+  GST_GZ_FORMAT_DEFLATE,        /* raw deflate, no header to sniff */
+  GST_GZ_FORMAT_ZSTD,
+  GST_GZ_FORMAT_LZ4,
+  GST_GZ_FORMAT_BZIP2
+} GstGzFormat;
+
+/* bytes gst_gz_format_sniff() needs to tell the formats apart */
+#define GST_GZ_FORMAT_MAGIC_SIZE 4
+
+/* sink caps for the formats this build can decode */
+#define GST_GZ_FORMAT_DEFLATE_CAPS \
+  "application/x-gzip; application/x-zlib; application/x-deflate"
+#ifdef HAVE_ZSTD
+#define GST_GZ_FORMAT_ZSTD_CAPS "; application/zstd"
+#else
+#define GST_GZ_FORMAT_ZSTD_CAPS ""
+#endif
+#ifdef HAVE_LZ4
+#define GST_GZ_FORMAT_LZ4_CAPS "; application/x-lz4"
+#else
+#define GST_GZ_FORMAT_LZ4_CAPS ""
+#endif
+#ifdef HAVE_BZIP2
+#define GST_GZ_FORMAT_BZIP2_CAPS "; application/x-bzip"
+#else
+#define GST_GZ_FORMAT_BZIP2_CAPS ""
+#endif
+#define GST_GZ_FORMAT_CAPS GST_GZ_FORMAT_DEFLATE_CAPS GST_GZ_FORMAT_ZSTD_CAPS \
+  GST_GZ_FORMAT_LZ4_CAPS GST_GZ_FORMAT_BZIP2_CAPS
+
+/* looks at the first size bytes of a stream, GST_GZ_FORMAT_UNKNOWN when no
+ * magic matches */
+GstGzFormat gst_gz_format_sniff (const guint8 * data, gsize size);
+GstGzFormat gst_gz_format_from_caps (const GstCaps * caps);
+/* the FNAME of the gzip member header at data. Returns 1 and sets *name,
+ * 0 when the header has no name or data is no gzip header, -1 when more
+ * of the header is needed. */
+gint gst_gz_format_parse_file_name (const guint8 * data, gsize size,
+    gchar ** name);
+const gchar * gst_gz_format_get_name (GstGzFormat format);
+/* whether the zlib inflate state decodes format, and with which windowBits */
+gboolean gst_gz_format_is_deflate (GstGzFormat format);
+gint gst_gz_format_get_window_bits (GstGzFormat format);
+
+typedef struct _GstGzStreamDecoder GstGzStreamDecoder;
+
+typedef enum
+{
+  GST_GZ_DECODE_OK,
+  GST_GZ_DECODE_END,            /* a frame is complete, more may follow */
+  GST_GZ_DECODE_ERROR
+} GstGzDecodeResult;
+
+/* NULL when format is deflate based or support for it was not built */
+GstGzStreamDecoder * gst_gz_stream_decoder_new (GstGzFormat format);
+void gst_gz_stream_decoder_free (GstGzStreamDecoder * dec);
+
+/* decodes from *in into *out and advances both past what was used. Data may
+ * stay buffered in the decoder while *out_size is 0, call again with more
+ * room. On error *error points at a static description. */
+GstGzDecodeResult gst_gz_stream_decoder_decode (GstGzStreamDecoder * dec,
+    const guint8 ** in, gsize * in_size, guint8 ** out, gsize * out_size,
+    const gchar ** error);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_FORMAT_H__ */
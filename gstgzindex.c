@@ -0,0 +1,361 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gstgzindex.h"
+
+/* sidecar layout, all numbers little endian:
+ *   magic[8], guint64 length (G_MAXUINT64 when unknown),
+ *   guint64 compressed size (G_MAXUINT64 when unknown), guint32 crc32 of
+ *   the first GST_GZ_INDEX_HEAD_SIZE compressed bytes, guint32 count,
+ *   then per checkpoint: guint64 in, guint64 out, guint32 bits,
+ *   guint32 window size, window bytes */
+#define GST_GZ_INDEX_MAGIC "GZDIDX02"
+#define GST_GZ_INDEX_MAGIC_SIZE 8
+#define GST_GZ_INDEX_HEADER_SIZE (GST_GZ_INDEX_MAGIC_SIZE + 8 + 8 + 4 + 4)
+#define GST_GZ_INDEX_POINT_SIZE (8 + 8 + 4 + 4)
+
+struct _GstGzIndex
+{
+  GMutex lock;
+  guint64 interval;
+  /* GstGzCheckpoint, ordered by out */
+  GPtrArray *points;
+  guint64 length;
+  gboolean have_length;
+  /* the compressed input the checkpoints belong to */
+  gboolean have_source;
+  guint64 source_size;
+  guint32 source_crc;
+  gboolean dirty;
+};
+
+static void
+gst_gz_checkpoint_free (gpointer data)
+{
+  GstGzCheckpoint *point = data;
+
+  g_free (point->window);
+  g_free (point);
+}
+
+GstGzIndex *
+gst_gz_index_new (guint64 interval)
+{
+  GstGzIndex *index = g_new0 (GstGzIndex, 1);
+
+  g_mutex_init (&index->lock);
+  index->interval = interval;
+  index->points = g_ptr_array_new_with_free_func (gst_gz_checkpoint_free);
+
+  return index;
+}
+
+void
+gst_gz_index_free (GstGzIndex * index)
+{
+  g_ptr_array_unref (index->points);
+  g_mutex_clear (&index->lock);
+  g_free (index);
+}
+
+static GstGzCheckpoint *
+gst_gz_index_last (GstGzIndex * index)
+{
+  if (index->points->len == 0)
+    return NULL;
+
+  return g_ptr_array_index (index->points, index->points->len - 1);
+}
+
+gboolean
+gst_gz_index_wants (GstGzIndex * index, guint64 out)
+{
+  GstGzCheckpoint *last;
+  gboolean ret;
+
+  g_mutex_lock (&index->lock);
+  last = gst_gz_index_last (index);
+  ret = last ? out >= last->out + index->interval : TRUE;
+  g_mutex_unlock (&index->lock);
+
+  return ret;
+}
+
+void
+gst_gz_index_add (GstGzIndex * index, guint64 in, guint64 out, guint bits,
+    const guint8 * window, gsize window_size)
+{
+  GstGzCheckpoint *point, *last;
+
+  g_return_if_fail (window_size <= GST_GZ_INDEX_WINDOW_SIZE);
+
+  g_mutex_lock (&index->lock);
+  /* decoding again over an indexed range, e.g. after a backwards seek */
+  last = gst_gz_index_last (index);
+  if (last && out < last->out + index->interval) {
+    g_mutex_unlock (&index->lock);
+    return;
+  }
+
+  point = g_new0 (GstGzCheckpoint, 1);
+  point->in = in;
+  point->out = out;
+  point->bits = bits;
+  point->window_size = window_size;
+  point->window = g_memdup2 (window, window_size);
+  g_ptr_array_add (index->points, point);
+  index->dirty = TRUE;
+  g_mutex_unlock (&index->lock);
+}
+
+const GstGzCheckpoint *
+gst_gz_index_lookup (GstGzIndex * index, guint64 out)
+{
+  GstGzCheckpoint *point = NULL;
+  guint lo = 0, hi;
+
+  g_mutex_lock (&index->lock);
+  hi = index->points->len;
+  /* binary search for the last point with point->out <= out */
+  while (lo < hi) {
+    guint mid = lo + (hi - lo) / 2;
+    GstGzCheckpoint *p = g_ptr_array_index (index->points, mid);
+
+    if (p->out <= out) {
+      point = p;
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  g_mutex_unlock (&index->lock);
+
+  return point;
+}
+
+void
+gst_gz_index_set_length (GstGzIndex * index, guint64 length)
+{
+  g_mutex_lock (&index->lock);
+  if (!index->have_length || index->length != length) {
+    index->length = length;
+    index->have_length = TRUE;
+    index->dirty = TRUE;
+  }
+  g_mutex_unlock (&index->lock);
+}
+
+gboolean
+gst_gz_index_get_length (GstGzIndex * index, guint64 * length)
+{
+  gboolean ret;
+
+  g_mutex_lock (&index->lock);
+  ret = index->have_length;
+  if (ret)
+    *length = index->length;
+  g_mutex_unlock (&index->lock);
+
+  return ret;
+}
+
+void
+gst_gz_index_set_source (GstGzIndex * index, guint64 size, guint32 head_crc)
+{
+  g_mutex_lock (&index->lock);
+  if (!index->have_source || index->source_size != size ||
+      index->source_crc != head_crc) {
+    index->have_source = TRUE;
+    index->source_size = size;
+    index->source_crc = head_crc;
+    index->dirty = TRUE;
+  }
+  g_mutex_unlock (&index->lock);
+}
+
+gboolean
+gst_gz_index_matches (GstGzIndex * index, guint64 size, guint32 head_crc)
+{
+  gboolean ret;
+
+  g_mutex_lock (&index->lock);
+  ret = index->have_source && index->source_crc == head_crc &&
+      (index->source_size == G_MAXUINT64 || size == G_MAXUINT64 ||
+      index->source_size == size);
+  g_mutex_unlock (&index->lock);
+
+  return ret;
+}
+
+gboolean
+gst_gz_index_is_dirty (GstGzIndex * index)
+{
+  gboolean ret;
+
+  g_mutex_lock (&index->lock);
+  ret = index->dirty;
+  g_mutex_unlock (&index->lock);
+
+  return ret;
+}
+
+gboolean
+gst_gz_index_save (GstGzIndex * index, const gchar * location,
+    GError ** error)
+{
+  GByteArray *data;
+  guint8 header[GST_GZ_INDEX_HEADER_SIZE];
+  gboolean ret;
+  guint i;
+
+  g_mutex_lock (&index->lock);
+  data = g_byte_array_new ();
+
+  memcpy (header, GST_GZ_INDEX_MAGIC, GST_GZ_INDEX_MAGIC_SIZE);
+  GST_WRITE_UINT64_LE (header + 8,
+      index->have_length ? index->length : G_MAXUINT64);
+  GST_WRITE_UINT64_LE (header + 16,
+      index->have_source ? index->source_size : G_MAXUINT64);
+  GST_WRITE_UINT32_LE (header + 24, index->source_crc);
+  GST_WRITE_UINT32_LE (header + 28, index->points->len);
+  g_byte_array_append (data, header, sizeof (header));
+
+  for (i = 0; i < index->points->len; i++) {
+    GstGzCheckpoint *point = g_ptr_array_index (index->points, i);
+    guint8 entry[GST_GZ_INDEX_POINT_SIZE];
+
+    GST_WRITE_UINT64_LE (entry, point->in);
+    GST_WRITE_UINT64_LE (entry + 8, point->out);
+    GST_WRITE_UINT32_LE (entry + 16, point->bits);
+    GST_WRITE_UINT32_LE (entry + 20, point->window_size);
+    g_byte_array_append (data, entry, sizeof (entry));
+    g_byte_array_append (data, point->window, point->window_size);
+  }
+
+  ret = g_file_set_contents (location, (const gchar *) data->data, data->len,
+      error);
+  if (ret)
+    index->dirty = FALSE;
+
+  g_byte_array_unref (data);
+  g_mutex_unlock (&index->lock);
+
+  return ret;
+}
+
+GstGzIndex *
+gst_gz_index_load (const gchar * location, guint64 interval, GError ** error)
+{
+  GstGzIndex *index;
+  gchar *contents;
+  const guint8 *data;
+  gsize size, pos;
+  guint64 length;
+  guint32 count, i;
+
+  if (!g_file_get_contents (location, &contents, &size, error))
+    return NULL;
+
+  data = (const guint8 *) contents;
+  if (size < GST_GZ_INDEX_HEADER_SIZE ||
+      memcmp (data, GST_GZ_INDEX_MAGIC, GST_GZ_INDEX_MAGIC_SIZE) != 0)
+    goto invalid;
+
+  index = gst_gz_index_new (interval);
+  length = GST_READ_UINT64_LE (data + 8);
+  if (length != G_MAXUINT64) {
+    index->length = length;
+    index->have_length = TRUE;
+  }
+  index->have_source = TRUE;
+  index->source_size = GST_READ_UINT64_LE (data + 16);
+  index->source_crc = GST_READ_UINT32_LE (data + 24);
+  count = GST_READ_UINT32_LE (data + 28);
+
+  pos = GST_GZ_INDEX_HEADER_SIZE;
+  for (i = 0; i < count; i++) {
+    GstGzCheckpoint *point, *last;
+    gsize window_size;
+
+    if (size - pos < GST_GZ_INDEX_POINT_SIZE)
+      goto invalid_point;
+    window_size = GST_READ_UINT32_LE (data + pos + 20);
+    if (window_size > GST_GZ_INDEX_WINDOW_SIZE ||
+        size - pos - GST_GZ_INDEX_POINT_SIZE < window_size)
+      goto invalid_point;
+
+    point = g_new0 (GstGzCheckpoint, 1);
+    point->in = GST_READ_UINT64_LE (data + pos);
+    point->out = GST_READ_UINT64_LE (data + pos + 8);
+    point->bits = GST_READ_UINT32_LE (data + pos + 16) & 7;
+    point->window_size = window_size;
+    point->window = g_memdup2 (data + pos + GST_GZ_INDEX_POINT_SIZE,
+        window_size);
+    pos += GST_GZ_INDEX_POINT_SIZE + window_size;
+
+    last = gst_gz_index_last (index);
+    if (last && point->out <= last->out) {
+      gst_gz_checkpoint_free (point);
+      goto invalid_point;
+    }
+    g_ptr_array_add (index->points, point);
+  }
+
+  g_free (contents);
+
+  return index;
+
+invalid_point:
+  gst_gz_index_free (index);
+invalid:
+  g_free (contents);
+  g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_INVAL,
+      "%s is not a valid gzdec index", location);
+  return NULL;
+}
@@ -0,0 +1,107 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_INDEX_H__
+#define __GST_GZ_INDEX_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* deflate never refers back further than this */
+#define GST_GZ_INDEX_WINDOW_SIZE 32768
+
+typedef struct _GstGzIndex GstGzIndex;
+typedef struct _GstGzCheckpoint GstGzCheckpoint;
+
+/* A point at a deflate block boundary where raw inflate can be restarted:
+ * seek the input to in (minus one byte when bits is not 0, that byte
+ * holds the first bits of the next block), prime inflate with those bits
+ * and preset the window. */
+struct _GstGzCheckpoint
+{
+  guint64 in;                   /* compressed offset */
+  guint64 out;                  /* decoded offset */
+  guint bits;                   /* unused bits in the byte before in */
+  gsize window_size;
+  guint8 *window;               /* the output right before out */
+};
+
+GstGzIndex * gst_gz_index_new (guint64 interval);
+void gst_gz_index_free (GstGzIndex * index);
+
+/* TRUE when a checkpoint at decoded offset out would be far enough from
+ * the last one to be worth recording */
+gboolean gst_gz_index_wants (GstGzIndex * index, guint64 out);
+void gst_gz_index_add (GstGzIndex * index, guint64 in, guint64 out,
+    guint bits, const guint8 * window, gsize window_size);
+/* the last checkpoint at or before out, NULL if there is none. Checkpoints
+ * stay valid until the index is freed. */
+const GstGzCheckpoint * gst_gz_index_lookup (GstGzIndex * index,
+    guint64 out);
+
+/* decoded size of the whole stream, once it has been decoded to the end */
+void gst_gz_index_set_length (GstGzIndex * index, guint64 length);
+gboolean gst_gz_index_get_length (GstGzIndex * index, guint64 * length);
+
+/* An index is tied to the compressed input it was built from by its size
+ * (G_MAXUINT64 when unknown, then it is not compared) and the crc32 of its
+ * first GST_GZ_INDEX_HEAD_SIZE bytes, all of it when shorter. A loaded
+ * index only matches the input it was saved for. */
+#define GST_GZ_INDEX_HEAD_SIZE 4096
+
+void gst_gz_index_set_source (GstGzIndex * index, guint64 size,
+    guint32 head_crc);
+gboolean gst_gz_index_matches (GstGzIndex * index, guint64 size,
+    guint32 head_crc);
+
+/* sidecar file support */
+gboolean gst_gz_index_is_dirty (GstGzIndex * index);
+gboolean gst_gz_index_save (GstGzIndex * index, const gchar * location,
+    GError ** error);
+GstGzIndex * gst_gz_index_load (const gchar * location, guint64 interval,
+    GError ** error);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_INDEX_H__ */
@@ -0,0 +1,297 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "gstgzqueue.h"
+
+/* who is waiting on cond */
+#define GZ_QUEUE_PRODUCER 1
+#define GZ_QUEUE_CONSUMER 2
+
+struct _GstGzQueue
+{
+  GstPad *pad;
+  GThread *thread;
+
+  /* a power of two, items are at head up to tail. head only moves once
+   * a push returned, so head == tail means everything reached the pad. */
+  GstMiniObject **ring;
+  guint mask;
+  guint max_buffers;
+  gsize max_bytes;
+  gint head;
+  gint tail;
+  gssize bytes;
+
+  gint flow;
+  gint flushing;
+  gint stopping;
+
+  /* only taken to sleep and to wake a sleeper */
+  GMutex lock;
+  GCond cond;
+  gint waiting;
+};
+
+static gsize
+gst_gz_queue_size_of (GstMiniObject * obj)
+{
+  if (GST_IS_BUFFER (obj))
+    return gst_buffer_get_size (GST_BUFFER_CAST (obj));
+  return gst_buffer_list_calculate_size ((GstBufferList *) obj);
+}
+
+static guint
+gst_gz_queue_length (GstGzQueue * queue)
+{
+  return (guint) g_atomic_int_get (&queue->tail) -
+      (guint) g_atomic_int_get (&queue->head);
+}
+
+static gboolean
+gst_gz_queue_full (GstGzQueue * queue)
+{
+  guint length = gst_gz_queue_length (queue);
+
+  if (g_atomic_int_get (&queue->flushing))
+    return FALSE;
+  if (length >= queue->max_buffers)
+    return TRUE;
+  return queue->max_bytes > 0 && length > 0 &&
+      (gsize) g_atomic_pointer_get (&queue->bytes) >= queue->max_bytes;
+}
+
+static gboolean
+gst_gz_queue_busy (GstGzQueue * queue)
+{
+  return gst_gz_queue_length (queue) > 0;
+}
+
+static gboolean
+gst_gz_queue_idle (GstGzQueue * queue)
+{
+  return gst_gz_queue_length (queue) == 0 &&
+      !g_atomic_int_get (&queue->stopping);
+}
+
+/* the flag is set before blocked() is checked again and the other side
+ * looks at it after publishing, so no wakeup is lost */
+static void
+gst_gz_queue_wait (GstGzQueue * queue, gint who,
+    gboolean (*blocked) (GstGzQueue * queue))
+{
+  g_mutex_lock (&queue->lock);
+  g_atomic_int_or ((guint *) & queue->waiting, who);
+  while (blocked (queue))
+    g_cond_wait (&queue->cond, &queue->lock);
+  g_atomic_int_and ((guint *) & queue->waiting, ~who);
+  g_mutex_unlock (&queue->lock);
+}
+
+static void
+gst_gz_queue_wake (GstGzQueue * queue, gint who)
+{
+  if (!(g_atomic_int_get (&queue->waiting) & who))
+    return;
+
+  g_mutex_lock (&queue->lock);
+  g_cond_broadcast (&queue->cond);
+  g_mutex_unlock (&queue->lock);
+}
+
+static gpointer
+gst_gz_queue_run (gpointer data)
+{
+  GstGzQueue *queue = data;
+
+  for (;;) {
+    GstMiniObject *obj;
+    GstFlowReturn flow = GST_FLOW_OK;
+    gsize size;
+    guint head;
+
+    if (!gst_gz_queue_busy (queue)) {
+      gst_gz_queue_wait (queue, GZ_QUEUE_CONSUMER, gst_gz_queue_idle);
+      if (!gst_gz_queue_busy (queue))
+        break;
+    }
+
+    head = (guint) g_atomic_int_get (&queue->head);
+    obj = queue->ring[head & queue->mask];
+    queue->ring[head & queue->mask] = NULL;
+    size = gst_gz_queue_size_of (obj);
+
+    if (g_atomic_int_get (&queue->flushing) ||
+        g_atomic_int_get (&queue->flow) != GST_FLOW_OK) {
+      gst_mini_object_unref (obj);
+    } else if (GST_IS_BUFFER (obj)) {
+      flow = gst_pad_push (queue->pad, GST_BUFFER_CAST (obj));
+    } else {
+      flow = gst_pad_push_list (queue->pad, (GstBufferList *) obj);
+    }
+    if (flow != GST_FLOW_OK)
+      g_atomic_int_compare_and_exchange (&queue->flow, GST_FLOW_OK, flow);
+
+    g_atomic_pointer_add (&queue->bytes, -(gssize) size);
+    g_atomic_int_inc (&queue->head);
+    gst_gz_queue_wake (queue, GZ_QUEUE_PRODUCER);
+  }
+
+  return NULL;
+}
+
+GstGzQueue *
+gst_gz_queue_new (GstPad * pad, guint max_buffers, guint64 max_bytes)
+{
+  GstGzQueue *queue;
+  guint size = 1;
+
+  g_return_val_if_fail (max_buffers > 0, NULL);
+  g_return_val_if_fail (max_buffers <= GST_GZ_QUEUE_MAX_BUFFERS, NULL);
+
+  while (size < max_buffers)
+    size <<= 1;
+
+  queue = g_new0 (GstGzQueue, 1);
+  queue->pad = gst_object_ref (pad);
+  queue->ring = g_new0 (GstMiniObject *, size);
+  queue->mask = size - 1;
+  queue->max_buffers = max_buffers;
+  queue->max_bytes = (gsize) MIN (max_bytes, G_MAXSSIZE);
+  queue->flow = GST_FLOW_OK;
+  g_mutex_init (&queue->lock);
+  g_cond_init (&queue->cond);
+
+  queue->thread = g_thread_try_new ("gzdec-push", gst_gz_queue_run, queue,
+      NULL);
+  if (!queue->thread) {
+    gst_gz_queue_free (queue);
+    return NULL;
+  }
+
+  return queue;
+}
+
+void
+gst_gz_queue_free (GstGzQueue * queue)
+{
+  guint i;
+
+  if (queue->thread) {
+    g_atomic_int_set (&queue->flushing, TRUE);
+    g_atomic_int_set (&queue->stopping, TRUE);
+    g_mutex_lock (&queue->lock);
+    g_cond_broadcast (&queue->cond);
+    g_mutex_unlock (&queue->lock);
+    g_thread_join (queue->thread);
+  }
+
+  for (i = 0; i <= queue->mask; i++)
+    if (queue->ring[i])
+      gst_mini_object_unref (queue->ring[i]);
+  g_free (queue->ring);
+  gst_object_unref (queue->pad);
+  g_cond_clear (&queue->cond);
+  g_mutex_clear (&queue->lock);
+  g_free (queue);
+}
+
+GstFlowReturn
+gst_gz_queue_push (GstGzQueue * queue, GstMiniObject * obj)
+{
+  GstFlowReturn flow;
+  gsize size = gst_gz_queue_size_of (obj);
+  guint tail;
+
+  if (gst_gz_queue_full (queue))
+    gst_gz_queue_wait (queue, GZ_QUEUE_PRODUCER, gst_gz_queue_full);
+
+  if (g_atomic_int_get (&queue->flushing)) {
+    gst_mini_object_unref (obj);
+    return GST_FLOW_FLUSHING;
+  }
+  flow = g_atomic_int_get (&queue->flow);
+  if (flow != GST_FLOW_OK) {
+    gst_mini_object_unref (obj);
+    return flow;
+  }
+
+  tail = (guint) g_atomic_int_get (&queue->tail);
+  queue->ring[tail & queue->mask] = obj;
+  g_atomic_pointer_add (&queue->bytes, (gssize) size);
+  g_atomic_int_inc (&queue->tail);
+  gst_gz_queue_wake (queue, GZ_QUEUE_CONSUMER);
+
+  return GST_FLOW_OK;
+}
+
+GstFlowReturn
+gst_gz_queue_drain (GstGzQueue * queue)
+{
+  if (gst_gz_queue_busy (queue))
+    gst_gz_queue_wait (queue, GZ_QUEUE_PRODUCER, gst_gz_queue_busy);
+
+  if (g_atomic_int_get (&queue->flushing))
+    return GST_FLOW_FLUSHING;
+  return g_atomic_int_get (&queue->flow);
+}
+
+void
+gst_gz_queue_set_flushing (GstGzQueue * queue, gboolean flushing)
+{
+  if (flushing) {
+    g_atomic_int_set (&queue->flushing, TRUE);
+    g_mutex_lock (&queue->lock);
+    g_cond_broadcast (&queue->cond);
+    g_mutex_unlock (&queue->lock);
+    return;
+  }
+
+  /* the push thread drops the rest quickly while still flushing */
+  gst_gz_queue_drain (queue);
+  g_atomic_int_set (&queue->flow, GST_FLOW_OK);
+  g_atomic_int_set (&queue->flushing, FALSE);
+}
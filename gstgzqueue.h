@@ -0,0 +1,80 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_QUEUE_H__
+#define __GST_GZ_QUEUE_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Decoded buffers and buffer lists handed from the decoding thread to a
+ * thread of their own that pushes them on a pad, so inflate and a slow
+ * downstream overlap. The ring has a single producer and a single
+ * consumer and takes no lock unless one side has to wait. */
+typedef struct _GstGzQueue GstGzQueue;
+
+/* the ring is allocated up front, this keeps it at 512 KiB */
+#define GST_GZ_QUEUE_MAX_BUFFERS 65536
+
+/* at most max_buffers and, unless 0, max_bytes are queued, a single
+ * buffer over max_bytes still goes through */
+GstGzQueue * gst_gz_queue_new (GstPad * pad, guint max_buffers,
+    guint64 max_bytes);
+/* drops what was not pushed yet */
+void gst_gz_queue_free (GstGzQueue * queue);
+
+/* takes obj, a buffer or buffer list, and waits while the queue is full.
+ * Returns the first flow other than GST_FLOW_OK the pad returned, from
+ * then on everything is dropped until the queue is flushed. */
+GstFlowReturn gst_gz_queue_push (GstGzQueue * queue, GstMiniObject * obj);
+/* waits until everything queued was pushed, before a serialized event */
+GstFlowReturn gst_gz_queue_drain (GstGzQueue * queue);
+
+/* while flushing, pushes fail and queued data is dropped. Leaving it
+ * waits until the queue is empty and clears the flow. */
+void gst_gz_queue_set_flushing (GstGzQueue * queue, gboolean flushing);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_QUEUE_H__ */
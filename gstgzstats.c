@@ -0,0 +1,196 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+
+#include "gstgzstats.h"
+
+void
+gst_gz_stats_init (GstGzStats * stats)
+{
+  g_mutex_init (&stats->lock);
+  gst_gz_stats_reset (stats);
+}
+
+void
+gst_gz_stats_clear (GstGzStats * stats)
+{
+  g_mutex_clear (&stats->lock);
+}
+
+void
+gst_gz_stats_reset (GstGzStats * stats)
+{
+  g_mutex_lock (&stats->lock);
+  stats->buffers = 0;
+  stats->bytes_in = 0;
+  stats->bytes_out = 0;
+  stats->allocations = 0;
+  stats->decode_time = 0;
+  stats->push_time = 0;
+  memset (stats->latency, 0, sizeof (stats->latency));
+  g_mutex_unlock (&stats->lock);
+}
+
+static guint
+gst_gz_stats_bucket (GstClockTime t)
+{
+  guint log2, shift;
+
+  if (t < GST_GZ_STATS_SUB_BUCKETS)
+    return (guint) t;
+
+  /* the power of two picks the bucket, the next 3 bits the sub bucket */
+  log2 = g_bit_storage (t) - 1;
+  shift = log2 - 3;
+
+  return (log2 - 2) * GST_GZ_STATS_SUB_BUCKETS +
+      (guint) ((t >> shift) & (GST_GZ_STATS_SUB_BUCKETS - 1));
+}
+
+/* the largest time falling into bucket */
+static GstClockTime
+gst_gz_stats_bucket_limit (guint bucket)
+{
+  guint log2, sub;
+
+  if (bucket < GST_GZ_STATS_SUB_BUCKETS)
+    return bucket;
+
+  log2 = bucket / GST_GZ_STATS_SUB_BUCKETS + 2;
+  sub = bucket % GST_GZ_STATS_SUB_BUCKETS;
+  if (log2 >= 63)
+    return G_MAXUINT64 - 1;
+
+  return ((G_GUINT64_CONSTANT (1) << log2) |
+      ((guint64) sub << (log2 - 3))) + (G_GUINT64_CONSTANT (1) << (log2 - 3)) - 1;
+}
+
+void
+gst_gz_stats_add_buffer (GstGzStats * stats, gsize in_size, guint64 out_size,
+    guint allocations, GstClockTime latency, GstClockTime push_time)
+{
+  guint bucket = MIN (gst_gz_stats_bucket (latency), GST_GZ_STATS_BUCKETS - 1);
+
+  g_mutex_lock (&stats->lock);
+  stats->buffers++;
+  stats->bytes_in += in_size;
+  stats->bytes_out += out_size;
+  stats->allocations += allocations;
+  stats->decode_time += latency - MIN (push_time, latency);
+  stats->push_time += push_time;
+  stats->latency[bucket]++;
+  g_mutex_unlock (&stats->lock);
+}
+
+void
+gst_gz_stats_add_output (GstGzStats * stats, guint64 out_size,
+    guint allocations, GstClockTime push_time)
+{
+  g_mutex_lock (&stats->lock);
+  stats->bytes_out += out_size;
+  stats->allocations += allocations;
+  stats->push_time += push_time;
+  g_mutex_unlock (&stats->lock);
+}
+
+static GstClockTime
+gst_gz_stats_get_latency_unlocked (GstGzStats * stats, gdouble percentile)
+{
+  guint64 rank, seen = 0;
+  guint i;
+
+  if (stats->buffers == 0)
+    return GST_CLOCK_TIME_NONE;
+
+  rank = (guint64) (stats->buffers * CLAMP (percentile, 0, 100) / 100.0);
+  rank = CLAMP (rank, 1, stats->buffers);
+
+  for (i = 0; i < GST_GZ_STATS_BUCKETS; i++) {
+    seen += stats->latency[i];
+    if (seen >= rank)
+      return gst_gz_stats_bucket_limit (i);
+  }
+
+  return gst_gz_stats_bucket_limit (GST_GZ_STATS_BUCKETS - 1);
+}
+
+GstClockTime
+gst_gz_stats_get_latency (GstGzStats * stats, gdouble percentile)
+{
+  GstClockTime latency;
+
+  g_mutex_lock (&stats->lock);
+  latency = gst_gz_stats_get_latency_unlocked (stats, percentile);
+  g_mutex_unlock (&stats->lock);
+
+  return latency;
+}
+
+GstStructure *
+gst_gz_stats_to_structure (GstGzStats * stats, const gchar * name)
+{
+  GstStructure *s;
+
+  g_mutex_lock (&stats->lock);
+  s = gst_structure_new (name,
+      "buffers", G_TYPE_UINT64, stats->buffers,
+      "bytes-in", G_TYPE_UINT64, stats->bytes_in,
+      "bytes-out", G_TYPE_UINT64, stats->bytes_out,
+      "compression-ratio", G_TYPE_DOUBLE, stats->bytes_in ?
+      (gdouble) stats->bytes_out / stats->bytes_in : 0.0,
+      "allocations", G_TYPE_UINT64, stats->allocations,
+      "decode-time", G_TYPE_UINT64, stats->decode_time,
+      "push-time", G_TYPE_UINT64, stats->push_time,
+      "latency-p50", G_TYPE_UINT64,
+      gst_gz_stats_get_latency_unlocked (stats, 50),
+      "latency-p99", G_TYPE_UINT64,
+      gst_gz_stats_get_latency_unlocked (stats, 99), NULL);
+  g_mutex_unlock (&stats->lock);
+
+  return s;
+}
@@ -0,0 +1,99 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_STATS_H__
+#define __GST_GZ_STATS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* latency histogram: 8 buckets per power of two nanoseconds, enough to
+ * tell percentiles apart within 12.5% */
+#define GST_GZ_STATS_SUB_BUCKETS 8
+#define GST_GZ_STATS_BUCKETS (64 * GST_GZ_STATS_SUB_BUCKETS)
+
+/* Counters the streaming thread adds to once per input buffer and any
+ * thread may read. */
+typedef struct
+{
+  GMutex lock;
+
+  guint64 buffers;
+  guint64 bytes_in;
+  guint64 bytes_out;
+  guint64 allocations;
+  /* time spent decoding, excluding the time downstream took in push */
+  GstClockTime decode_time;
+  GstClockTime push_time;
+  guint64 latency[GST_GZ_STATS_BUCKETS];
+} GstGzStats;
+
+void gst_gz_stats_init (GstGzStats * stats);
+void gst_gz_stats_clear (GstGzStats * stats);
+void gst_gz_stats_reset (GstGzStats * stats);
+
+/* one input buffer of in_size bytes went out as out_size decoded bytes in
+ * allocations output buffers. It took latency from arriving to the last
+ * push returning, push_time of that in downstream. */
+void gst_gz_stats_add_buffer (GstGzStats * stats, gsize in_size,
+    guint64 out_size, guint allocations, GstClockTime latency,
+    GstClockTime push_time);
+
+/* out_size decoded bytes in allocations output buffers that no input
+ * buffer accounts for, such as what is drained at EOS. Left out of the
+ * buffer count and the latency histogram. */
+void gst_gz_stats_add_output (GstGzStats * stats, guint64 out_size,
+    guint allocations, GstClockTime push_time);
+
+/* per-buffer latency at percentile (0-100), GST_CLOCK_TIME_NONE while no
+ * buffer was seen */
+GstClockTime gst_gz_stats_get_latency (GstGzStats * stats, gdouble percentile);
+
+/* snapshot of all counters, for properties and element messages */
+GstStructure * gst_gz_stats_to_structure (GstGzStats * stats,
+    const gchar * name);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_STATS_H__ */
@@ -0,0 +1,461 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <zlib.h>
+#ifdef HAVE_LIBDEFLATE
+#include <libdeflate.h>
+#elif defined (HAVE_ISAL)
+#include <isa-l/crc.h>
+#endif
+
+#include "gstgzverify.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_gz_verify_debug);
+#define GST_CAT_DEFAULT gst_gz_verify_debug
+
+/* gzip header flags, RFC 1952 */
+#define GZ_FHCRC 0x02
+#define GZ_FEXTRA 0x04
+#define GZ_FNAME 0x08
+#define GZ_FCOMMENT 0x10
+
+/* libdeflate and ISA-L pick a PCLMULQDQ or ARMv8 CRC32 kernel at run
+ * time. Without either, zlib-ng does the same, stock zlib falls back to
+ * its table driven loop. */
+static guint32
+gst_gz_verify_crc32 (guint32 crc, const guint8 * data, gsize size)
+{
+#ifdef HAVE_LIBDEFLATE
+  return libdeflate_crc32 (crc, data, size);
+#elif defined (HAVE_ISAL)
+  return crc32_gzip_refl (crc, data, size);
+#else
+  while (size > 0) {
+    uInt n = (uInt) MIN (size, G_MAXUINT);
+
+    crc = crc32 (crc, data, n);
+    data += n;
+    size -= n;
+  }
+  return crc;
+#endif
+}
+
+enum
+{
+  HEADER_FIXED,
+  HEADER_XLEN,
+  HEADER_EXTRA,
+  HEADER_NAME,
+  HEADER_COMMENT,
+  HEADER_HCRC,
+  HEADER_DONE
+};
+
+void
+gst_gz_header_init (GstGzHeader * header)
+{
+  header->state = HEADER_FIXED;
+  header->flags = 0;
+  header->len = 0;
+  header->need = 10;
+}
+
+/* collect header->need bytes into header->bytes, TRUE once they are there */
+static gboolean
+gst_gz_header_collect (GstGzHeader * header, const guint8 ** data,
+    gsize * size)
+{
+  gsize n = MIN (*size, header->need - header->len);
+
+  memcpy (header->bytes + header->len, *data, n);
+  header->len += n;
+  *data += n;
+  *size -= n;
+
+  return header->len == header->need;
+}
+
+/* skip to the end of a zero terminated field, TRUE once it is passed */
+static gboolean
+gst_gz_header_skip_string (const guint8 ** data, gsize * size)
+{
+  const guint8 *end = memchr (*data, 0, *size);
+  gsize n = end ? end - *data + 1 : *size;
+
+  *data += n;
+  *size -= n;
+
+  return end != NULL;
+}
+
+/* after the field in state is done, go to the next one in flags */
+static void
+gst_gz_header_next (GstGzHeader * header)
+{
+  header->len = 0;
+  switch (header->state) {
+    case HEADER_FIXED:
+      header->state = HEADER_XLEN;
+      header->need = 2;
+      if (header->flags & GZ_FEXTRA)
+        break;
+      /* fall through */
+    case HEADER_XLEN:
+    case HEADER_EXTRA:
+      header->state = HEADER_NAME;
+      if (header->flags & GZ_FNAME)
+        break;
+      /* fall through */
+    case HEADER_NAME:
+      header->state = HEADER_COMMENT;
+      if (header->flags & GZ_FCOMMENT)
+        break;
+      /* fall through */
+    case HEADER_COMMENT:
+      header->state = HEADER_HCRC;
+      header->need = 2;
+      if (header->flags & GZ_FHCRC)
+        break;
+      /* fall through */
+    default:
+      header->state = HEADER_DONE;
+      break;
+  }
+}
+
+gint
+gst_gz_header_parse (GstGzHeader * header, const guint8 ** data,
+    gsize * size)
+{
+  while (header->state != HEADER_DONE) {
+    if (*size == 0)
+      return 0;
+
+    switch (header->state) {
+      case HEADER_FIXED:
+        if (!gst_gz_header_collect (header, data, size))
+          return 0;
+        if (header->bytes[0] != 0x1f || header->bytes[1] != 0x8b ||
+            header->bytes[2] != Z_DEFLATED || (header->bytes[3] & 0xe0))
+          return -1;
+        header->flags = header->bytes[3];
+        gst_gz_header_next (header);
+        break;
+      case HEADER_XLEN:
+        if (!gst_gz_header_collect (header, data, size))
+          return 0;
+        header->need = GST_READ_UINT16_LE (header->bytes);
+        header->state = HEADER_EXTRA;
+        break;
+      case HEADER_EXTRA:
+      {
+        /* the extra field is skipped, need counts down what is left */
+        gsize n = MIN (*size, header->need);
+
+        *data += n;
+        *size -= n;
+        header->need -= n;
+        if (header->need > 0)
+          return 0;
+        gst_gz_header_next (header);
+        break;
+      }
+      case HEADER_NAME:
+      case HEADER_COMMENT:
+        if (!gst_gz_header_skip_string (data, size))
+          return 0;
+        gst_gz_header_next (header);
+        break;
+      case HEADER_HCRC:
+        if (!gst_gz_header_collect (header, data, size))
+          return 0;
+        gst_gz_header_next (header);
+        break;
+    }
+  }
+
+  return 1;
+}
+
+typedef enum
+{
+  ITEM_DATA,
+  ITEM_START,
+  ITEM_END
+} GstGzVerifyItemType;
+
+typedef struct
+{
+  GstGzVerifyItemType type;
+  /* ITEM_DATA: decoded bytes, following the previous ones */
+  GstBuffer *buf;
+  /* ITEM_START and ITEM_END: where in the decoded bytes the member starts
+   * or ends, and its trailer */
+  guint64 offset;
+  guint8 trailer[GST_GZ_TRAILER_SIZE];
+  guint generation;
+} GstGzVerifyItem;
+
+struct _GstGzVerify
+{
+  GThreadPool *pool;
+  GstGzVerifyErrorFunc error;
+  gpointer user_data;
+  /* bumped by reset, older items are dropped */
+  gint generation;
+
+  /* only touched by the checking thread. Member boundaries are queued
+   * before the data they fall into, they wait in marks until pos gets
+   * there. */
+  guint cur_generation;
+  guint64 pos;
+  GQueue marks;
+  gboolean active;
+  guint32 crc;
+  guint32 size;
+  guint64 member;
+};
+
+static void
+gst_gz_verify_item_free (GstGzVerifyItem * item)
+{
+  if (item->buf)
+    gst_buffer_unref (item->buf);
+  g_free (item);
+}
+
+static void
+gst_gz_verify_mark (GstGzVerify * verify, GstGzVerifyItem * mark)
+{
+  guint32 crc, size;
+  gchar *message = NULL;
+
+  if (mark->type == ITEM_START) {
+    verify->active = TRUE;
+    verify->crc = 0;
+    verify->size = 0;
+    return;
+  }
+
+  /* a member that was not decoded from its start can't be checked */
+  if (!verify->active)
+    return;
+  verify->active = FALSE;
+
+  crc = GST_READ_UINT32_LE (mark->trailer);
+  size = GST_READ_UINT32_LE (mark->trailer + 4);
+  if (crc != verify->crc)
+    message = g_strdup_printf ("CRC32 mismatch in gzip member %"
+        G_GUINT64_FORMAT ": %08x in the trailer, %08x decoded",
+        verify->member, crc, verify->crc);
+  else if (size != verify->size)
+    message = g_strdup_printf ("length mismatch in gzip member %"
+        G_GUINT64_FORMAT ": %u in the trailer, %u decoded",
+        verify->member, size, verify->size);
+
+  if (message) {
+    verify->error (message, verify->user_data);
+    g_free (message);
+  } else {
+    GST_LOG ("gzip member %" G_GUINT64_FORMAT " verified", verify->member);
+  }
+  verify->member++;
+}
+
+/* apply the marks that pos has reached */
+static void
+gst_gz_verify_apply_marks (GstGzVerify * verify)
+{
+  GstGzVerifyItem *mark;
+
+  while ((mark = g_queue_peek_head (&verify->marks)) &&
+      mark->offset <= verify->pos) {
+    g_queue_pop_head (&verify->marks);
+    gst_gz_verify_mark (verify, mark);
+    gst_gz_verify_item_free (mark);
+  }
+}
+
+static void
+gst_gz_verify_data (GstGzVerify * verify, const guint8 * data, gsize size)
+{
+  while (size > 0) {
+    GstGzVerifyItem *mark = g_queue_peek_head (&verify->marks);
+    gsize n = size;
+
+    /* stop at the next member boundary */
+    if (mark)
+      n = MIN (n, mark->offset - verify->pos);
+
+    if (verify->active) {
+      verify->crc = gst_gz_verify_crc32 (verify->crc, data, n);
+      verify->size += (guint32) n;
+    }
+    data += n;
+    size -= n;
+    verify->pos += n;
+    gst_gz_verify_apply_marks (verify);
+  }
+}
+
+static void
+gst_gz_verify_run (gpointer data, gpointer user_data)
+{
+  GstGzVerifyItem *item = data;
+  GstGzVerify *verify = user_data;
+  GstMapInfo map;
+
+  if (item->generation != (guint) g_atomic_int_get (&verify->generation)) {
+    gst_gz_verify_item_free (item);
+    return;
+  }
+
+  if (item->generation != verify->cur_generation) {
+    verify->cur_generation = item->generation;
+    g_queue_clear_full (&verify->marks,
+        (GDestroyNotify) gst_gz_verify_item_free);
+    verify->pos = 0;
+    verify->active = FALSE;
+    verify->member = 0;
+  }
+
+  if (item->type != ITEM_DATA) {
+    g_queue_push_tail (&verify->marks, item);
+    gst_gz_verify_apply_marks (verify);
+    return;
+  }
+
+  if (gst_buffer_map (item->buf, &map, GST_MAP_READ)) {
+    gst_gz_verify_data (verify, map.data, map.size);
+    gst_buffer_unmap (item->buf, &map);
+  }
+  gst_gz_verify_item_free (item);
+}
+
+GstGzVerify *
+gst_gz_verify_new (GstGzVerifyErrorFunc error, gpointer user_data)
+{
+  GstGzVerify *verify;
+  GError *err = NULL;
+
+  GST_DEBUG_CATEGORY_INIT (gst_gz_verify_debug, "gzverify", 0,
+      "deferred gzip verification");
+
+  verify = g_new0 (GstGzVerify, 1);
+  verify->error = error;
+  verify->user_data = user_data;
+  g_queue_init (&verify->marks);
+
+  /* one thread keeps the items in order */
+  verify->pool = g_thread_pool_new (gst_gz_verify_run, verify, 1, TRUE, &err);
+  if (!verify->pool) {
+    GST_WARNING ("could not start the verification thread: %s",
+        err->message);
+    g_clear_error (&err);
+    g_free (verify);
+    return NULL;
+  }
+
+  return verify;
+}
+
+void
+gst_gz_verify_free (GstGzVerify * verify)
+{
+  g_thread_pool_free (verify->pool, FALSE, TRUE);
+  g_queue_clear_full (&verify->marks,
+      (GDestroyNotify) gst_gz_verify_item_free);
+  g_free (verify);
+}
+
+static void
+gst_gz_verify_push (GstGzVerify * verify, GstGzVerifyItem * item)
+{
+  item->generation = g_atomic_int_get (&verify->generation);
+  if (!g_thread_pool_push (verify->pool, item, NULL))
+    gst_gz_verify_item_free (item);
+}
+
+void
+gst_gz_verify_add (GstGzVerify * verify, GstBuffer * buf)
+{
+  GstGzVerifyItem *item = g_new0 (GstGzVerifyItem, 1);
+
+  item->type = ITEM_DATA;
+  item->buf = buf;
+  gst_gz_verify_push (verify, item);
+}
+
+void
+gst_gz_verify_start (GstGzVerify * verify, guint64 offset)
+{
+  GstGzVerifyItem *item = g_new0 (GstGzVerifyItem, 1);
+
+  item->type = ITEM_START;
+  item->offset = offset;
+  gst_gz_verify_push (verify, item);
+}
+
+void
+gst_gz_verify_end (GstGzVerify * verify, guint64 offset,
+    const guint8 * trailer)
+{
+  GstGzVerifyItem *item = g_new0 (GstGzVerifyItem, 1);
+
+  item->type = ITEM_END;
+  item->offset = offset;
+  memcpy (item->trailer, trailer, GST_GZ_TRAILER_SIZE);
+  gst_gz_verify_push (verify, item);
+}
+
+void
+gst_gz_verify_reset (GstGzVerify * verify)
+{
+  g_atomic_int_inc (&verify->generation);
+}
@@ -0,0 +1,100 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_VERIFY_H__
+#define __GST_GZ_VERIFY_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* Parses the gzip member header ahead of raw inflate, so the body can be
+ * decoded without zlib computing the CRC32 as it goes. */
+typedef struct
+{
+  /* < private > */
+  gint state;
+  guint8 flags;
+  guint8 bytes[10];
+  guint len;
+  guint need;
+} GstGzHeader;
+
+void gst_gz_header_init (GstGzHeader * header);
+/* consumes header bytes from *data, advancing it and *size. Returns 1 once
+ * the header is complete, 0 when it needs more input, -1 if it is not a
+ * gzip header. */
+gint gst_gz_header_parse (GstGzHeader * header, const guint8 ** data,
+    gsize * size);
+
+/* size of the CRC32 and ISIZE trailer of a member */
+#define GST_GZ_TRAILER_SIZE 8
+
+/* Runs the CRC32 and length check of decoded members on a thread of its
+ * own, over buffers that were already pushed and may span several
+ * members. A mismatch is reported through the error callback from that
+ * thread. */
+typedef struct _GstGzVerify GstGzVerify;
+
+typedef void (*GstGzVerifyErrorFunc) (const gchar * message,
+    gpointer user_data);
+
+GstGzVerify * gst_gz_verify_new (GstGzVerifyErrorFunc error,
+    gpointer user_data);
+/* waits for the checks still queued */
+void gst_gz_verify_free (GstGzVerify * verify);
+
+/* queue the next decoded bytes. Offsets count these bytes from the
+ * first one added after a reset. */
+void gst_gz_verify_add (GstGzVerify * verify, GstBuffer * buf);
+/* a member starts or ends at offset, with trailer holding its CRC32 and
+ * ISIZE. Boundaries may be queued before the bytes they fall into. */
+void gst_gz_verify_start (GstGzVerify * verify, guint64 offset);
+void gst_gz_verify_end (GstGzVerify * verify, guint64 offset,
+    const guint8 * trailer);
+/* forget the member in progress and anything still queued for it */
+void gst_gz_verify_reset (GstGzVerify * verify);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_VERIFY_H__ */
@@ -0,0 +1,212 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "gstgzworkers.h"
+
+struct _GstGzWorkers
+{
+  GThreadPool *pool;
+  guint n_threads;
+
+  GstGzJobFunc func;
+  gpointer user_data;
+  /* what the threads bind themselves to before their first job */
+  const GstGzAffinity *affinity;
+
+  /* jobs in push order, protected by lock */
+  GMutex lock;
+  GCond cond;
+  GQueue jobs;
+};
+
+GstGzJob *
+gst_gz_job_new (void)
+{
+  GstGzJob *job = g_new0 (GstGzJob, 1);
+
+  job->input = gst_buffer_list_new ();
+
+  return job;
+}
+
+void
+gst_gz_job_free (GstGzJob * job)
+{
+  if (job->input)
+    gst_buffer_list_unref (job->input);
+  if (job->output)
+    gst_buffer_unref (job->output);
+  g_free (job);
+}
+
+/* the workers the current thread was bound for, the threads are exclusive
+ * to one pool and go away with it */
+static GPrivate workers_bound;
+
+static void
+gst_gz_workers_run (gpointer data, gpointer user_data)
+{
+  GstGzJob *job = data;
+  GstGzWorkers *workers = user_data;
+
+  if (workers->affinity && g_private_get (&workers_bound) != workers) {
+    gst_gz_affinity_apply (workers->affinity);
+    g_private_set (&workers_bound, workers);
+  }
+
+  workers->func (job, workers->user_data);
+
+  g_mutex_lock (&workers->lock);
+  job->done = TRUE;
+  g_cond_broadcast (&workers->cond);
+  g_mutex_unlock (&workers->lock);
+}
+
+GstGzWorkers *
+gst_gz_workers_new (guint n_threads, GstGzJobFunc func, gpointer user_data)
+{
+  GstGzWorkers *workers;
+
+  g_return_val_if_fail (n_threads > 0, NULL);
+  g_return_val_if_fail (func != NULL, NULL);
+
+  workers = g_new0 (GstGzWorkers, 1);
+  workers->n_threads = n_threads;
+  workers->func = func;
+  workers->user_data = user_data;
+  g_mutex_init (&workers->lock);
+  g_cond_init (&workers->cond);
+  g_queue_init (&workers->jobs);
+
+  workers->pool = g_thread_pool_new (gst_gz_workers_run, workers, n_threads,
+      TRUE, NULL);
+  if (!workers->pool) {
+    gst_gz_workers_free (workers);
+    return NULL;
+  }
+
+  return workers;
+}
+
+void
+gst_gz_workers_free (GstGzWorkers * workers)
+{
+  GstGzJob *job;
+
+  /* let the running and queued jobs finish before dropping them */
+  if (workers->pool)
+    g_thread_pool_free (workers->pool, FALSE, TRUE);
+
+  while ((job = g_queue_pop_head (&workers->jobs)))
+    gst_gz_job_free (job);
+
+  g_cond_clear (&workers->cond);
+  g_mutex_clear (&workers->lock);
+  g_free (workers);
+}
+
+void
+gst_gz_workers_set_affinity (GstGzWorkers * workers,
+    const GstGzAffinity * affinity)
+{
+  workers->affinity = affinity;
+}
+
+guint
+gst_gz_workers_get_n_threads (GstGzWorkers * workers)
+{
+  return workers->n_threads;
+}
+
+guint
+gst_gz_workers_get_pending (GstGzWorkers * workers)
+{
+  guint pending;
+
+  g_mutex_lock (&workers->lock);
+  pending = workers->jobs.length;
+  g_mutex_unlock (&workers->lock);
+
+  return pending;
+}
+
+gboolean
+gst_gz_workers_push (GstGzWorkers * workers, GstGzJob * job)
+{
+  job->done = FALSE;
+
+  g_mutex_lock (&workers->lock);
+  g_queue_push_tail (&workers->jobs, job);
+  g_mutex_unlock (&workers->lock);
+
+  if (!g_thread_pool_push (workers->pool, job, NULL)) {
+    g_mutex_lock (&workers->lock);
+    g_queue_remove (&workers->jobs, job);
+    g_mutex_unlock (&workers->lock);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+GstGzJob *
+gst_gz_workers_pop (GstGzWorkers * workers, gboolean wait)
+{
+  GstGzJob *job;
+
+  g_mutex_lock (&workers->lock);
+  job = g_queue_peek_head (&workers->jobs);
+  while (job && !job->done && wait)
+    g_cond_wait (&workers->cond, &workers->lock);
+  if (job && job->done)
+    g_queue_pop_head (&workers->jobs);
+  else
+    job = NULL;
+  g_mutex_unlock (&workers->lock);
+
+  return job;
+}
@@ -0,0 +1,100 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GST_GZ_WORKERS_H__
+#define __GST_GZ_WORKERS_H__
+
+#include <gst/gst.h>
+
+#include "gstgzaffinity.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GstGzWorkers GstGzWorkers;
+typedef struct _GstGzJob GstGzJob;
+
+/* runs on a worker thread, fills in output and result of job */
+typedef void (*GstGzJobFunc) (GstGzJob * job, gpointer user_data);
+
+struct _GstGzJob
+{
+  /* compressed members, one buffer each, or for gzenc the block to
+   * compress followed by its dictionary */
+  GstBufferList *input;
+  /* buffer the job writes into and how much of it was used */
+  GstBuffer *output;
+  gsize output_size;
+  /* zlib return code of the last member */
+  gint result;
+  /* gzenc: the block ends the stream, and the crc32 of its data */
+  gboolean last;
+  guint32 check;
+
+  /* < private > */
+  gboolean done;
+};
+
+GstGzJob * gst_gz_job_new (void);
+void gst_gz_job_free (GstGzJob * job);
+
+/* A fixed set of threads running jobs, whose results are handed back in the
+ * order the jobs were pushed. */
+GstGzWorkers * gst_gz_workers_new (guint n_threads, GstGzJobFunc func,
+    gpointer user_data);
+void gst_gz_workers_free (GstGzWorkers * workers);
+/* must be called before the first push, affinity has to outlive workers */
+void gst_gz_workers_set_affinity (GstGzWorkers * workers,
+    const GstGzAffinity * affinity);
+
+guint gst_gz_workers_get_n_threads (GstGzWorkers * workers);
+/* number of jobs pushed but not popped yet */
+guint gst_gz_workers_get_pending (GstGzWorkers * workers);
+
+gboolean gst_gz_workers_push (GstGzWorkers * workers, GstGzJob * job);
+/* returns the oldest job once it is done. Without wait NULL is returned
+ * while it is still running, with wait only when nothing is pending. */
+GstGzJob * gst_gz_workers_pop (GstGzWorkers * workers, gboolean wait);
+
+G_END_DECLS
+
+#endif /* __GST_GZ_WORKERS_H__ */
@@ -48,13 +48,55 @@
  * SECTION:element-gzdec
  *
  * gzip decoder that receives a stream compressed with gzip and emits an
- * uncompressed stream.
+ * uncompressed stream. The format is sniffed from the first bytes, so zlib,
+ * zstd, lz4 and bzip2 streams work too (the last three when their libraries
+ * were found at build time). Raw deflate has no magic, it is assumed when
+ * nothing else matches or upstream says application/x-deflate.
  *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
  * gst-launch -v -m filesrc location=file.txt.gz ! gzdec ! filesink location="file.txt"
  * ]|
+ * BGZF input (block gzip, as written by bgzip) can be decoded on several
+ * threads at once:
+ * |[
+ * gst-launch -v -m filesrc location=file.txt.gz ! gzdec threads=0 ! filesink location="file.txt"
+ * ]|
+ * Flushing seeks in BYTES format on the src pad are supported. With
+ * index-interval set, gzdec records an inflate checkpoint every so many
+ * decoded bytes and resumes from the nearest one instead of decoding the
+ * stream from the start. index-location keeps the index in a sidecar file
+ * for the next run.
+ *
+ * When upstream can be pulled from, gzdec drives its sink pad from its own
+ * task and reads the compressed data in large aligned ranges. Its src pad
+ * can then be pulled from too, decoded ranges are served in decoded byte
+ * offsets.
+ *
+ * For live input flush-mode controls how long decoded data may wait for
+ * more input. With sync, output goes out wherever the sender flushed:
+ * |[
+ * gst-launch -v tcpclientsrc host=127.0.0.1 port=5000 ! gzdec flush-mode=sync ! fdsink
+ * ]|
+ * Throughput and per-buffer latency are counted all the time and can be
+ * read from the stats and related read-only properties. With
+ * stats-interval set, the same counters are posted as "gzdec-stats"
+ * element messages, which tracers see through the element-post-message
+ * hooks.
+ *
+ * For trusted input verify=deferred moves the gzip CRC32 off the decoding
+ * thread: it is computed on a helper thread over the pushed output and a
+ * mismatch is posted as an error once it is found. The helper uses the
+ * CRC32 of libdeflate or ISA-L when the plugin was built with one, zlib's
+ * otherwise. verify=none skips it.
+ *
+ * Concatenated gzip members, as in cat a.gz b.gz, decode as one stream.
+ * trailing-data picks what happens to anything else after a member.
+ *
+ * Behind a message source, messages=true treats every input buffer as a
+ * gzip, zlib or deflate message of its own. Buffer lists are decoded in
+ * one pass and pushed as one list, with a buffer per message.
  * </refsect2>
  */
 
@@ -63,8 +105,12 @@
 #endif
 
 #include <gst/gst.h>
+#include <gst/base/gsttypefindhelper.h>
 
 #include "gstplugin.h"
+#include "gstgzenc.h"
+#include "gstgzfiledec.h"
+#include "gsttransform.h"
 
 
 
@@ -80,16 +126,105 @@ enum
 enum
 {
   PROP_0,
-  PROP_SILENT
+  PROP_SILENT,
+  PROP_MAX_OUTPUT_MEMORY,
+  PROP_THREADS,
+  PROP_BACKEND,
+  PROP_INDEX_INTERVAL,
+  PROP_INDEX_LOCATION,
+  PROP_MIN_OUTPUT_SIZE,
+  PROP_MAX_OUTPUT_SIZE,
+  PROP_FLUSH_MODE,
+  PROP_VERIFY,
+  PROP_TRAILING_DATA,
+  PROP_DICTIONARY,
+  PROP_MESSAGES,
+  PROP_DICTIONARY_LOCATION,
+  PROP_CPU_SET,
+  PROP_NUMA_NODE,
+  PROP_MAX_QUEUED_BUFFERS,
+  PROP_MAX_QUEUED_BYTES,
+  PROP_MEMBER_LOOKAHEAD,
+  PROP_MAX_OUTPUT_BYTES,
+  PROP_MAX_RATIO,
+  PROP_STATS_INTERVAL,
+  PROP_STATS,
+  PROP_BYTES_IN,
+  PROP_BYTES_OUT,
+  PROP_COMPRESSION_RATIO,
+  PROP_DECODE_TIME,
+  PROP_PUSH_TIME,
+  PROP_ALLOCATIONS,
+  PROP_LATENCY_P50,
+  PROP_LATENCY_P99
 };
 
+#define DEFAULT_MAX_OUTPUT_MEMORY 0
+#define DEFAULT_THREADS 1
+#define DEFAULT_INDEX_INTERVAL 0
+#define DEFAULT_INDEX_LOCATION NULL
+#define DEFAULT_MIN_OUTPUT_SIZE (4 * 1024)
+#define DEFAULT_MAX_OUTPUT_SIZE (4 * 1024 * 1024)
+#define DEFAULT_FLUSH_MODE GST_GZDEC_FLUSH_PER_BUFFER
+#define DEFAULT_VERIFY GST_GZDEC_VERIFY_FULL
+#define DEFAULT_TRAILING GST_GZDEC_TRAILING_STOP
+#define DEFAULT_DICTIONARY_LOCATION NULL
+#define DEFAULT_MESSAGES FALSE
+#define DEFAULT_CPU_SET NULL
+#define DEFAULT_NUMA_NODE -1
+#define DEFAULT_MAX_QUEUED_BUFFERS 0
+#define DEFAULT_MAX_QUEUED_BYTES 0
+#define DEFAULT_MEMBER_LOOKAHEAD 0
+#define DEFAULT_MAX_OUTPUT_BYTES 0
+#define DEFAULT_MAX_RATIO 0.0
+/* max-ratio is only looked at from this much decoded data on, the first
+ * bytes of a stream say little */
+#define GZDEC_RATIO_MIN_OUTPUT (1024 * 1024)
+/* ring size when only max-queued-bytes limits the queue */
+#define GZDEC_QUEUE_BUFFERS 1024
+
+/* 1f 8b 08, how the next gzip member has to start */
+#define GZDEC_MEMBER_MAGIC_SIZE 3
+#define DEFAULT_STATS_INTERVAL 0
+
+/* decoded/compressed ratio assumed before any output was seen */
+#define GZDEC_INITIAL_RATIO 4
+
+/* fixed part of a gzip member header with the BGZF extra field */
+#define GZDEC_BGZF_HEADER_SIZE 18
+/* how much of a member header is looked at to find the BC subfield */
+#define GZDEC_BGZF_PEEK_SIZE 64
+/* smallest possible block: header, empty deflate block and trailer */
+#define GZDEC_BGZF_MIN_BLOCK_SIZE 28
+/* BGZF blocks never decode to more than 64 KiB */
+#define GZDEC_BGZF_MAX_ISIZE 65536
+
+/* how much of the stream is kept to find the FNAME of its gzip header */
+#define GZDEC_NAME_PEEK_SIZE 4096
+
+/* gzip member header without optional fields, and the smallest member:
+ * header, empty deflate block and trailer */
+#define GZDEC_MEMBER_HEADER_SIZE 10
+#define GZDEC_MEMBER_MIN_SIZE 20
+/* deflate can't expand data by more than this */
+#define GZDEC_DEFLATE_MAX_RATIO 1032
+/* a guessed member's size comes from bytes that may not be a trailer at
+ * all, none larger than this or a pool buffer is allocated up front */
+#define GZDEC_MEMBER_MAX_ISIZE (4*1024*1024)
+
+/* compressed bytes read per pull in pull mode, reads are aligned to it */
+#define GZDEC_PULL_SIZE (1024*1024)
+/* slabs decoded messages are carved from are whole cache lines */
+#define GZDEC_SLAB_ALIGN 64
+
 /* the capabilities of the inputs and outputs.
- * filesrc and filesink also set its capability to ANY so leave both as ANY.
+ * The sink takes the compressed formats this build can decode, so
+ * decodebin can plug us. What comes out is unknown, so the src is ANY.
  */
 static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS ("ANY")
+    GST_STATIC_CAPS (GST_GZ_FORMAT_CAPS)
 );
 
 static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
@@ -98,16 +233,102 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
     GST_STATIC_CAPS ("ANY")
     );
 
+#define GST_TYPE_GZDEC_FLUSH_MODE (gst_gzdec_flush_mode_get_type ())
+static GType
+gst_gzdec_flush_mode_get_type (void)
+{
+  static GType flush_mode_type = 0;
+  static const GEnumValue flush_modes[] = {
+    {GST_GZDEC_FLUSH_NONE, "Only push full buffers", "none"},
+    {GST_GZDEC_FLUSH_SYNC, "Push when the input ends on a flush point",
+        "sync"},
+    {GST_GZDEC_FLUSH_PER_BUFFER, "Push at the end of every input buffer",
+        "per-buffer"},
+    {0, NULL, NULL},
+  };
+
+  if (!flush_mode_type)
+    flush_mode_type = g_enum_register_static ("GstGzdecFlushMode", flush_modes);
+
+  return flush_mode_type;
+}
+
+#define GST_TYPE_GZDEC_VERIFY (gst_gzdec_verify_get_type ())
+static GType
+gst_gzdec_verify_get_type (void)
+{
+  static GType verify_type = 0;
+  static const GEnumValue verify_modes[] = {
+    {GST_GZDEC_VERIFY_FULL, "Check while inflating", "full"},
+    {GST_GZDEC_VERIFY_DEFERRED,
+        "Check on a helper thread after pushing, errors come later",
+        "deferred"},
+    {GST_GZDEC_VERIFY_NONE, "Do not check", "none"},
+    {0, NULL, NULL},
+  };
+
+  if (!verify_type)
+    verify_type = g_enum_register_static ("GstGzdecVerify", verify_modes);
+
+  return verify_type;
+}
+
+#define GST_TYPE_GZDEC_TRAILING (gst_gzdec_trailing_get_type ())
+static GType
+gst_gzdec_trailing_get_type (void)
+{
+  static GType trailing_type = 0;
+  static const GEnumValue trailing_modes[] = {
+    {GST_GZDEC_TRAILING_CONTINUE, "Skip it and decode any member after it",
+        "continue"},
+    {GST_GZDEC_TRAILING_STOP, "End the stream there", "stop"},
+    {GST_GZDEC_TRAILING_ERROR, "Post an error", "error"},
+    {0, NULL, NULL},
+  };
+
+  if (!trailing_type)
+    trailing_type = g_enum_register_static ("GstGzdecTrailing",
+        trailing_modes);
+
+  return trailing_type;
+}
+
 #define gst_gzdec_parent_class parent_class
 G_DEFINE_TYPE (Gstgzdec, gst_gzdec, GST_TYPE_ELEMENT);
 
+static void gst_gzdec_finalize (GObject * object);
 static void gst_gzdec_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec);
 static void gst_gzdec_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 
+static GstStateChangeReturn gst_gzdec_change_state (GstElement * element,
+    GstStateChange transition);
+
 static gboolean gst_gzdec_sink_event (GstPad * pad, GstObject * parent, GstEvent * event);
+static GstFlowReturn gst_gzdec_drain (Gstgzdec * filter,
+    gboolean * complete);
+static gboolean gst_gzdec_finish (Gstgzdec * filter);
+static GstFlowReturn gst_gzdec_push_output (Gstgzdec * filter,
+    GstBuffer ** outbuf, GstMapInfo * map);
+static GstFlowReturn gst_gzdec_handle_buffer (Gstgzdec * filter, GstBuffer * buf);
+static GstFlowReturn gst_gzdec_chain_list (GstPad * pad, GstObject * parent,
+    GstBufferList * list);
+static void gst_gzdec_account (Gstgzdec * filter, gsize in_size,
+    GstClockTime start);
+static void gst_gzdec_post_stats (Gstgzdec * filter);
+static gboolean gst_gzdec_src_event (GstPad * pad, GstObject * parent, GstEvent * event);
+static gboolean gst_gzdec_src_query (GstPad * pad, GstObject * parent, GstQuery * query);
 static GstFlowReturn gst_gzdec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf);
+static gboolean gst_gzdec_sink_activate (GstPad * pad, GstObject * parent);
+static gboolean gst_gzdec_sink_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active);
+static gboolean gst_gzdec_src_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active);
+static GstFlowReturn gst_gzdec_src_getrange (GstPad * pad, GstObject * parent,
+    guint64 offset, guint length, GstBuffer ** buffer);
+static void gst_gzdec_loop (GstPad * pad);
+static gboolean gst_gzdec_start_loop (Gstgzdec * filter);
 
 /* GObject vmethod implementations */
 
@@ -121,17 +342,214 @@ gst_gzdec_class_init (GstgzdecClass * klass)
   gobject_class = (GObjectClass *) klass;
   gstelement_class = (GstElementClass *) klass;
 
+  gobject_class->finalize = gst_gzdec_finalize;
   gobject_class->set_property = gst_gzdec_set_property;
   gobject_class->get_property = gst_gzdec_get_property;
 
   g_object_class_install_property (gobject_class, PROP_SILENT,
-      g_param_spec_boolean ("silent", "Silent", "Produce verbose output ?",
+      g_param_spec_boolean ("silent", "Silent",
+          "Don't log per-buffer diagnostics to the debug log",
           FALSE, G_PARAM_READWRITE));
 
+  g_object_class_install_property (gobject_class, PROP_MAX_OUTPUT_MEMORY,
+      g_param_spec_uint64 ("max-output-memory", "Max output memory",
+          "Maximum number of bytes in output buffers that downstream may hold "
+          "at once, decoding blocks until buffers are returned (0 = unlimited)",
+          0, G_MAXUINT64, DEFAULT_MAX_OUTPUT_MEMORY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads decoding BGZF blocks in parallel, other input "
+          "is always decoded serially (0 = one per CPU, 1 = serial only)",
+          0, 256, DEFAULT_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_BACKEND,
+      g_param_spec_string ("backend", "Backend",
+          "Inflate implementation the element was built with", NULL,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_INDEX_INTERVAL,
+      g_param_spec_uint64 ("index-interval", "Index interval",
+          "Decoded bytes between seek checkpoints, each costs 32 KiB of "
+          "memory (0 = no index, seeks decode from the start)",
+          0, G_MAXUINT64, DEFAULT_INDEX_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_INDEX_LOCATION,
+      g_param_spec_string ("index-location", "Index location",
+          "Sidecar file the seek index is loaded from and saved to",
+          DEFAULT_INDEX_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MIN_OUTPUT_SIZE,
+      g_param_spec_uint ("min-output-size", "Min output size",
+          "Smallest output buffer to decode into, in bytes",
+          1, G_MAXINT, DEFAULT_MIN_OUTPUT_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_OUTPUT_SIZE,
+      g_param_spec_uint ("max-output-size", "Max output size",
+          "Largest output buffer to decode into, in bytes. In between the "
+          "size follows the input buffer size and the compression ratio",
+          1, G_MAXINT, DEFAULT_MAX_OUTPUT_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_FLUSH_MODE,
+      g_param_spec_enum ("flush-mode", "Flush mode",
+          "When decoded data is pushed before its buffer is full. sync pushes "
+          "whenever the input ends where the sender flushed (Z_SYNC_FLUSH), "
+          "none holds partial buffers for the best throughput",
+          GST_TYPE_GZDEC_FLUSH_MODE, DEFAULT_FLUSH_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_VERIFY,
+      g_param_spec_enum ("verify", "Verify",
+          "How the CRC32 and length of gzip members are checked",
+          GST_TYPE_GZDEC_VERIFY, DEFAULT_VERIFY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_TRAILING_DATA,
+      g_param_spec_enum ("trailing-data", "Trailing data",
+          "What to do with data after a gzip member that is not another "
+          "member", GST_TYPE_GZDEC_TRAILING, DEFAULT_TRAILING,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_DICTIONARY,
+      g_param_spec_boxed ("dictionary", "Dictionary",
+          "Preset dictionary for zlib streams that ask for one and for raw "
+          "deflate, takes precedence over dictionary-location",
+          G_TYPE_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_DICTIONARY_LOCATION,
+      g_param_spec_string ("dictionary-location", "Dictionary location",
+          "File holding the preset dictionary, loaded once and shared by all "
+          "instances", DEFAULT_DICTIONARY_LOCATION,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_CPU_SET,
+      g_param_spec_string ("cpu-set", "CPU set",
+          "CPUs like \"0-7,16-23\" the streaming task and worker threads "
+          "run on, NULL for no binding", DEFAULT_CPU_SET,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_NUMA_NODE,
+      g_param_spec_int ("numa-node", "NUMA node",
+          "NUMA node whose CPUs the streaming task and worker threads run on "
+          "and whose memory they allocate from, -1 for none",
+          -1, G_MAXINT, DEFAULT_NUMA_NODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUED_BUFFERS,
+      g_param_spec_uint ("max-queued-buffers", "Max queued buffers",
+          "Decoded buffers handed to a push thread of our own so decoding "
+          "goes on while downstream is busy, 0 for no limit. With this and "
+          "max-queued-bytes 0 the decoding thread pushes itself",
+          0, GST_GZ_QUEUE_MAX_BUFFERS, DEFAULT_MAX_QUEUED_BUFFERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_QUEUED_BYTES,
+      g_param_spec_uint64 ("max-queued-bytes", "Max queued bytes",
+          "Decoded bytes waiting for the push thread, 0 for no limit",
+          0, G_MAXUINT64, DEFAULT_MAX_QUEUED_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MEMBER_LOOKAHEAD,
+      g_param_spec_uint64 ("member-lookahead", "Member lookahead",
+          "With threads != 1, how many compressed bytes to search ahead for "
+          "the next gzip member of plain multi-member input to decode it "
+          "speculatively, 0 to decode such input serially",
+          0, G_MAXUINT64, DEFAULT_MEMBER_LOOKAHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_OUTPUT_BYTES,
+      g_param_spec_uint64 ("max-output-bytes", "Max output bytes",
+          "Fail with an error once a stream decodes to more than this many "
+          "bytes, 0 for no limit",
+          0, G_MAXUINT64, DEFAULT_MAX_OUTPUT_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_MAX_RATIO,
+      g_param_spec_double ("max-ratio", "Max ratio",
+          "Fail with an error once a stream decodes to more than this many "
+          "times its compressed size, 0 for no limit",
+          0, G_MAXDOUBLE, DEFAULT_MAX_RATIO,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_MESSAGES,
+      g_param_spec_boolean ("messages", "Messages",
+          "Every input buffer is a compressed message of its own, decoded "
+          "into one output buffer", DEFAULT_MESSAGES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS | GST_PARAM_MUTABLE_READY));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Stats interval",
+          "Milliseconds between gzdec-stats element messages, one more is "
+          "posted at the end of the stream (0 = no messages)",
+          0, G_MAXUINT, DEFAULT_STATS_INTERVAL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+          GST_PARAM_MUTABLE_PLAYING));
+
+  g_object_class_install_property (gobject_class, PROP_STATS,
+      g_param_spec_boxed ("stats", "Stats",
+          "All counters below in one structure", GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /* the names below match the fields of the stats structure */
+  g_object_class_install_property (gobject_class, PROP_BYTES_IN,
+      g_param_spec_uint64 ("bytes-in", "Bytes in",
+          "Compressed bytes received since the element went to PAUSED",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_BYTES_OUT,
+      g_param_spec_uint64 ("bytes-out", "Bytes out",
+          "Decoded bytes pushed since the element went to PAUSED",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_COMPRESSION_RATIO,
+      g_param_spec_double ("compression-ratio", "Compression ratio",
+          "Decoded bytes per compressed byte",
+          0, G_MAXDOUBLE, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DECODE_TIME,
+      g_param_spec_uint64 ("decode-time", "Decode time",
+          "Nanoseconds spent decoding, without the time spent in downstream",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_PUSH_TIME,
+      g_param_spec_uint64 ("push-time", "Push time",
+          "Nanoseconds spent pushing output downstream",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_ALLOCATIONS,
+      g_param_spec_uint64 ("allocations", "Allocations",
+          "Output buffers acquired",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P50,
+      g_param_spec_uint64 ("latency-p50", "Latency p50",
+          "Median nanoseconds from an input buffer arriving to its output "
+          "being pushed", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P99,
+      g_param_spec_uint64 ("latency-p99", "Latency p99",
+          "99th percentile of the per input buffer latency in nanoseconds",
+          0, G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  gstelement_class->change_state = GST_DEBUG_FUNCPTR (gst_gzdec_change_state);
+
   gst_element_class_set_details_simple(gstelement_class,
     "gzip decoder",
     "Decoder/File",
-    "Receives a stream compressed with gzip and emits an uncompressed stream",
+    "Receives a stream compressed with gzip, zlib, deflate, zstd, lz4 or "
+    "bzip2 and emits an uncompressed stream",
     "Siwon Kang <<kkangshawn@gmail.com>>");
 
   gst_element_class_add_pad_template (gstelement_class,
@@ -153,16 +571,136 @@ gst_gzdec_init (Gstgzdec * filter)
                               GST_DEBUG_FUNCPTR(gst_gzdec_sink_event));
   gst_pad_set_chain_function (filter->sinkpad,
                               GST_DEBUG_FUNCPTR(gst_gzdec_chain));
-  GST_PAD_SET_PROXY_CAPS (filter->sinkpad);
+  gst_pad_set_chain_list_function (filter->sinkpad,
+                              GST_DEBUG_FUNCPTR(gst_gzdec_chain_list));
+  gst_pad_set_activate_function (filter->sinkpad,
+                              GST_DEBUG_FUNCPTR(gst_gzdec_sink_activate));
+  gst_pad_set_activatemode_function (filter->sinkpad,
+                              GST_DEBUG_FUNCPTR(gst_gzdec_sink_activate_mode));
   gst_element_add_pad (GST_ELEMENT (filter), filter->sinkpad);
 
   filter->srcpad = gst_pad_new_from_static_template (&src_factory, "src");
-  GST_PAD_SET_PROXY_CAPS (filter->srcpad);
+  gst_pad_set_event_function (filter->srcpad,
+                              GST_DEBUG_FUNCPTR(gst_gzdec_src_event));
+  gst_pad_set_query_function (filter->srcpad,
+                              GST_DEBUG_FUNCPTR(gst_gzdec_src_query));
+  gst_pad_set_activatemode_function (filter->srcpad,
+                              GST_DEBUG_FUNCPTR(gst_gzdec_src_activate_mode));
+  gst_pad_set_getrange_function (filter->srcpad,
+                              GST_DEBUG_FUNCPTR(gst_gzdec_src_getrange));
   gst_element_add_pad (GST_ELEMENT (filter), filter->srcpad);
 
   filter->silent = FALSE;
+  filter->stream_end = FALSE;
+  filter->member_end = FALSE;
+  filter->next_magic_len = 0;
+  filter->decoder_ready = FALSE;
+  filter->opened = FALSE;
+  filter->offset = 0;
+  filter->pool = NULL;
+  filter->max_output_memory = DEFAULT_MAX_OUTPUT_MEMORY;
+  filter->threads = DEFAULT_THREADS;
+  filter->workers = NULL;
+  filter->adapter = NULL;
+  filter->job = NULL;
+  filter->job_size = 0;
+  filter->mode = GST_GZDEC_MODE_SERIAL;
+  filter->index_interval = DEFAULT_INDEX_INTERVAL;
+  filter->index_location = g_strdup (DEFAULT_INDEX_LOCATION);
+  filter->min_output_size = DEFAULT_MIN_OUTPUT_SIZE;
+  filter->max_output_size = DEFAULT_MAX_OUTPUT_SIZE;
+  filter->output_size = 0;
+  filter->bytes_in = 0;
+  filter->rate_start = GST_CLOCK_TIME_NONE;
+  filter->rate_time = 0;
+  filter->rate_bytes = 0;
+  filter->rate_total = 0;
+  filter->live = FALSE;
+  filter->flush_mode = DEFAULT_FLUSH_MODE;
+  filter->outbuf = NULL;
+  filter->format = GST_GZ_FORMAT_UNKNOWN;
+  filter->caps_format = GST_GZ_FORMAT_UNKNOWN;
+  filter->magic_len = 0;
+  filter->decoder = NULL;
+  filter->stream = NULL;
+  filter->verify = DEFAULT_VERIFY;
+  filter->framing = GST_GZDEC_FRAMING_NONE;
+  filter->trailer_len = 0;
+  filter->checking = FALSE;
+  filter->verify_pos = 0;
+  filter->trailing = DEFAULT_TRAILING;
+  filter->stream_format = GST_GZ_FORMAT_UNKNOWN;
+  filter->verifier = NULL;
+  filter->dictionary = NULL;
+  filter->dictionary_location = g_strdup (DEFAULT_DICTIONARY_LOCATION);
+  filter->cur_dictionary = NULL;
+  filter->messages = DEFAULT_MESSAGES;
+  filter->cur_messages = FALSE;
+  filter->cpu_set = g_strdup (DEFAULT_CPU_SET);
+  filter->numa_node = DEFAULT_NUMA_NODE;
+  filter->affinity = NULL;
+  filter->affinity_saved = NULL;
+  filter->max_queued_buffers = DEFAULT_MAX_QUEUED_BUFFERS;
+  filter->max_queued_bytes = DEFAULT_MAX_QUEUED_BYTES;
+  filter->queue = NULL;
+  filter->member_lookahead = DEFAULT_MEMBER_LOOKAHEAD;
+  filter->cur_member_lookahead = 0;
+  filter->scan_pos = 0;
+  filter->mispredicted = FALSE;
+  g_queue_init (&filter->replay);
+  filter->caps_sent = FALSE;
+  filter->pending_segment = NULL;
+  filter->max_output_bytes = DEFAULT_MAX_OUTPUT_BYTES;
+  filter->max_ratio = DEFAULT_MAX_RATIO;
+  filter->limit_in = 0;
+  filter->limit_out = 0;
+  filter->file_name = NULL;
+  filter->name_head = NULL;
+  filter->name_done = FALSE;
+  filter->message_bits = 0;
+  gst_gz_stats_init (&filter->stats);
+  filter->stats_interval = DEFAULT_STATS_INTERVAL;
+  filter->stats_last = 0;
+  filter->cur_out = 0;
+  filter->cur_allocations = 0;
+  filter->cur_push_time = 0;
+  filter->index = NULL;
+  filter->loaded_index = NULL;
+  filter->head_index = NULL;
+  filter->index_checked = FALSE;
+  filter->window = NULL;
+  filter->in_offset = 0;
+  filter->out_base = 0;
+  filter->skip = 0;
+  filter->resume = NULL;
+  filter->seek_pending = FALSE;
+  filter->seek_point = NULL;
+  filter->seek_target = 0;
+  filter->seek_in = 0;
+  filter->segment_start = 0;
+  filter->pulling = FALSE;
+  filter->src_pulling = FALSE;
+  filter->in_pos = 0;
+  filter->in_eos = FALSE;
+  filter->need_stream_start = FALSE;
+  filter->need_segment = FALSE;
+  filter->out_adapter = gst_adapter_new ();
+}
+
+static void
+gst_gzdec_finalize (GObject * object)
+{
+  Gstgzdec *filter = GST_GZDEC (object);
+
+  g_free (filter->index_location);
+  if (filter->dictionary)
+    g_bytes_unref (filter->dictionary);
+  g_free (filter->dictionary_location);
+  g_free (filter->cpu_set);
+  g_object_unref (filter->out_adapter);
+  gst_gz_stats_clear (&filter->stats);
 
-  init_decoder ();
+  G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
 static void
@@ -175,6 +713,111 @@ gst_gzdec_set_property (GObject * object, guint prop_id,
     case PROP_SILENT:
       filter->silent = g_value_get_boolean (value);
       break;
+    case PROP_MAX_OUTPUT_MEMORY:
+      GST_OBJECT_LOCK (filter);
+      filter->max_output_memory = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_THREADS:
+      GST_OBJECT_LOCK (filter);
+      filter->threads = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_INDEX_INTERVAL:
+      GST_OBJECT_LOCK (filter);
+      filter->index_interval = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->index_location);
+      filter->index_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MIN_OUTPUT_SIZE:
+      GST_OBJECT_LOCK (filter);
+      filter->min_output_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_OUTPUT_SIZE:
+      GST_OBJECT_LOCK (filter);
+      filter->max_output_size = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_FLUSH_MODE:
+      GST_OBJECT_LOCK (filter);
+      filter->flush_mode = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_VERIFY:
+      GST_OBJECT_LOCK (filter);
+      filter->verify = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TRAILING_DATA:
+      GST_OBJECT_LOCK (filter);
+      filter->trailing = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_DICTIONARY:
+      GST_OBJECT_LOCK (filter);
+      if (filter->dictionary)
+        g_bytes_unref (filter->dictionary);
+      filter->dictionary = g_value_dup_boxed (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_DICTIONARY_LOCATION:
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->dictionary_location);
+      filter->dictionary_location = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MESSAGES:
+      GST_OBJECT_LOCK (filter);
+      filter->messages = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_CPU_SET:
+      GST_OBJECT_LOCK (filter);
+      g_free (filter->cpu_set);
+      filter->cpu_set = g_value_dup_string (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_NUMA_NODE:
+      GST_OBJECT_LOCK (filter);
+      filter->numa_node = g_value_get_int (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_QUEUED_BUFFERS:
+      GST_OBJECT_LOCK (filter);
+      filter->max_queued_buffers = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_QUEUED_BYTES:
+      GST_OBJECT_LOCK (filter);
+      filter->max_queued_bytes = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MEMBER_LOOKAHEAD:
+      GST_OBJECT_LOCK (filter);
+      filter->member_lookahead = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_OUTPUT_BYTES:
+      GST_OBJECT_LOCK (filter);
+      filter->max_output_bytes = g_value_get_uint64 (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_RATIO:
+      GST_OBJECT_LOCK (filter);
+      filter->max_ratio = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_STATS_INTERVAL:
+      GST_OBJECT_LOCK (filter);
+      filter->stats_interval = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (filter);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -191,6 +834,129 @@ gst_gzdec_get_property (GObject * object, guint prop_id,
     case PROP_SILENT:
       g_value_set_boolean (value, filter->silent);
       break;
+    case PROP_MAX_OUTPUT_MEMORY:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint64 (value, filter->max_output_memory);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_THREADS:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->threads);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_BACKEND:
+      g_value_set_string (value, gst_gz_backend_get_name ());
+      break;
+    case PROP_INDEX_INTERVAL:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint64 (value, filter->index_interval);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_INDEX_LOCATION:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->index_location);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MIN_OUTPUT_SIZE:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->min_output_size);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_OUTPUT_SIZE:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->max_output_size);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_FLUSH_MODE:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_enum (value, filter->flush_mode);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_VERIFY:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_enum (value, filter->verify);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_TRAILING_DATA:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_enum (value, filter->trailing);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_DICTIONARY:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_boxed (value, filter->dictionary);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_DICTIONARY_LOCATION:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->dictionary_location);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MESSAGES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_boolean (value, filter->messages);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_CPU_SET:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_string (value, filter->cpu_set);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_NUMA_NODE:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_int (value, filter->numa_node);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_QUEUED_BUFFERS:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->max_queued_buffers);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_QUEUED_BYTES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint64 (value, filter->max_queued_bytes);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MEMBER_LOOKAHEAD:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint64 (value, filter->member_lookahead);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_OUTPUT_BYTES:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint64 (value, filter->max_output_bytes);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_MAX_RATIO:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_double (value, filter->max_ratio);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_STATS_INTERVAL:
+      GST_OBJECT_LOCK (filter);
+      g_value_set_uint (value, filter->stats_interval);
+      GST_OBJECT_UNLOCK (filter);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value,
+          gst_gz_stats_to_structure (&filter->stats, "gzdec-stats"));
+      break;
+    case PROP_BYTES_IN:
+    case PROP_BYTES_OUT:
+    case PROP_COMPRESSION_RATIO:
+    case PROP_DECODE_TIME:
+    case PROP_PUSH_TIME:
+    case PROP_ALLOCATIONS:
+    case PROP_LATENCY_P50:
+    case PROP_LATENCY_P99:
+    {
+      GstStructure *stats;
+
+      stats = gst_gz_stats_to_structure (&filter->stats, "gzdec-stats");
+      g_value_copy (gst_structure_get_value (stats, pspec->name), value);
+      gst_structure_free (stats);
+      break;
+    }
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -199,210 +965,3461 @@ gst_gzdec_get_property (GObject * object, guint prop_id,
 
 /* GstElement vmethod implementations */
 
-/* this function handles sink events */
-static gboolean
-gst_gzdec_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+/* set up the seek index, from the sidecar file when there is one */
+static void
+gst_gzdec_open_index (Gstgzdec * filter)
 {
-  Gstgzdec *filter;
-  gboolean ret;
-
-  filter = GST_GZDEC (parent);
+  GError *err = NULL;
+  guint64 interval;
+  gchar *location;
 
-  GST_LOG_OBJECT (filter, "Received %s event: %" GST_PTR_FORMAT,
-      GST_EVENT_TYPE_NAME (event), event);
-
-  switch (GST_EVENT_TYPE (event)) {
-    case GST_EVENT_CAPS:
-    {
-      GstCaps * caps;
+  GST_OBJECT_LOCK (filter);
+  interval = filter->index_interval;
+  location = g_strdup (filter->index_location);
+  GST_OBJECT_UNLOCK (filter);
 
-      gst_event_parse_caps (event, &caps);
-      /* do something with the caps */
+  if (interval == 0)
+    goto done;
 
-      /* and forward */
-      ret = gst_pad_event_default (pad, parent, event);
-      break;
+  /* only trusted once the input turns out to be what it was made for */
+  if (location && g_file_test (location, G_FILE_TEST_EXISTS)) {
+    filter->loaded_index = gst_gz_index_load (location, interval, &err);
+    if (!filter->loaded_index) {
+      GST_ELEMENT_WARNING (filter, RESOURCE, READ, (NULL),
+          ("Ignoring index %s: %s", location, err->message));
+      g_clear_error (&err);
     }
-    default:
-      ret = gst_pad_event_default (pad, parent, event);
-      break;
   }
+  filter->index = gst_gz_index_new (interval);
+  filter->index_checked = FALSE;
+  filter->head_crc = crc32 (0L, Z_NULL, 0);
+  filter->head_len = 0;
+  filter->window = g_malloc (GST_GZ_INDEX_WINDOW_SIZE);
 
-  return ret;
+done:
+  g_free (location);
 }
-z_stream stream;
 
-gint
-init_decoder (void)
+static void
+gst_gzdec_save_index (Gstgzdec * filter)
 {
-  gint ret;
+  GError *err = NULL;
+  gchar *location;
 
-  /* allocate inflate state */
-  stream.zalloc = Z_NULL;
-  stream.zfree = Z_NULL;
-  stream.opaque = Z_NULL;
-  stream.avail_in = 0;
-  stream.next_in = Z_NULL;
+  /* an index not known to belong to the input would replace a good one */
+  if (!filter->index || !filter->index_checked ||
+      !gst_gz_index_is_dirty (filter->index))
+    return;
 
-  ret = inflateInit2 (&stream, 16 + MAX_WBITS);
+  GST_OBJECT_LOCK (filter);
+  location = g_strdup (filter->index_location);
+  GST_OBJECT_UNLOCK (filter);
 
-  return ret;
+  if (location && !gst_gz_index_save (filter->index, location, &err)) {
+    GST_ELEMENT_WARNING (filter, RESOURCE, WRITE, (NULL),
+        ("Failed to save index %s: %s", location, err->message));
+    g_clear_error (&err);
+  }
+  g_free (location);
 }
 
-void
-deinit_decoder (void)
+/* decide whether the loaded sidecar belongs to the input: same size, as
+ * far as upstream knows it, and the same head. Otherwise the index built
+ * while decoding is tied to the input and replaces it. */
+static void
+gst_gzdec_verify_index (Gstgzdec * filter)
 {
-  /* clean up and return */
-  (void)inflateEnd(&stream);
+  gint64 size = -1;
+  guint64 in_size = G_MAXUINT64;
+
+  if (!filter->index || filter->index_checked)
+    return;
+  filter->index_checked = TRUE;
+
+  if (gst_pad_peer_query_duration (filter->sinkpad, GST_FORMAT_BYTES, &size)
+      && size >= 0)
+    in_size = size;
+
+  if (filter->loaded_index && gst_gz_index_matches (filter->loaded_index,
+          in_size, filter->head_crc)) {
+    GST_DEBUG_OBJECT (filter, "loaded index matches the input");
+    /* checkpoints handed out so far stay valid until close */
+    filter->head_index = filter->index;
+    filter->index = filter->loaded_index;
+    filter->loaded_index = NULL;
+    return;
+  }
+
+  if (filter->loaded_index) {
+    GST_ELEMENT_WARNING (filter, RESOURCE, READ, (NULL),
+        ("Ignoring index made for other input, rebuilding it"));
+    gst_gz_index_free (filter->loaded_index);
+    filter->loaded_index = NULL;
+  }
+  gst_gz_index_set_source (filter->index, in_size, filter->head_crc);
 }
 
-gint
-decode_message (const guchar * srcmsg, const gint srclen, guchar ** outmsg, gulong * outlen)
+/* collect the first GST_GZ_INDEX_HEAD_SIZE compressed bytes. Until the
+ * index is checked seeks only use checkpoints of this run, which restart
+ * the input at its start the first time, so the head comes in order. */
+static void
+gst_gzdec_check_index_head (Gstgzdec * filter, GstBuffer * buf)
 {
-  gint ret;
-  guchar inbuffer[CHUNK];
-  guchar outbuffer[CHUNK];
-  gulong processed;
-  struct ll_buffer *outdata, *head;
-  guchar *srcidx = (guchar *)srcmsg;
-  gint remainder = srclen;
+  GstMapInfo map;
+  gsize n;
 
-  outdata = g_malloc0 (sizeof(struct ll_buffer));
-  head = outdata;
+  if (!filter->index || filter->index_checked)
+    return;
+  if (GST_BUFFER_OFFSET_IS_VALID (buf) &&
+      GST_BUFFER_OFFSET (buf) != filter->head_len)
+    return;
+  if (!gst_buffer_map (buf, &map, GST_MAP_READ))
+    return;
 
-  do {
-    memset (inbuffer, 0, CHUNK);
-    if (remainder >= CHUNK) {
-        remainder -= CHUNK;
-        stream.avail_in = CHUNK;
-        memcpy (inbuffer, srcidx, CHUNK);
-        srcidx += CHUNK;
-    }
-    else {
-        stream.avail_in = remainder;
-        memcpy (inbuffer, srcidx, remainder);
-        remainder = 0;
-    }
-
-    if (stream.avail_in == 0)
-      break;
-    stream.next_in = inbuffer;
-
-    do {
-      outdata->data = g_malloc0 (CHUNK);
-
-      stream.avail_out = CHUNK;
-      stream.next_out = outbuffer;
-      ret = inflate (&stream, Z_NO_FLUSH);
-      switch (ret) {
-      case Z_NEED_DICT:
-        ret = Z_DATA_ERROR;
-      case Z_DATA_ERROR:
-      case Z_MEM_ERROR:
-      case Z_STREAM_ERROR:
-        (void)inflateEnd(&stream);
-        return ret;
-      }
-      processed = CHUNK - stream.avail_out;
-      memcpy (outdata->data + outdata->len, outbuffer, processed);
-      outdata->len += processed;
-      *outlen += processed;
-
-      if (stream.avail_out == 0) {
-        outdata->next = g_malloc0 (sizeof(struct ll_buffer));
-        outdata = outdata->next;
-      }
+  n = MIN (map.size, GST_GZ_INDEX_HEAD_SIZE - filter->head_len);
+  filter->head_crc = crc32 (filter->head_crc, map.data, n);
+  filter->head_len += n;
+  gst_buffer_unmap (buf, &map);
+
+  if (filter->head_len == GST_GZ_INDEX_HEAD_SIZE)
+    gst_gzdec_verify_index (filter);
+}
+
+static void
+gst_gzdec_close_index (Gstgzdec * filter)
+{
+  if (!filter->index)
+    return;
+
+  gst_gzdec_save_index (filter);
+  gst_gz_index_free (filter->index);
+  filter->index = NULL;
+  if (filter->loaded_index) {
+    gst_gz_index_free (filter->loaded_index);
+    filter->loaded_index = NULL;
+  }
+  if (filter->head_index) {
+    gst_gz_index_free (filter->head_index);
+    filter->head_index = NULL;
+  }
+  g_free (filter->window);
+  filter->window = NULL;
+  filter->resume = NULL;
+  filter->seek_point = NULL;
+}
+
+/* pick the dictionary for the coming streams, the property or else the
+ * shared copy of the file */
+static gboolean
+gst_gzdec_open_dictionary (Gstgzdec * filter)
+{
+  gchar *location;
+  GError *err = NULL;
 
-    } while (stream.avail_out == 0);
+  GST_OBJECT_LOCK (filter);
+  filter->cur_dictionary = filter->dictionary ?
+      g_bytes_ref (filter->dictionary) : NULL;
+  location = g_strdup (filter->dictionary_location);
+  GST_OBJECT_UNLOCK (filter);
 
-    if (ret != Z_STREAM_END) {
-      outdata->next = g_malloc0 (sizeof(struct ll_buffer));
-      outdata = outdata->next;
+  if (!filter->cur_dictionary && location) {
+    filter->cur_dictionary = gst_gz_dictionary_load (location, &err);
+    if (!filter->cur_dictionary) {
+      GST_ELEMENT_ERROR (filter, RESOURCE, OPEN_READ, (NULL),
+          ("Failed to load dictionary: %s", err->message));
+      g_clear_error (&err);
+      g_free (location);
+      return FALSE;
     }
-  } while (ret != Z_STREAM_END);
+  }
+  g_free (location);
+
+  return TRUE;
+}
 
-  outdata = head;
-  *outmsg = g_malloc0 (*outlen);
+static void
+gst_gzdec_close_dictionary (Gstgzdec * filter)
+{
+  if (filter->cur_dictionary) {
+    g_bytes_unref (filter->cur_dictionary);
+    filter->cur_dictionary = NULL;
+  }
+}
 
-  gulong outmsgidx = 0;
+/* resolve cpu-set and numa-node for the threads started from now on */
+static gboolean
+gst_gzdec_open_affinity (Gstgzdec * filter)
+{
+  gchar *cpu_set;
+  gint numa_node;
+  GError *err = NULL;
 
-  while (outdata) {
-    memcpy (*outmsg + outmsgidx, outdata->data, outdata->len);
+  GST_OBJECT_LOCK (filter);
+  cpu_set = g_strdup (filter->cpu_set);
+  numa_node = filter->numa_node;
+  GST_OBJECT_UNLOCK (filter);
 
-    outmsgidx += outdata->len;
-    g_free (outdata->data);
+  if (!cpu_set && numa_node < 0)
+    return TRUE;
 
-    struct ll_buffer *temp = outdata;
-    outdata = outdata->next;
-    g_free (temp);
+  filter->affinity = gst_gz_affinity_new (cpu_set, numa_node, &err);
+  g_free (cpu_set);
+  if (!filter->affinity) {
+    GST_ELEMENT_ERROR (filter, RESOURCE, SETTINGS, (NULL),
+        ("Failed to set up thread affinity: %s", err->message));
+    g_clear_error (&err);
+    return FALSE;
   }
 
-  return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+  return TRUE;
 }
-static GstBuffer *
-gst_gzdec_process_data (GstBuffer * buf)
+
+static void
+gst_gzdec_close_affinity (Gstgzdec * filter)
 {
-  GstBuffer *outbuf = NULL;
-  GstMapInfo info;
-  GstMemory *mem = NULL;
-  guchar *srcmsg, *decodedmsg = NULL;
-  gulong decodedmsglen = 0;
+  if (filter->affinity) {
+    gst_gz_affinity_free (filter->affinity);
+    filter->affinity = NULL;
+  }
+}
 
-  gst_buffer_map (buf, &info, GST_MAP_READ);
-  srcmsg = (guchar *)info.data;
+/* start the push thread when max-queued-buffers or -bytes ask for one */
+static void
+gst_gzdec_open_queue (Gstgzdec * filter)
+{
+  guint max_buffers;
+  guint64 max_bytes;
 
-  g_print ("Source message: %s\n", srcmsg);
-  decode_message (srcmsg, gst_buffer_get_size(buf), &decodedmsg, &decodedmsglen);
+  GST_OBJECT_LOCK (filter);
+  max_buffers = filter->max_queued_buffers;
+  max_bytes = filter->max_queued_bytes;
+  GST_OBJECT_UNLOCK (filter);
 
-  g_print ("Decoded message: %s(%lu)\n", decodedmsg, decodedmsglen);
-  outbuf = gst_buffer_new ();
-  mem = gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
-                  decodedmsg, decodedmsglen, 0, decodedmsglen, NULL, NULL);
-  gst_buffer_append_memory (outbuf, mem);
+  if (max_buffers == 0 && max_bytes == 0)
+    return;
+  if (max_buffers == 0)
+    max_buffers = GZDEC_QUEUE_BUFFERS;
 
-  memset (info.data, 0xff, info.size);
-  gst_buffer_unmap (buf, &info);
+  filter->queue = gst_gz_queue_new (filter->srcpad, max_buffers, max_bytes);
+  if (!filter->queue)
+    GST_WARNING_OBJECT (filter, "failed to start the push thread, pushing "
+        "from the decoding thread");
+}
 
-  return outbuf;
+static void
+gst_gzdec_close_queue (Gstgzdec * filter)
+{
+  if (filter->queue) {
+    gst_gz_queue_free (filter->queue);
+    filter->queue = NULL;
+  }
 }
-/* chain function
- * this function does the actual processing
+
+/* serialized events must not overtake the buffers still queued */
+static void
+gst_gzdec_wait_queue (Gstgzdec * filter)
+{
+  if (filter->queue)
+    gst_gz_queue_drain (filter->queue);
+}
+
+static gboolean
+gst_gzdec_push_event (Gstgzdec * filter, GstEvent * event)
+{
+  if (GST_EVENT_IS_SERIALIZED (event))
+    gst_gzdec_wait_queue (filter);
+
+  return gst_pad_push_event (filter->srcpad, event);
+}
+
+/* Output caps
+ *
+ * The caps of the decoded data go out with the first decoded buffer,
+ * picked by typefinding that buffer with the extension of the file name
+ * in the gzip header as a hint. The segment is held back until then, so
+ * it still follows the caps.
  */
-static GstFlowReturn
-gst_gzdec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+
+/* collect the start of the stream until the FNAME of the gzip header, if
+ * it has one, is known */
+static void
+gst_gzdec_sniff_name (Gstgzdec * filter, GstBuffer * buf)
 {
-  Gstgzdec *filter;
-  GstBuffer *outbuf;
+  GstMapInfo map;
+  gint res;
 
-  filter = GST_GZDEC (parent);
+  if (filter->name_done)
+    return;
+  if (!gst_buffer_map (buf, &map, GST_MAP_READ)) {
+    filter->name_done = TRUE;
+    return;
+  }
 
-  if (filter->silent == FALSE)
-    g_print ("Have data of size %" G_GSIZE_FORMAT" bytes!\n",
-                    gst_buffer_get_size(buf));
-  outbuf = gst_gzdec_process_data (buf);
-  gst_buffer_unref (buf);
-  if (!outbuf) {
-    GST_ELEMENT_ERROR (GST_ELEMENT (filter), STREAM, FAILED, (NULL), (NULL));
-    return GST_FLOW_ERROR;
+  /* in the common case the whole header is in the first buffer */
+  if (filter->name_head) {
+    g_byte_array_append (filter->name_head, map.data,
+        MIN (map.size, GZDEC_NAME_PEEK_SIZE - filter->name_head->len));
+    res = gst_gz_format_parse_file_name (filter->name_head->data,
+        filter->name_head->len, &filter->file_name);
+  } else {
+    res = gst_gz_format_parse_file_name (map.data, map.size,
+        &filter->file_name);
+    if (res < 0) {
+      filter->name_head = g_byte_array_new ();
+      g_byte_array_append (filter->name_head, map.data,
+          MIN (map.size, GZDEC_NAME_PEEK_SIZE));
+    }
+  }
+  gst_buffer_unmap (buf, &map);
+
+  if (res >= 0 || filter->name_head->len >= GZDEC_NAME_PEEK_SIZE) {
+    if (filter->file_name)
+      GST_DEBUG_OBJECT (filter, "gzip header names \"%s\"",
+          filter->file_name);
+    if (filter->name_head) {
+      g_byte_array_unref (filter->name_head);
+      filter->name_head = NULL;
+    }
+    filter->name_done = TRUE;
   }
-  /* push out the output buffer to source pad after processing it */
-  return gst_pad_push (filter->srcpad, outbuf);
 }
 
+/* send the caps for the decoded data, from buf when there is data */
+static void
+gst_gzdec_negotiate (Gstgzdec * filter, GstBuffer * buf)
+{
+  GstTypeFindProbability prob = GST_TYPE_FIND_NONE;
+  const gchar *ext = NULL;
+  GstCaps *caps = NULL;
+  GstMapInfo map;
 
-/* entry point to initialize the plug-in
- * initialize the plug-in itself
- * register the element factories and other features
- */
+  /* downstream pulling from us does its own typefinding */
+  if (filter->caps_sent || filter->src_pulling)
+    return;
+  filter->caps_sent = TRUE;
+
+  if (filter->file_name) {
+    ext = strrchr (filter->file_name, '.');
+    if (ext && ext[1] != '\0')
+      ext++;
+    else
+      ext = NULL;
+  }
+
+  if (buf && gst_buffer_map (buf, &map, GST_MAP_READ)) {
+    caps = gst_type_find_helper_for_data_with_extension (GST_OBJECT (filter),
+        map.data, map.size, ext, &prob);
+    gst_buffer_unmap (buf, &map);
+  }
+  if (!caps && ext)
+    caps = gst_type_find_helper_for_extension (GST_OBJECT (filter), ext);
+  if (!caps)
+    caps = gst_caps_new_empty_simple ("application/octet-stream");
+
+  GST_DEBUG_OBJECT (filter, "decoded data is %" GST_PTR_FORMAT
+      " (probability %d)", caps, prob);
+  gst_gzdec_push_event (filter, gst_event_new_caps (caps));
+  gst_caps_unref (caps);
+
+  if (filter->pending_segment) {
+    gst_gzdec_push_event (filter, filter->pending_segment);
+    filter->pending_segment = NULL;
+  }
+}
+
+/* takes event */
 static gboolean
-gzdec_init (GstPlugin * gzdec)
+gst_gzdec_send_segment (Gstgzdec * filter, GstEvent * event)
 {
-  /* debug category for filtering log messages */
-  GST_DEBUG_CATEGORY_INIT (gst_gzdec_debug, "gzdec",
-      0, "gzip decoder plugin");
+  if (filter->caps_sent || filter->src_pulling)
+    return gst_gzdec_push_event (filter, event);
+
+  gst_event_replace (&filter->pending_segment, event);
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+static void
+gst_gzdec_clear_caps (Gstgzdec * filter)
+{
+  filter->caps_sent = FALSE;
+  gst_event_replace (&filter->pending_segment, NULL);
+  g_free (filter->file_name);
+  filter->file_name = NULL;
+  if (filter->name_head) {
+    g_byte_array_unref (filter->name_head);
+    filter->name_head = NULL;
+  }
+  filter->name_done = FALSE;
+}
+
+/* set up everything a stream needs. Normally in READY->PAUSED, but
+ * downstream activates our src pad in pull mode before we change state
+ * ourselves and may call getrange right away, so that does it first. */
+static gboolean
+gst_gzdec_open (Gstgzdec * filter)
+{
+  if (filter->opened)
+    return TRUE;
+
+  if (!gst_gzdec_open_affinity (filter))
+    return FALSE;
+  if (!gst_gzdec_open_dictionary (filter)) {
+    gst_gzdec_close_affinity (filter);
+    return FALSE;
+  }
+  gst_gzdec_open_index (filter);
+  if (init_decoder (filter) != Z_OK) {
+    GST_ELEMENT_ERROR (filter, LIBRARY, INIT, (NULL),
+        ("Failed to initialize inflate state"));
+    gst_gzdec_close_index (filter);
+    gst_gzdec_close_dictionary (filter);
+    gst_gzdec_close_affinity (filter);
+    return FALSE;
+  }
+  gst_gzdec_open_queue (filter);
+  filter->opened = TRUE;
+
+  return TRUE;
+}
+
+/* the pads are inactive, the push thread is not stuck downstream */
+static void
+gst_gzdec_close (Gstgzdec * filter)
+{
+  if (!filter->opened)
+    return;
+
+  gst_gzdec_close_queue (filter);
+  deinit_decoder (filter);
+  gst_gzdec_clear_caps (filter);
+  gst_gzdec_close_index (filter);
+  gst_gzdec_close_dictionary (filter);
+  gst_gzdec_close_affinity (filter);
+  filter->opened = FALSE;
+}
+
+/* the inflate state only lives while the element is PAUSED or PLAYING */
+static GstStateChangeReturn
+gst_gzdec_change_state (GstElement * element, GstStateChange transition)
+{
+  Gstgzdec *filter = GST_GZDEC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_gzdec_open (filter))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_gzdec_close (filter);
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      /* pulled from in READY and never went on to PAUSED */
+      gst_gzdec_close (filter);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+/* set up the decoder for the seek that caused the current flush */
+static void
+gst_gzdec_apply_seek (Gstgzdec * filter)
+{
+  const GstGzCheckpoint *point;
+  guint64 target;
+
+  GST_OBJECT_LOCK (filter);
+  if (!filter->seek_pending) {
+    GST_OBJECT_UNLOCK (filter);
+    return;
+  }
+  point = filter->seek_point;
+  target = filter->seek_target;
+  filter->in_pos = filter->seek_in;
+  filter->seek_pending = FALSE;
+  filter->seek_point = NULL;
+  GST_OBJECT_UNLOCK (filter);
+
+  if (point) {
+    /* raw inflate restarts at the checkpoint, see gst_gzdec_resume() */
+    filter->resume = point;
+    filter->in_offset = point->in;
+    filter->out_base = point->out;
+    filter->offset = point->out;
+    filter->mode = GST_GZDEC_MODE_SERIAL;
+    filter->format = GST_GZ_FORMAT_DEFLATE;
+    /* in gzip the member goes on to its trailer and maybe more members,
+     * this one can't be verified any more */
+    if (filter->stream_format == GST_GZ_FORMAT_GZIP) {
+      filter->format = GST_GZ_FORMAT_GZIP;
+      filter->framing = GST_GZDEC_FRAMING_BODY;
+    }
+  }
+  filter->skip = target - filter->offset;
+  filter->segment_start = target;
+
+  GST_DEBUG_OBJECT (filter, "seeking to %" G_GUINT64_FORMAT ", decoding from %"
+      G_GUINT64_FORMAT, target, filter->offset);
+}
+
+/* pick the checkpoint a seek to target restarts from and remember the
+ * seek for gst_gzdec_apply_seek(). Returns the compressed offset to read
+ * from. */
+static guint64
+gst_gzdec_prepare_seek (Gstgzdec * filter, guint64 target)
+{
+  const GstGzCheckpoint *point = NULL;
+  guint64 in = 0;
+
+  if (filter->index)
+    point = gst_gz_index_lookup (filter->index, target);
+  /* the byte before a checkpoint holds the first bits of its block */
+  if (point)
+    in = point->in - (point->bits ? 1 : 0);
+
+  GST_OBJECT_LOCK (filter);
+  filter->seek_pending = TRUE;
+  filter->seek_point = point;
+  filter->seek_target = target;
+  filter->seek_in = in;
+  GST_OBJECT_UNLOCK (filter);
+
+  return in;
+}
+
+/* in pull mode we seek ourselves: stop the task, flush downstream and
+ * restart reading at the checkpoint */
+static gboolean
+gst_gzdec_pull_seek (Gstgzdec * filter, GstEvent * event, guint64 target)
+{
+  guint32 seqnum = gst_event_get_seqnum (event);
+  GstEvent *ev;
+
+  ev = gst_event_new_flush_start ();
+  gst_event_set_seqnum (ev, seqnum);
+  if (filter->pool)
+    gst_buffer_pool_set_flushing (filter->pool, TRUE);
+  if (filter->queue)
+    gst_gz_queue_set_flushing (filter->queue, TRUE);
+  gst_pad_push_event (filter->srcpad, ev);
+
+  gst_pad_pause_task (filter->sinkpad);
+  GST_PAD_STREAM_LOCK (filter->sinkpad);
+
+  ev = gst_event_new_flush_stop (TRUE);
+  gst_event_set_seqnum (ev, seqnum);
+  gst_pad_push_event (filter->srcpad, ev);
+  if (filter->pool)
+    gst_buffer_pool_set_flushing (filter->pool, FALSE);
+  if (filter->queue)
+    gst_gz_queue_set_flushing (filter->queue, FALSE);
+
+  reset_decoder (filter);
+  gst_gzdec_prepare_seek (filter, target);
+  gst_gzdec_apply_seek (filter);
+  filter->need_segment = TRUE;
+
+  gst_gzdec_start_loop (filter);
+  GST_PAD_STREAM_UNLOCK (filter->sinkpad);
+
+  return TRUE;
+}
+
+static gboolean
+gst_gzdec_do_seek (Gstgzdec * filter, GstEvent * event)
+{
+  GstSeekFlags flags;
+  GstSeekType start_type, stop_type;
+  GstFormat format;
+  gdouble rate;
+  gint64 start, stop;
+  guint64 in;
+  GstEvent *upstream;
+  gboolean ret;
+
+  gst_event_parse_seek (event, &rate, &format, &flags, &start_type, &start,
+      &stop_type, &stop);
+
+  if (format != GST_FORMAT_BYTES || rate != 1.0 ||
+      start_type != GST_SEEK_TYPE_SET || !(flags & GST_SEEK_FLAG_FLUSH)) {
+    GST_DEBUG_OBJECT (filter, "only flushing BYTES seeks to a start "
+        "position are supported");
+    return FALSE;
+  }
+  start = MAX (start, 0);
+
+  /* downstream pulling from us picks its offsets itself */
+  if (filter->src_pulling)
+    return FALSE;
+  if (filter->pulling)
+    return gst_gzdec_pull_seek (filter, event, start);
+
+  in = gst_gzdec_prepare_seek (filter, start);
+
+  upstream = gst_event_new_seek (1.0, GST_FORMAT_BYTES, flags,
+      GST_SEEK_TYPE_SET, in, GST_SEEK_TYPE_NONE, -1);
+  gst_event_set_seqnum (upstream, gst_event_get_seqnum (event));
+  ret = gst_pad_push_event (filter->sinkpad, upstream);
+
+  if (!ret) {
+    GST_DEBUG_OBJECT (filter, "upstream refused to seek to %" G_GUINT64_FORMAT,
+        in);
+    GST_OBJECT_LOCK (filter);
+    filter->seek_pending = FALSE;
+    filter->seek_point = NULL;
+    GST_OBJECT_UNLOCK (filter);
+  }
+
+  return ret;
+}
+
+/* this function handles src events */
+static gboolean
+gst_gzdec_src_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  Gstgzdec *filter = GST_GZDEC (parent);
+  gboolean ret;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_SEEK:
+      ret = gst_gzdec_do_seek (filter, event);
+      gst_event_unref (event);
+      break;
+    default:
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+  }
+
+  return ret;
+}
+
+/* this function handles src queries, positions are in decoded bytes */
+/* remember how much input arrived over how much stream time, for turning
+ * held bytes into latency */
+static void
+gst_gzdec_track_rate (Gstgzdec * filter, GstBuffer * buf)
+{
+  GstClockTime pts = GST_BUFFER_PTS (buf);
+  guint64 held = 0;
+
+  /* the workers and the queue are only looked at from the streaming
+   * thread, the latency query gets the total from here */
+  if (filter->workers && (filter->mode == GST_GZDEC_MODE_BGZF ||
+          filter->mode == GST_GZDEC_MODE_MEMBERS))
+    held += (2 * gst_gz_workers_get_n_threads (filter->workers) + 1) *
+        (guint64) filter->output_size;
+
+  GST_OBJECT_LOCK (filter);
+  if (filter->queue) {
+    guint64 queued = (guint64) (filter->max_queued_buffers ?
+        filter->max_queued_buffers : GZDEC_QUEUE_BUFFERS) *
+        filter->output_size;
+
+    held += filter->max_queued_bytes > 0 ?
+        MIN (queued, filter->max_queued_bytes) : queued;
+  }
+  /* back to compressed bytes at the ratio so far */
+  filter->rate_held = filter->offset > 0 ?
+      gst_util_uint64_scale (held, filter->bytes_in, filter->offset) : 0;
+
+  if (GST_CLOCK_TIME_IS_VALID (pts)) {
+    if (!GST_CLOCK_TIME_IS_VALID (filter->rate_start)) {
+      filter->rate_start = pts;
+      filter->rate_total = 0;
+    }
+    if (pts > filter->rate_start) {
+      filter->rate_time = pts - filter->rate_start;
+      filter->rate_bytes = filter->rate_total;
+    }
+  }
+  filter->rate_total += gst_buffer_get_size (buf);
+  GST_OBJECT_UNLOCK (filter);
+}
+
+static void
+gst_gzdec_reset_rate (Gstgzdec * filter)
+{
+  GST_OBJECT_LOCK (filter);
+  filter->rate_start = GST_CLOCK_TIME_NONE;
+  filter->rate_time = 0;
+  filter->rate_bytes = 0;
+  filter->rate_total = 0;
+  filter->rate_held = 0;
+  GST_OBJECT_UNLOCK (filter);
+}
+
+/* the most decoded data we hold on to, as stream time of the input it was
+ * decoded from: a full output buffer for every job the workers may have
+ * in flight plus the one being collected, and a full push queue. 0 when
+ * the input carries no timestamps to go by. */
+static GstClockTime
+gst_gzdec_held_latency (Gstgzdec * filter)
+{
+  GstClockTime held = 0;
+
+  GST_OBJECT_LOCK (filter);
+  if (filter->rate_time > 0 && filter->rate_bytes > 0)
+    held = gst_util_uint64_scale (filter->rate_held, filter->rate_time,
+        filter->rate_bytes);
+  GST_OBJECT_UNLOCK (filter);
+
+  return held;
+}
+
+static gboolean
+gst_gzdec_src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  Gstgzdec *filter = GST_GZDEC (parent);
+  GstFormat format;
+  gboolean ret;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_POSITION:
+      gst_query_parse_position (query, &format, NULL);
+      if (format != GST_FORMAT_BYTES)
+        return gst_pad_query_default (pad, parent, query);
+      gst_query_set_position (query, format, filter->offset);
+      ret = TRUE;
+      break;
+    case GST_QUERY_DURATION:
+    {
+      guint64 length;
+
+      gst_query_parse_duration (query, &format, NULL);
+      if (format != GST_FORMAT_BYTES)
+        return gst_pad_query_default (pad, parent, query);
+      /* only known once the stream was decoded completely */
+      ret = filter->index && gst_gz_index_get_length (filter->index, &length);
+      if (ret)
+        gst_query_set_duration (query, format, length);
+      break;
+    }
+    case GST_QUERY_LATENCY:
+    {
+      GstClockTime min, max, held;
+      gboolean live, unbounded;
+
+      ret = gst_pad_peer_query (filter->sinkpad, query);
+      if (!ret)
+        break;
+
+      /* per-buffer and sync output leaves together with the input that
+       * completes it, apart from what the workers and the push queue hold
+       * on to at most. In none mode a partial buffer waits for more input
+       * however long that takes, there is no bound to report. */
+      gst_query_parse_latency (query, &live, &min, &max);
+      held = gst_gzdec_held_latency (filter);
+      GST_OBJECT_LOCK (filter);
+      unbounded = filter->flush_mode == GST_GZDEC_FLUSH_NONE;
+      GST_OBJECT_UNLOCK (filter);
+      if (GST_CLOCK_TIME_IS_VALID (min))
+        min += held;
+      if (unbounded)
+        max = GST_CLOCK_TIME_NONE;
+      else if (GST_CLOCK_TIME_IS_VALID (max))
+        max += held;
+      GST_DEBUG_OBJECT (filter, "latency: live %d, min %" GST_TIME_FORMAT
+          " (%" GST_TIME_FORMAT " ours), max %" GST_TIME_FORMAT, live,
+          GST_TIME_ARGS (min), GST_TIME_ARGS (held), GST_TIME_ARGS (max));
+      gst_query_set_latency (query, live, min, max);
+      break;
+    }
+    case GST_QUERY_SCHEDULING:
+    {
+      GstQuery *peer;
+      gboolean pull = FALSE;
+
+      /* decoded data can be pulled whenever the compressed data can */
+      peer = gst_query_new_scheduling ();
+      if (gst_pad_peer_query (filter->sinkpad, peer))
+        pull = gst_query_has_scheduling_mode_with_flags (peer,
+            GST_PAD_MODE_PULL, GST_SCHEDULING_FLAG_SEEKABLE);
+      gst_query_unref (peer);
+
+      gst_query_set_scheduling (query,
+          pull ? GST_SCHEDULING_FLAG_SEEKABLE : 0, 1, -1, 0);
+      if (pull)
+        gst_query_add_scheduling_mode (query, GST_PAD_MODE_PULL);
+      gst_query_add_scheduling_mode (query, GST_PAD_MODE_PUSH);
+      ret = TRUE;
+      break;
+    }
+    case GST_QUERY_SEEKING:
+    {
+      GstQuery *peer;
+      gboolean seekable = FALSE;
+
+      gst_query_parse_seeking (query, &format, NULL, NULL, NULL);
+      if (format != GST_FORMAT_BYTES)
+        return gst_pad_query_default (pad, parent, query);
+      /* we can seek whenever upstream can */
+      peer = gst_query_new_seeking (GST_FORMAT_BYTES);
+      if (gst_pad_peer_query (filter->sinkpad, peer))
+        gst_query_parse_seeking (peer, NULL, &seekable, NULL, NULL);
+      gst_query_unref (peer);
+      gst_query_set_seeking (query, format, seekable, 0, -1);
+      ret = TRUE;
+      break;
+    }
+    default:
+      ret = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return ret;
+}
+
+/* the input ended, push out what is left. Posts an error and returns
+ * FALSE when the input was truncated. */
+static gboolean
+gst_gzdec_finish (Gstgzdec * filter)
+{
+  gboolean complete;
+  GstFlowReturn flow = gst_gzdec_drain (filter, &complete);
+  guint interval;
+
+  if (filter->outbuf)
+    gst_gzdec_push_output (filter, &filter->outbuf, &filter->outmap);
+
+  /* what the drain pushed counts too */
+  gst_gz_stats_add_output (&filter->stats, filter->cur_out,
+      filter->cur_allocations, filter->cur_push_time);
+  filter->cur_out = 0;
+  filter->cur_allocations = 0;
+  filter->cur_push_time = 0;
+
+  GST_OBJECT_LOCK (filter);
+  interval = filter->stats_interval;
+  GST_OBJECT_UNLOCK (filter);
+  if (interval > 0)
+    gst_gzdec_post_stats (filter);
+
+  /* a failed decode posted its error already */
+  if (flow != GST_FLOW_OK)
+    return FALSE;
+
+  /* the stream may only finish once inflate has seen the gzip trailer */
+  if (!complete) {
+    GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+        ("Unexpected end of gzip stream"));
+    return FALSE;
+  }
+
+  /* input shorter than the head, all of it went through */
+  if (filter->index && filter->head_len > 0 &&
+      filter->head_len == filter->bytes_in)
+    gst_gzdec_verify_index (filter);
+
+  if (filter->index && (filter->stream_end || filter->member_end)) {
+    gst_gz_index_set_length (filter->index, filter->offset);
+    gst_gzdec_save_index (filter);
+  }
+
+  return TRUE;
+}
+
+/* this function handles sink events */
+static gboolean
+gst_gzdec_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  Gstgzdec *filter;
+  gboolean ret;
+
+  filter = GST_GZDEC (parent);
+
+  GST_LOG_OBJECT (filter, "Received %s event: %" GST_PTR_FORMAT,
+      GST_EVENT_TYPE_NAME (event), event);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps * caps;
+
+      /* the caps only tell us what to decode, when the data itself
+       * can't (raw deflate). They describe compressed data, so they stay
+       * here. */
+      gst_event_parse_caps (event, &caps);
+      filter->caps_format = gst_gz_format_from_caps (caps);
+      gst_event_unref (event);
+      ret = TRUE;
+      break;
+    }
+    case GST_EVENT_SEGMENT:
+    {
+      const GstSegment *upstream;
+      GstSegment segment;
+      GstEvent *ev;
+
+      /* a BYTES segment from upstream counts compressed bytes, ours
+       * counts decoded ones and starts where the last seek asked */
+      gst_event_parse_segment (event, &upstream);
+      if (upstream->format != GST_FORMAT_BYTES) {
+        ret = gst_gzdec_send_segment (filter, event);
+        break;
+      }
+
+      gst_segment_init (&segment, GST_FORMAT_BYTES);
+      segment.start = segment.position = segment.time = filter->segment_start;
+      ev = gst_event_new_segment (&segment);
+      gst_event_set_seqnum (ev, gst_event_get_seqnum (event));
+      gst_event_unref (event);
+      ret = gst_gzdec_send_segment (filter, ev);
+      break;
+    }
+    case GST_EVENT_EOS:
+      if (!gst_gzdec_finish (filter)) {
+        gst_event_unref (event);
+        ret = FALSE;
+      } else {
+        /* nothing was decoded, the name is all there is to go by */
+        gst_gzdec_negotiate (filter, NULL);
+        gst_gzdec_wait_queue (filter);
+        ret = gst_pad_event_default (pad, parent, event);
+      }
+      reset_decoder (filter);
+      break;
+    case GST_EVENT_FLUSH_START:
+      /* unblock a decode loop waiting for a free output buffer */
+      if (filter->pool)
+        gst_buffer_pool_set_flushing (filter->pool, TRUE);
+      if (filter->queue)
+        gst_gz_queue_set_flushing (filter->queue, TRUE);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      if (filter->pool)
+        gst_buffer_pool_set_flushing (filter->pool, FALSE);
+      reset_decoder (filter);
+      gst_gzdec_apply_seek (filter);
+      ret = gst_pad_event_default (pad, parent, event);
+      if (filter->queue)
+        gst_gz_queue_set_flushing (filter->queue, FALSE);
+      break;
+    default:
+      /* sticky events after the segment can't wait for the first data */
+      if (GST_EVENT_IS_STICKY (event) && filter->pending_segment)
+        gst_gzdec_negotiate (filter, NULL);
+      if (GST_EVENT_IS_SERIALIZED (event))
+        gst_gzdec_wait_queue (filter);
+      ret = gst_pad_event_default (pad, parent, event);
+      break;
+  }
+
+  return ret;
+}
+static void gst_gzdec_decode_job (GstGzJob * job, gpointer user_data);
+static void gst_gzdec_discard_jobs (Gstgzdec * filter);
+
+/* called on the verification thread */
+static void
+gst_gzdec_verify_error (const gchar * message, gpointer user_data)
+{
+  Gstgzdec *filter = user_data;
+
+  GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL), ("%s", message));
+}
+
+gint
+init_decoder (Gstgzdec * filter)
+{
+  GstGzdecVerify verify;
+  gint ret;
+  guint threads;
+
+  if (filter->decoder_ready)
+    deinit_decoder (filter);
+
+  /* a reused state from the pool when there is one */
+  filter->stream = gst_gz_inflate_acquire (16 + MAX_WBITS,
+      gst_gz_affinity_get_numa_node (filter->affinity));
+  ret = filter->stream ? Z_OK : Z_MEM_ERROR;
+  filter->decoder_ready = (ret == Z_OK);
+  filter->stream_end = FALSE;
+  filter->member_end = FALSE;
+  filter->next_magic_len = 0;
+  filter->offset = 0;
+  filter->in_offset = 0;
+  filter->out_base = 0;
+  filter->skip = 0;
+  filter->resume = NULL;
+  filter->segment_start = 0;
+  filter->output_size = 0;
+  filter->bytes_in = 0;
+  gst_gzdec_reset_rate (filter);
+  filter->limit_in = 0;
+  filter->limit_out = 0;
+  filter->format = GST_GZ_FORMAT_UNKNOWN;
+  filter->magic_len = 0;
+  filter->framing = GST_GZDEC_FRAMING_NONE;
+  filter->checking = FALSE;
+  filter->verify_pos = 0;
+  filter->stream_format = GST_GZ_FORMAT_UNKNOWN;
+  gst_gz_stats_reset (&filter->stats);
+  filter->stats_last = gst_util_get_timestamp ();
+  if (ret != Z_OK)
+    return ret;
+
+  GST_OBJECT_LOCK (filter);
+  threads = filter->threads;
+  verify = filter->verify;
+  filter->cur_messages = filter->messages;
+  filter->cur_member_lookahead = filter->member_lookahead;
+  GST_OBJECT_UNLOCK (filter);
+  filter->message_bits = 0;
+  if (threads == 0)
+    threads = g_get_num_processors ();
+
+  if (verify == GST_GZDEC_VERIFY_DEFERRED) {
+    filter->verifier = gst_gz_verify_new (gst_gzdec_verify_error, filter);
+    if (!filter->verifier)
+      GST_WARNING_OBJECT (filter, "no verification thread, checking inline");
+  }
+
+  /* the input has to be looked at before we know whether it is BGZF.
+   * Checkpoints come from the serial inflate state, so indexing decodes
+   * serially. */
+  filter->mode = GST_GZDEC_MODE_SERIAL;
+  if (filter->cur_messages) {
+    GST_INFO_OBJECT (filter, "decoding independent messages");
+  } else if (threads > 1 && filter->index) {
+    GST_INFO_OBJECT (filter, "index-interval is set, decoding serially");
+  } else if (threads > 1) {
+    filter->workers = gst_gz_workers_new (threads, gst_gzdec_decode_job, filter);
+    if (filter->workers) {
+      if (filter->affinity)
+        gst_gz_workers_set_affinity (filter->workers, filter->affinity);
+      filter->adapter = gst_adapter_new ();
+      filter->mode = GST_GZDEC_MODE_PROBE;
+    } else {
+      GST_WARNING_OBJECT (filter, "failed to start %u worker threads, "
+          "decoding serially", threads);
+    }
+  }
+
+  return ret;
+}
+
+static void
+gst_gzdec_free_stream_decoder (Gstgzdec * filter)
+{
+  if (filter->decoder) {
+    gst_gz_stream_decoder_free (filter->decoder);
+    filter->decoder = NULL;
+  }
+}
+
+/* throw away a partial output buffer held back by flush-mode */
+static void
+gst_gzdec_drop_output (Gstgzdec * filter)
+{
+  if (!filter->outbuf)
+    return;
+
+  gst_buffer_unmap (filter->outbuf, &filter->outmap);
+  gst_buffer_unref (filter->outbuf);
+  filter->outbuf = NULL;
+}
+
+void
+reset_decoder (Gstgzdec * filter)
+{
+  if (!filter->decoder_ready)
+    return;
+
+  /* a resumed seek left the state in raw inflate mode */
+  inflateReset2 (filter->stream, 16 + MAX_WBITS);
+  filter->stream_end = FALSE;
+  filter->member_end = FALSE;
+  filter->next_magic_len = 0;
+  filter->offset = 0;
+  filter->in_offset = 0;
+  filter->out_base = 0;
+  filter->skip = 0;
+  filter->resume = NULL;
+  filter->segment_start = 0;
+  filter->in_pos = 0;
+  filter->in_eos = FALSE;
+  gst_adapter_clear (filter->out_adapter);
+  filter->bytes_in = 0;
+  gst_gzdec_reset_rate (filter);
+  /* the input starts over, so does its head */
+  if (!filter->index_checked) {
+    filter->head_crc = crc32 (0L, Z_NULL, 0);
+    filter->head_len = 0;
+  }
+  filter->limit_in = 0;
+  filter->limit_out = 0;
+  gst_gzdec_drop_output (filter);
+  /* the next stream is sniffed again */
+  filter->format = GST_GZ_FORMAT_UNKNOWN;
+  filter->magic_len = 0;
+  gst_gzdec_free_stream_decoder (filter);
+  filter->framing = GST_GZDEC_FRAMING_NONE;
+  filter->checking = FALSE;
+  filter->verify_pos = 0;
+  if (filter->verifier)
+    gst_gz_verify_reset (filter->verifier);
+
+  if (filter->workers) {
+    gst_gzdec_discard_jobs (filter);
+    gst_adapter_clear (filter->adapter);
+    filter->mode = GST_GZDEC_MODE_PROBE;
+  }
+}
+
+void
+deinit_decoder (Gstgzdec * filter)
+{
+  gst_gzdec_drop_output (filter);
+  gst_gzdec_free_stream_decoder (filter);
+  filter->framing = GST_GZDEC_FRAMING_NONE;
+  if (filter->verifier) {
+    gst_gz_verify_free (filter->verifier);
+    filter->verifier = NULL;
+  }
+
+  gst_gzdec_reset_rate (filter);
+  if (filter->workers) {
+    gst_gzdec_discard_jobs (filter);
+    gst_gz_workers_free (filter->workers);
+    filter->workers = NULL;
+  }
+  if (filter->adapter) {
+    g_object_unref (filter->adapter);
+    filter->adapter = NULL;
+  }
+  filter->mode = GST_GZDEC_MODE_SERIAL;
+
+  if (filter->pool) {
+    gst_buffer_pool_set_active (filter->pool, FALSE);
+    gst_object_unref (filter->pool);
+    filter->pool = NULL;
+  }
+
+  if (!filter->decoder_ready)
+    return;
+
+  /* back to the pool for the next stream */
+  gst_gz_inflate_release (filter->stream);
+  filter->stream = NULL;
+  filter->decoder_ready = FALSE;
+}
+
+/* ask downstream for a buffer pool to decode into. If it does not offer one
+ * or does not accept our buffer size we fall back to a pool of our own. */
+static gboolean
+gst_gzdec_decide_allocation (Gstgzdec * filter)
+{
+  GstCaps *caps;
+  GstQuery *query;
+  GstBufferPool *pool = NULL;
+  GstAllocator *allocator = NULL;
+  GstAllocationParams params;
+  GstStructure *config;
+  guint size = filter->output_size, min = 0, max = 0;
+  guint64 max_memory;
+
+  if (filter->pool) {
+    gst_buffer_pool_set_active (filter->pool, FALSE);
+    gst_object_unref (filter->pool);
+    filter->pool = NULL;
+  }
+
+  caps = gst_pad_get_current_caps (filter->srcpad);
+  query = gst_query_new_allocation (caps, TRUE);
+  gst_allocation_params_init (&params);
+
+  if (gst_pad_peer_query (filter->srcpad, query)) {
+    if (gst_query_get_n_allocation_params (query) > 0)
+      gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
+    if (gst_query_get_n_allocation_pools (query) > 0) {
+      gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+      /* don't let downstream shrink our decode unit */
+      size = MAX (size, filter->output_size);
+    }
+  } else {
+    GST_DEBUG_OBJECT (filter, "downstream did not answer the allocation query");
+  }
+  gst_query_unref (query);
+
+  /* cap the memory downstream can hold on to. Once max buffers are out,
+   * acquiring blocks until downstream returns one to the pool. */
+  GST_OBJECT_LOCK (filter);
+  max_memory = filter->max_output_memory;
+  GST_OBJECT_UNLOCK (filter);
+  if (max_memory > 0) {
+    guint limit = (guint) MIN (MAX (max_memory / size, 1), G_MAXUINT);
+
+    if (max == 0 || max > limit)
+      max = limit;
+    min = MIN (min, max);
+  }
+
+  if (pool) {
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, size, min, max);
+    gst_buffer_pool_config_set_allocator (config, allocator, &params);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_DEBUG_OBJECT (filter, "downstream pool rejected our config");
+      gst_object_unref (pool);
+      pool = NULL;
+    }
+  }
+
+  if (!pool) {
+    pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, size, min, max);
+    gst_buffer_pool_config_set_allocator (config, allocator, &params);
+    if (!gst_buffer_pool_set_config (pool, config))
+      goto config_failed;
+  }
+
+  if (!gst_buffer_pool_set_active (pool, TRUE))
+    goto activate_failed;
+
+  GST_DEBUG_OBJECT (filter, "decoding into %u byte buffers (max %u) from %"
+      GST_PTR_FORMAT, size, max, pool);
+
+  filter->pool = pool;
+
+  if (allocator)
+    gst_object_unref (allocator);
+  if (caps)
+    gst_caps_unref (caps);
+
+  return TRUE;
+
+config_failed:
+activate_failed:
+  {
+    GST_ELEMENT_ERROR (filter, RESOURCE, SETTINGS, (NULL),
+        ("Failed to set up the output buffer pool"));
+    gst_object_unref (pool);
+    if (allocator)
+      gst_object_unref (allocator);
+    if (caps)
+      gst_caps_unref (caps);
+    return FALSE;
+  }
+}
+
+/* (re)negotiate the output pool when downstream asked for it */
+static gboolean
+gst_gzdec_ensure_pool (Gstgzdec * filter)
+{
+  if (gst_pad_check_reconfigure (filter->srcpad) || !filter->pool)
+    return gst_gzdec_decide_allocation (filter);
+
+  return TRUE;
+}
+
+/* get an output buffer from the pool and point inflate at it */
+static GstFlowReturn
+gst_gzdec_acquire_output (Gstgzdec * filter, GstBuffer ** outbuf,
+    GstMapInfo * map)
+{
+  GstFlowReturn flow;
+  guint64 max_bytes, left;
+  gsize size;
+
+  if (!filter->src_pulling && !gst_gzdec_ensure_pool (filter))
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  /* never allocate past max-output-bytes: one byte over the budget is
+   * enough to tell that the stream is larger */
+  GST_OBJECT_LOCK (filter);
+  max_bytes = filter->max_output_bytes;
+  GST_OBJECT_UNLOCK (filter);
+  size = filter->output_size;
+  if (max_bytes > 0) {
+    left = max_bytes - MIN (filter->limit_out, max_bytes);
+    if (left < size)
+      size = (gsize) left + 1;
+  }
+
+  /* pulled output stays in out_adapter until it is asked for, it can't
+   * wait for buffers to come back to a bounded pool. The pool only has
+   * full sized buffers. */
+  if (filter->src_pulling || size < filter->output_size) {
+    *outbuf = gst_buffer_new_allocate (NULL, size, NULL);
+  } else {
+    flow = gst_buffer_pool_acquire_buffer (filter->pool, outbuf, NULL);
+    if (flow != GST_FLOW_OK)
+      return flow;
+  }
+  filter->cur_allocations++;
+
+  if (!gst_buffer_map (*outbuf, map, GST_MAP_WRITE)) {
+    gst_buffer_unref (*outbuf);
+    *outbuf = NULL;
+    GST_ELEMENT_ERROR (filter, RESOURCE, WRITE, (NULL),
+        ("Failed to map output buffer"));
+    return GST_FLOW_ERROR;
+  }
+
+  filter->stream->next_out = map->data;
+  filter->stream->avail_out = (uInt) MIN (map->size, G_MAXUINT);
+
+  return GST_FLOW_OK;
+}
+
+/* whether out more decoded bytes would break max-output-bytes or
+ * max-ratio. Posts the error if so. */
+static gboolean
+gst_gzdec_exceeds_limits (Gstgzdec * filter, guint64 out)
+{
+  guint64 max_bytes, total = filter->limit_out + out;
+  gdouble max_ratio;
+
+  GST_OBJECT_LOCK (filter);
+  max_bytes = filter->max_output_bytes;
+  max_ratio = filter->max_ratio;
+  GST_OBJECT_UNLOCK (filter);
+
+  if (max_bytes > 0 && total > max_bytes) {
+    GST_ELEMENT_ERROR (filter, STREAM, DECODE,
+        ("Decompressed data is larger than allowed"),
+        ("more than %" G_GUINT64_FORMAT " bytes (max-output-bytes) from %"
+            G_GUINT64_FORMAT " compressed bytes", max_bytes,
+            filter->limit_in));
+    return TRUE;
+  }
+  if (max_ratio > 0 && total > GZDEC_RATIO_MIN_OUTPUT &&
+      total > max_ratio * MAX (filter->limit_in, 1)) {
+    GST_ELEMENT_ERROR (filter, STREAM, DECODE,
+        ("Decompressed data is larger than allowed"),
+        ("%" G_GUINT64_FORMAT " bytes from %" G_GUINT64_FORMAT
+            " compressed bytes, more than %g times (max-ratio)", total,
+            filter->limit_in, max_ratio));
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* trim buf to the produced bytes, stamp its offsets and push it. Empty
+ * buffers simply go back to the pool. */
+static GstFlowReturn
+gst_gzdec_push_buffer (Gstgzdec * filter, GstBuffer * buf, gsize produced)
+{
+  GstClockTime start;
+  GstFlowReturn flow;
+  gsize skip;
+
+  /* acquire_output() sized buf to the max-output-bytes budget, max-ratio
+   * can still be passed by up to one buffer */
+  if (gst_gzdec_exceeds_limits (filter, produced)) {
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+  filter->limit_out += produced;
+
+  /* the checking thread reads the same memory, no copy is made. Member
+   * boundaries were queued by offset. */
+  if (filter->verifier && filter->mode == GST_GZDEC_MODE_SERIAL &&
+      filter->format == GST_GZ_FORMAT_GZIP && produced > 0) {
+    gst_gz_verify_add (filter->verifier,
+        gst_buffer_copy_region (buf, GST_BUFFER_COPY_MEMORY, 0, produced));
+    filter->verify_pos += produced;
+  }
+
+  /* after a seek, drop what was decoded ahead of the target */
+  skip = (gsize) MIN (filter->skip, produced);
+  filter->skip -= skip;
+  filter->offset += skip;
+  produced -= skip;
+
+  if (produced == 0) {
+    gst_buffer_unref (buf);
+    return GST_FLOW_OK;
+  }
+
+  gst_buffer_resize (buf, skip, produced);
+  GST_BUFFER_OFFSET (buf) = filter->offset;
+  filter->offset += produced;
+  GST_BUFFER_OFFSET_END (buf) = filter->offset;
+
+  if (filter->silent == FALSE)
+    GST_LOG_OBJECT (filter, "Pushing %" G_GSIZE_FORMAT " decoded bytes at "
+        "offset %" G_GUINT64_FORMAT, produced, GST_BUFFER_OFFSET (buf));
+
+  filter->cur_out += produced;
+  if (filter->src_pulling) {
+    gst_adapter_push (filter->out_adapter, buf);
+    return GST_FLOW_OK;
+  }
+
+  if (!filter->caps_sent)
+    gst_gzdec_negotiate (filter, buf);
+
+  start = gst_util_get_timestamp ();
+  if (filter->queue)
+    flow = gst_gz_queue_push (filter->queue, GST_MINI_OBJECT_CAST (buf));
+  else
+    flow = gst_pad_push (filter->srcpad, buf);
+  filter->cur_push_time += gst_util_get_timestamp () - start;
+
+  return flow;
+}
+
+/* push the output buffer inflate was writing into */
+static GstFlowReturn
+gst_gzdec_push_output (Gstgzdec * filter, GstBuffer ** outbuf,
+    GstMapInfo * map)
+{
+  GstBuffer *buf = *outbuf;
+  gsize produced = filter->stream->next_out - map->data;
+
+  gst_buffer_unmap (buf, map);
+  *outbuf = NULL;
+
+  return gst_gzdec_push_buffer (filter, buf, produced);
+}
+
+/* restart raw inflate at the checkpoint a seek picked. The input now
+ * starts at the checkpoint, or one byte before it when the block begins
+ * in the middle of a byte. */
+static gint
+gst_gzdec_resume (Gstgzdec * filter, const guchar ** data, gsize * size)
+{
+  const GstGzCheckpoint *point = filter->resume;
+  z_stream *stream = filter->stream;
+  gint ret;
+
+  if (point->bits && *size == 0)
+    return Z_OK;
+  filter->resume = NULL;
+
+  ret = inflateReset2 (stream, -MAX_WBITS);
+  if (ret == Z_OK && point->bits) {
+    ret = inflatePrime (stream, point->bits, (*data)[0] >> (8 - point->bits));
+    (*data)++;
+    (*size)--;
+  }
+  if (ret == Z_OK)
+    ret = inflateSetDictionary (stream, point->window, point->window_size);
+
+  return ret;
+}
+
+/* restart raw inflate at a checkpoint before the first input of a seek.
+ * Returns FALSE after posting an error. */
+static gboolean
+gst_gzdec_start_resume (Gstgzdec * filter, const guchar ** data,
+    gsize * size)
+{
+  gint ret = gst_gzdec_resume (filter, data, size);
+
+  if (ret != Z_OK) {
+    GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+        ("Failed to resume at checkpoint (%d)", ret));
+    reset_decoder (filter);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* remember where raw inflate could be restarted, called on block
+ * boundaries */
+static void
+gst_gzdec_add_checkpoint (Gstgzdec * filter)
+{
+  z_stream *stream = filter->stream;
+  guint64 out = filter->out_base + stream->total_out;
+  uInt window_size = GST_GZ_INDEX_WINDOW_SIZE;
+
+  if (!gst_gz_index_wants (filter->index, out))
+    return;
+
+  if (inflateGetDictionary (stream, filter->window, &window_size) != Z_OK)
+    return;
+
+  gst_gz_index_add (filter->index, filter->in_offset + stream->total_in, out,
+      stream->data_type & 7, filter->window, window_size);
+  GST_LOG_OBJECT (filter, "checkpoint at %" G_GUINT64_FORMAT " -> %"
+      G_GUINT64_FORMAT, filter->in_offset + stream->total_in, out);
+}
+
+/* hand inflate the preset dictionary. Returns Z_NEED_DICT when there is
+ * none and Z_DATA_ERROR when it is not the one the stream was made with. */
+static gint
+gst_gzdec_set_dictionary (Gstgzdec * filter)
+{
+  const guint8 *dict;
+  gsize size;
+
+  if (!filter->cur_dictionary)
+    return Z_NEED_DICT;
+
+  /* all of it: zlib checks the adler32 of the whole dictionary against
+   * the stream header and keeps only the last 32 KiB itself */
+  dict = g_bytes_get_data (filter->cur_dictionary, &size);
+  if (size > G_MAXUINT)
+    return Z_DATA_ERROR;
+
+  return inflateSetDictionary (filter->stream, dict, (uInt) size);
+}
+
+GstFlowReturn
+decode_message (Gstgzdec * filter, const guchar * srcmsg, const gsize srclen)
+{
+  z_stream *stream = filter->stream;
+  GstFlowReturn flow = GST_FLOW_OK;
+  const guchar *srcidx = srcmsg;
+  gsize remainder = srclen;
+  gboolean full = FALSE;
+  gboolean flush_point;
+  GstGzdecFlushMode flush_mode;
+  /* with an index, stop at every block boundary to look for checkpoints */
+  gint flush = filter->index ? Z_BLOCK : Z_NO_FLUSH;
+  gint ret = Z_OK;
+
+  GST_OBJECT_LOCK (filter);
+  flush_mode = filter->flush_mode;
+  GST_OBJECT_UNLOCK (filter);
+
+  stream->avail_in = 0;
+
+  if (filter->resume && !gst_gzdec_start_resume (filter, &srcidx, &remainder))
+    return GST_FLOW_ERROR;
+
+  /* the inflate state is kept across calls, so the gzip stream may be split
+   * over any number of input buffers. inflate reads the caller's memory in
+   * place and writes straight into pooled output buffers, every buffer is
+   * pushed as soon as it is full. When the input runs out flush-mode decides
+   * whether the partial one is pushed or kept for the next input. */
+  do {
+    if (stream->avail_in == 0 && remainder > 0) {
+      /* only sliced because avail_in is a uInt */
+      stream->avail_in = (uInt) MIN (remainder, G_MAXUINT);
+      stream->next_in = (z_const Bytef *) srcidx;
+      srcidx += stream->avail_in;
+      remainder -= stream->avail_in;
+    }
+
+    if (!filter->outbuf) {
+      flow = gst_gzdec_acquire_output (filter, &filter->outbuf,
+          &filter->outmap);
+      if (flow != GST_FLOW_OK)
+        break;
+    }
+
+    ret = inflate (stream, flush);
+    /* zlib streams name the dictionary they need by its adler32 */
+    if (ret == Z_NEED_DICT)
+      ret = gst_gzdec_set_dictionary (filter);
+    switch (ret) {
+    case Z_NEED_DICT:
+      GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+          ("stream needs a preset dictionary, set dictionary or "
+              "dictionary-location"));
+      reset_decoder (filter);
+      return GST_FLOW_ERROR;
+    case Z_DATA_ERROR:
+    case Z_MEM_ERROR:
+    case Z_STREAM_ERROR:
+      goto inflate_error;
+    }
+
+    if (filter->index && (stream->data_type & 128) &&
+        !(stream->data_type & 64))
+      gst_gzdec_add_checkpoint (filter);
+
+    full = stream->avail_out == 0;
+    flush_point = FALSE;
+    if (stream->avail_in == 0 && remainder == 0) {
+      /* a sync flush ends the sender's block, so inflate stops on a
+       * block boundary exactly where that input ends */
+      flush_point = flush_mode == GST_GZDEC_FLUSH_PER_BUFFER ||
+          (flush_mode == GST_GZDEC_FLUSH_SYNC && (stream->data_type & 128));
+    }
+    /* the end of a gzip member need not be the end of the stream, its
+     * buffer is filled on with the next one */
+    if (full || flush_point ||
+        (ret == Z_STREAM_END && filter->format != GST_GZ_FORMAT_GZIP))
+      flow = gst_gzdec_push_output (filter, &filter->outbuf, &filter->outmap);
+  } while (flow == GST_FLOW_OK && ret != Z_STREAM_END &&
+      (full || stream->avail_in > 0 || remainder > 0));
+
+  if (ret == Z_STREAM_END)
+    filter->stream_end = TRUE;
+
+  return flow;
+
+inflate_error:
+  {
+    GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+        ("inflate failed: %s (%d)", stream->msg ? stream->msg : "", ret));
+    /* leave the state ready for the next stream */
+    reset_decoder (filter);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* decode with a GstGzStreamDecoder, the formats zlib doesn't handle. The
+ * output side and flush-mode work as in decode_message(), inflate's
+ * next_out/avail_out serve as the output cursor. */
+static GstFlowReturn
+gst_gzdec_decode_stream (Gstgzdec * filter, const guint8 * data, gsize size)
+{
+  z_stream *stream = filter->stream;
+  GstFlowReturn flow = GST_FLOW_OK;
+  GstGzDecodeResult res = GST_GZ_DECODE_OK;
+  gboolean full, flush_point;
+  GstGzdecFlushMode flush_mode;
+  const gchar *error = NULL;
+
+  GST_OBJECT_LOCK (filter);
+  flush_mode = filter->flush_mode;
+  GST_OBJECT_UNLOCK (filter);
+
+  do {
+    guint8 *out;
+    gsize out_size, in_size;
+
+    if (!filter->outbuf) {
+      flow = gst_gzdec_acquire_output (filter, &filter->outbuf,
+          &filter->outmap);
+      if (flow != GST_FLOW_OK)
+        break;
+    }
+
+    out = stream->next_out;
+    out_size = stream->avail_out;
+    in_size = size;
+    res = gst_gz_stream_decoder_decode (filter->decoder, &data, &size, &out,
+        &out_size, &error);
+    stream->next_out = out;
+    stream->avail_out = (uInt) out_size;
+
+    if (res == GST_GZ_DECODE_ERROR)
+      goto decode_error;
+
+    /* like gzip members, frames and bzip2 streams may follow each other
+     * (cat, pzstd, pbzip2). Complete only between two of them. */
+    if (res == GST_GZ_DECODE_END)
+      filter->member_end = TRUE;
+    else if (size != in_size)
+      filter->member_end = FALSE;
+
+    full = stream->avail_out == 0;
+    /* there are no sync points to look for outside of deflate */
+    flush_point = size == 0 && flush_mode != GST_GZDEC_FLUSH_NONE;
+    if (full || res == GST_GZ_DECODE_END || flush_point)
+      flow = gst_gzdec_push_output (filter, &filter->outbuf, &filter->outmap);
+  } while (flow == GST_FLOW_OK && (full || size > 0));
+
+  return flow;
+
+decode_error:
+  {
+    GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+        ("%s decoding failed: %s", gst_gz_format_get_name (filter->format),
+            error));
+    reset_decoder (filter);
+    return GST_FLOW_ERROR;
+  }
+}
+
+/* whether gzip members skip inflate's own CRC32 */
+static gboolean
+gst_gzdec_parses_framing (Gstgzdec * filter)
+{
+  GstGzdecVerify verify;
+
+  GST_OBJECT_LOCK (filter);
+  verify = filter->verify;
+  GST_OBJECT_UNLOCK (filter);
+
+  return verify == GST_GZDEC_VERIFY_NONE ||
+      (verify == GST_GZDEC_VERIFY_DEFERRED && filter->verifier);
+}
+
+/* set up decoding format. Caps saying raw deflate win, since raw deflate
+ * can look like anything, otherwise the magic bytes decide and the caps
+ * are the fallback. */
+static gboolean
+gst_gzdec_select_format (Gstgzdec * filter, GstGzFormat sniffed)
+{
+  GstGzFormat format = sniffed;
+
+  if (filter->caps_format == GST_GZ_FORMAT_DEFLATE ||
+      format == GST_GZ_FORMAT_UNKNOWN)
+    format = filter->caps_format;
+  if (format == GST_GZ_FORMAT_UNKNOWN)
+    format = GST_GZ_FORMAT_DEFLATE;
+
+  GST_DEBUG_OBJECT (filter, "decoding %s", gst_gz_format_get_name (format));
+
+  if (gst_gz_format_is_deflate (format)) {
+    gint window_bits = gst_gz_format_get_window_bits (format);
+
+    if (format == GST_GZ_FORMAT_GZIP && gst_gzdec_parses_framing (filter)) {
+      window_bits = -MAX_WBITS;
+      gst_gz_header_init (&filter->header);
+      filter->framing = GST_GZDEC_FRAMING_HEADER;
+    }
+    if (inflateReset2 (filter->stream, window_bits) != Z_OK ||
+        (format == GST_GZ_FORMAT_DEFLATE && filter->cur_dictionary &&
+            gst_gzdec_set_dictionary (filter) != Z_OK)) {
+      GST_ELEMENT_ERROR (filter, LIBRARY, INIT, (NULL),
+          ("Failed to set up inflate for %s", gst_gz_format_get_name (format)));
+      return FALSE;
+    }
+  } else {
+    filter->decoder = gst_gz_stream_decoder_new (format);
+    if (!filter->decoder) {
+      GST_ELEMENT_ERROR (filter, STREAM, CODEC_NOT_FOUND, (NULL),
+          ("%s input, but %s support was not built",
+              gst_gz_format_get_name (format), gst_gz_format_get_name (format)));
+      return FALSE;
+    }
+  }
+  filter->format = format;
+  filter->stream_format = format;
+
+  return TRUE;
+}
+
+/* decoded bytes so far in the numbering gst_gz_verify_add() uses */
+static guint64
+gst_gzdec_verify_offset (Gstgzdec * filter)
+{
+  guint64 offset = filter->verify_pos;
+
+  if (filter->outbuf)
+    offset += filter->stream->next_out - filter->outmap.data;
+
+  return offset;
+}
+
+/* a gzip member with the header and trailer parsed here around raw
+ * inflate. Returns with stream_end set once the trailer is complete,
+ * *data then points after it. */
+static GstFlowReturn
+gst_gzdec_decode_framed (Gstgzdec * filter, const guint8 ** data,
+    gsize * size)
+{
+  GstFlowReturn flow = GST_FLOW_OK;
+
+  while (flow == GST_FLOW_OK && *size > 0 && !filter->stream_end) {
+    switch (filter->framing) {
+      case GST_GZDEC_FRAMING_HEADER:
+      {
+        gsize before = *size;
+        gint res = gst_gz_header_parse (&filter->header, data, size);
+
+        /* checkpoint offsets count from the start of the file */
+        filter->in_offset += before - *size;
+        if (res < 0) {
+          GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+              ("invalid gzip header"));
+          reset_decoder (filter);
+          return GST_FLOW_ERROR;
+        }
+        if (res > 0) {
+          filter->framing = GST_GZDEC_FRAMING_BODY;
+          filter->checking = filter->verifier != NULL;
+          if (filter->checking)
+            gst_gz_verify_start (filter->verifier,
+                gst_gzdec_verify_offset (filter));
+        }
+        break;
+      }
+      case GST_GZDEC_FRAMING_BODY:
+      {
+        uLong before;
+
+        if (filter->resume && !gst_gzdec_start_resume (filter, data, size))
+          return GST_FLOW_ERROR;
+        if (*size == 0)
+          break;
+
+        before = filter->stream->total_in;
+        flow = decode_message (filter, *data, *size);
+        if (flow != GST_FLOW_OK || !filter->stream_end)
+          return flow;
+        /* the trailer follows what inflate used */
+        *data += filter->stream->total_in - before;
+        *size -= filter->stream->total_in - before;
+        filter->stream_end = FALSE;
+        filter->trailer_len = 0;
+        filter->framing = GST_GZDEC_FRAMING_TRAILER;
+        break;
+      }
+      case GST_GZDEC_FRAMING_TRAILER:
+      {
+        gsize n = MIN (*size, GST_GZ_TRAILER_SIZE - filter->trailer_len);
+
+        memcpy (filter->trailer + filter->trailer_len, *data, n);
+        filter->trailer_len += n;
+        filter->in_offset += n;
+        *data += n;
+        *size -= n;
+        if (filter->trailer_len < GST_GZ_TRAILER_SIZE)
+          break;
+
+        if (filter->checking)
+          gst_gz_verify_end (filter->verifier,
+              gst_gzdec_verify_offset (filter), filter->trailer);
+        filter->checking = FALSE;
+        filter->framing = GST_GZDEC_FRAMING_NONE;
+        filter->stream_end = TRUE;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  return flow;
+}
+
+/* start the next member with the inflate state of the last one. The
+ * window size stays the same, so the reset allocates nothing. */
+static gboolean
+gst_gzdec_restart_member (Gstgzdec * filter)
+{
+  z_stream *stream = filter->stream;
+  gboolean framed = gst_gzdec_parses_framing (filter);
+
+  filter->in_offset += stream->total_in;
+  filter->out_base += stream->total_out;
+  filter->member_end = FALSE;
+
+  if (inflateReset2 (stream, framed ? -MAX_WBITS : 16 + MAX_WBITS) != Z_OK) {
+    GST_ELEMENT_ERROR (filter, LIBRARY, INIT, (NULL),
+        ("Failed to reset inflate for the next gzip member"));
+    return FALSE;
+  }
+
+  if (framed) {
+    gst_gz_header_init (&filter->header);
+    filter->framing = GST_GZDEC_FRAMING_HEADER;
+  } else {
+    filter->framing = GST_GZDEC_FRAMING_NONE;
+  }
+
+  return TRUE;
+}
+
+static GstFlowReturn gst_gzdec_decode_gzip (Gstgzdec * filter,
+    const guint8 * data, gsize size);
+
+/* after a member, the next bytes are either another member or trailing
+ * data that trailing-data decides about */
+static GstFlowReturn
+gst_gzdec_next_member (Gstgzdec * filter, const guint8 ** data, gsize * size)
+{
+  static const guint8 gzip_magic[GZDEC_MEMBER_MAGIC_SIZE] =
+      { 0x1f, 0x8b, Z_DEFLATED };
+  guint8 magic[GZDEC_MEMBER_MAGIC_SIZE];
+  GstGzdecTrailing trailing;
+  const guint8 *next;
+  gsize n;
+
+  n = MIN (*size, GZDEC_MEMBER_MAGIC_SIZE - filter->next_magic_len);
+  memcpy (filter->next_magic + filter->next_magic_len, *data, n);
+  filter->next_magic_len += n;
+  *data += n;
+  *size -= n;
+
+  if (memcmp (filter->next_magic, gzip_magic, filter->next_magic_len) == 0) {
+    if (filter->next_magic_len < GZDEC_MEMBER_MAGIC_SIZE)
+      return GST_FLOW_OK;
+
+    memcpy (magic, filter->next_magic, GZDEC_MEMBER_MAGIC_SIZE);
+    filter->next_magic_len = 0;
+    if (!gst_gzdec_restart_member (filter))
+      return GST_FLOW_ERROR;
+    return gst_gzdec_decode_gzip (filter, magic, GZDEC_MEMBER_MAGIC_SIZE);
+  }
+
+  GST_OBJECT_LOCK (filter);
+  trailing = filter->trailing;
+  GST_OBJECT_UNLOCK (filter);
+
+  switch (trailing) {
+    case GST_GZDEC_TRAILING_STOP:
+      GST_WARNING_OBJECT (filter, "ignoring data after the last gzip member");
+      filter->member_end = FALSE;
+      filter->stream_end = TRUE;
+      *size = 0;
+      return GST_FLOW_OK;
+    case GST_GZDEC_TRAILING_ERROR:
+      GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+          ("trailing data after gzip member"));
+      return GST_FLOW_ERROR;
+    default:
+      break;
+  }
+
+  /* skip to the next byte that could start a member */
+  do {
+    filter->next_magic_len--;
+    memmove (filter->next_magic, filter->next_magic + 1,
+        filter->next_magic_len);
+    filter->in_offset++;
+  } while (filter->next_magic_len > 0 && filter->next_magic[0] != 0x1f);
+
+  if (filter->next_magic_len == 0) {
+    next = memchr (*data, 0x1f, *size);
+    n = next ? (gsize) (next - *data) : *size;
+    *data += n;
+    *size -= n;
+    filter->in_offset += n;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* gzip input may hold any number of members back to back, which is what
+ * cat a.gz b.gz makes. Output buffers run on across member boundaries. */
+static GstFlowReturn
+gst_gzdec_decode_gzip (Gstgzdec * filter, const guint8 * data, gsize size)
+{
+  GstFlowReturn flow = GST_FLOW_OK;
+
+  while (flow == GST_FLOW_OK && size > 0 && !filter->stream_end) {
+    if (filter->member_end) {
+      flow = gst_gzdec_next_member (filter, &data, &size);
+      continue;
+    }
+
+    if (filter->framing != GST_GZDEC_FRAMING_NONE) {
+      flow = gst_gzdec_decode_framed (filter, &data, &size);
+    } else {
+      uLong before = filter->stream->total_in;
+
+      flow = decode_message (filter, data, size);
+      if (flow != GST_FLOW_OK || !filter->stream_end)
+        break;
+      data += filter->stream->total_in - before;
+      size -= filter->stream->total_in - before;
+    }
+
+    if (flow == GST_FLOW_OK && filter->stream_end) {
+      filter->stream_end = FALSE;
+      filter->member_end = TRUE;
+      filter->next_magic_len = 0;
+    }
+  }
+
+  return flow;
+}
+
+static GstFlowReturn
+gst_gzdec_decode_format (Gstgzdec * filter, const guint8 * data, gsize size)
+{
+  if (filter->format == GST_GZ_FORMAT_GZIP)
+    return gst_gzdec_decode_gzip (filter, data, size);
+
+  if (gst_gz_format_is_deflate (filter->format))
+    return decode_message (filter, data, size);
+
+  return gst_gzdec_decode_stream (filter, data, size);
+}
+
+/* the first GST_GZ_FORMAT_MAGIC_SIZE bytes of a stream are collected to
+ * pick the format, then fed to the decoder ahead of the rest */
+static GstFlowReturn
+gst_gzdec_decode (Gstgzdec * filter, const guint8 * data, gsize size)
+{
+  GstFlowReturn flow;
+  gsize n;
+
+  if (filter->format != GST_GZ_FORMAT_UNKNOWN)
+    return gst_gzdec_decode_format (filter, data, size);
+
+  n = MIN (size, GST_GZ_FORMAT_MAGIC_SIZE - filter->magic_len);
+  memcpy (filter->magic + filter->magic_len, data, n);
+  filter->magic_len += n;
+  data += n;
+  size -= n;
+  if (filter->magic_len < GST_GZ_FORMAT_MAGIC_SIZE)
+    return GST_FLOW_OK;
+
+  if (!gst_gzdec_select_format (filter,
+          gst_gz_format_sniff (filter->magic, filter->magic_len)))
+    return GST_FLOW_ERROR;
+
+  flow = gst_gzdec_decode_format (filter, filter->magic, filter->magic_len);
+  if (flow != GST_FLOW_OK || size == 0 || filter->stream_end)
+    return flow;
+
+  return gst_gzdec_decode_format (filter, data, size);
+}
+
+static GstFlowReturn
+gst_gzdec_process_data (Gstgzdec * filter, GstBuffer * buf)
+{
+  GstMapInfo info;
+  const guchar *srcmsg;
+  GstFlowReturn flow;
+
+  if (!gst_buffer_map (buf, &info, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (filter, RESOURCE, READ, (NULL),
+        ("Failed to map input buffer"));
+    return GST_FLOW_ERROR;
+  }
+  srcmsg = (const guchar *)info.data;
+
+  /* the input is mapped read-only and may be shared with other elements,
+   * it is never written to */
+  flow = gst_gzdec_decode (filter, srcmsg, info.size);
+
+  gst_buffer_unmap (buf, &info);
+
+  return flow;
+}
+
+/* Parallel BGZF decoding
+ *
+ * BGZF files are a series of small gzip members, each carrying its
+ * compressed size in a "BC" extra subfield and its decoded size in the
+ * ISIZE trailer. That is enough to cut the input into members without
+ * inflating it. Members are collected into jobs until their decoded size
+ * fills one pool buffer, the workers inflate the jobs concurrently and the
+ * streaming thread pushes the results in input order.
+ */
+
+/* every worker thread keeps one member decoder around for all its jobs */
+static void
+gst_gzdec_worker_decoder_free (gpointer data)
+{
+  gst_gz_member_decoder_free (data);
+}
+
+static GPrivate worker_decoder =
+G_PRIVATE_INIT (gst_gzdec_worker_decoder_free);
+
+/* runs on a worker thread */
+static void
+gst_gzdec_decode_job (GstGzJob * job, gpointer user_data)
+{
+  GstGzMemberDecoder *dec = g_private_get (&worker_decoder);
+  GstMapInfo out, in;
+  gsize written = 0;
+  guint i, n;
+  gint ret = Z_OK;
+
+  if (!dec) {
+    Gstgzdec *filter = user_data;
+
+    /* the worker threads are bound already, the state joins them */
+    dec = gst_gz_member_decoder_new (gst_gz_affinity_get_numa_node
+        (filter->affinity));
+    if (!dec) {
+      job->result = Z_MEM_ERROR;
+      return;
+    }
+    g_private_set (&worker_decoder, dec);
+  }
+
+  if (!gst_buffer_map (job->output, &out, GST_MAP_WRITE)) {
+    job->result = Z_MEM_ERROR;
+    return;
+  }
+
+  n = gst_buffer_list_length (job->input);
+  for (i = 0; i < n; i++) {
+    GstBuffer *member = gst_buffer_list_get (job->input, i);
+    gsize produced;
+
+    if (!gst_buffer_map (member, &in, GST_MAP_READ)) {
+      ret = Z_MEM_ERROR;
+      break;
+    }
+    /* the member must decode completely and end exactly at its BSIZE */
+    ret = gst_gz_member_decoder_decode (dec, in.data, in.size,
+        out.data + written, out.size - written, &produced);
+    gst_buffer_unmap (member, &in);
+    written += produced;
+    if (ret != Z_STREAM_END)
+      break;
+  }
+
+  job->output_size = written;
+  gst_buffer_unmap (job->output, &out);
+  job->result = ret;
+}
+
+/* returns the total size of the BGZF block at data, or 0 if data does not
+ * start with a gzip member carrying the BC extra subfield */
+static gsize
+gst_gzdec_bgzf_block_size (const guint8 * data, gsize size)
+{
+  gsize pos, end;
+
+  if (size < GZDEC_BGZF_HEADER_SIZE)
+    return 0;
+  /* gzip magic, deflate, FEXTRA */
+  if (data[0] != 0x1f || data[1] != 0x8b || data[2] != 8 || !(data[3] & 0x04))
+    return 0;
+
+  end = MIN (12 + (gsize) GST_READ_UINT16_LE (data + 10), size);
+  for (pos = 12; pos + 4 <= end; pos += 4 + GST_READ_UINT16_LE (data + pos + 2)) {
+    if (data[pos] == 'B' && data[pos + 1] == 'C' &&
+        GST_READ_UINT16_LE (data + pos + 2) == 2 && pos + 6 <= end) {
+      gsize bsize = (gsize) GST_READ_UINT16_LE (data + pos + 4) + 1;
+
+      return bsize >= GZDEC_BGZF_MIN_BLOCK_SIZE ? bsize : 0;
+    }
+  }
+
+  return 0;
+}
+
+/* push the decoded output of finished jobs in input order. While more than
+ * max_pending jobs are outstanding this waits for the oldest one. */
+static GstFlowReturn
+gst_gzdec_finish_jobs (Gstgzdec * filter, guint max_pending)
+{
+  GstFlowReturn flow = GST_FLOW_OK;
+  GstGzJob *job;
+
+  while (flow == GST_FLOW_OK) {
+    gboolean wait = gst_gz_workers_get_pending (filter->workers) > max_pending;
+
+    job = gst_gz_workers_pop (filter->workers, wait);
+    if (!job)
+      break;
+
+    /* a member boundary was guessed wrong, the input of this job and of
+     * all later ones is decoded again serially, see
+     * gst_gzdec_replay_members() */
+    if (filter->mispredicted || (job->result != Z_STREAM_END &&
+            filter->mode == GST_GZDEC_MODE_MEMBERS)) {
+      GST_DEBUG_OBJECT (filter, "speculative member decoding failed (%d)",
+          job->result);
+      filter->mispredicted = TRUE;
+      g_queue_push_tail (&filter->replay, job);
+      continue;
+    }
+
+    if (job->result == Z_STREAM_END) {
+      flow = gst_gzdec_push_buffer (filter, job->output, job->output_size);
+      job->output = NULL;
+    } else {
+      GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+          ("Failed to inflate BGZF block (%d)", job->result));
+      flow = GST_FLOW_ERROR;
+    }
+    gst_gz_job_free (job);
+  }
+
+  return flow;
+}
+
+/* drop everything in flight, used when flushing or shutting down */
+static void
+gst_gzdec_discard_jobs (Gstgzdec * filter)
+{
+  GstGzJob *job;
+
+  if (filter->job) {
+    gst_gz_job_free (filter->job);
+    filter->job = NULL;
+  }
+  filter->job_size = 0;
+  filter->scan_pos = 0;
+
+  while ((job = gst_gz_workers_pop (filter->workers, TRUE)))
+    gst_gz_job_free (job);
+  while ((job = g_queue_pop_head (&filter->replay)))
+    gst_gz_job_free (job);
+  filter->mispredicted = FALSE;
+}
+
+/* start collecting blocks into a new job with a fresh output buffer */
+static GstFlowReturn
+gst_gzdec_new_job (Gstgzdec * filter)
+{
+  GstBufferPoolAcquireParams params = { 0, };
+  GstBuffer *outbuf = NULL;
+  GstFlowReturn flow;
+  guint pending;
+
+  if (!gst_gzdec_ensure_pool (filter))
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  /* with max-output-memory set, the buffers the pool is waiting for may be
+   * sitting in our own finished jobs, so push those out before blocking */
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+  while ((flow = gst_buffer_pool_acquire_buffer (filter->pool, &outbuf,
+              &params)) == GST_FLOW_EOS &&
+      (pending = gst_gz_workers_get_pending (filter->workers)) > 0) {
+    flow = gst_gzdec_finish_jobs (filter, pending - 1);
+    if (flow != GST_FLOW_OK)
+      return flow;
+  }
+  if (flow == GST_FLOW_EOS)
+    flow = gst_buffer_pool_acquire_buffer (filter->pool, &outbuf, NULL);
+  if (flow != GST_FLOW_OK)
+    return flow;
+
+  filter->cur_allocations++;
+  filter->job = gst_gz_job_new ();
+  filter->job->output = outbuf;
+  filter->job_size = 0;
+
+  return GST_FLOW_OK;
+}
+
+/* hand the job being collected to the workers */
+static GstFlowReturn
+gst_gzdec_submit_job (Gstgzdec * filter)
+{
+  GstGzJob *job = filter->job;
+  GstFlowReturn flow;
+  guint max_pending;
+
+  if (!job)
+    return GST_FLOW_OK;
+
+  filter->job = NULL;
+  filter->job_size = 0;
+
+  if (gst_buffer_list_length (job->input) == 0) {
+    gst_gz_job_free (job);
+    return GST_FLOW_OK;
+  }
+
+  /* keep one job queued behind every busy worker, no more */
+  max_pending = 2 * gst_gz_workers_get_n_threads (filter->workers);
+  flow = gst_gzdec_finish_jobs (filter, max_pending - 1);
+  if (flow != GST_FLOW_OK) {
+    gst_gz_job_free (job);
+    return flow;
+  }
+
+  /* its members are decoded again with the rest */
+  if (filter->mispredicted) {
+    filter->job = job;
+    return GST_FLOW_OK;
+  }
+
+  if (!gst_gz_workers_push (filter->workers, job)) {
+    gst_gz_job_free (job);
+    GST_ELEMENT_ERROR (filter, CORE, THREAD, (NULL),
+        ("Failed to queue BGZF job"));
+    return GST_FLOW_ERROR;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* decode everything that was collected but not yet taken for a job */
+static GstFlowReturn
+gst_gzdec_decode_adapter (Gstgzdec * filter)
+{
+  gsize avail = gst_adapter_available (filter->adapter);
+  GstFlowReturn flow;
+  GstBuffer *buf;
+
+  if (avail == 0)
+    return GST_FLOW_OK;
+
+  buf = gst_adapter_take_buffer (filter->adapter, avail);
+  flow = gst_gzdec_process_data (filter, buf);
+  gst_buffer_unref (buf);
+
+  return flow;
+}
+
+/* what follows the last BGZF block is what could follow any gzip member:
+ * another member or trailing data, for trailing-data to decide about */
+static void
+gst_gzdec_end_blocks (Gstgzdec * filter)
+{
+  filter->mode = GST_GZDEC_MODE_SERIAL;
+  filter->format = GST_GZ_FORMAT_GZIP;
+  filter->member_end = TRUE;
+  filter->next_magic_len = 0;
+}
+
+/* cut whole BGZF blocks off the adapter and queue them. When draining,
+ * the last partial job is submitted and every job is waited for. */
+static GstFlowReturn
+gst_gzdec_parallel_decode (Gstgzdec * filter, gboolean drain)
+{
+  GstFlowReturn flow;
+
+  /* push whatever the workers already finished */
+  flow = gst_gzdec_finish_jobs (filter, G_MAXUINT);
+
+  while (flow == GST_FLOW_OK) {
+    gsize avail = gst_adapter_available (filter->adapter);
+    gsize peek = MIN (avail, GZDEC_BGZF_PEEK_SIZE);
+    gsize bsize;
+    guint32 isize;
+
+    if (avail < GZDEC_BGZF_HEADER_SIZE)
+      break;
+
+    bsize = gst_gzdec_bgzf_block_size (gst_adapter_map (filter->adapter, peek),
+        peek);
+    gst_adapter_unmap (filter->adapter);
+
+    if (bsize == 0) {
+      /* not BGZF (anymore), decode the rest serially once everything
+       * before it is out */
+      GST_DEBUG_OBJECT (filter, "no BGZF block header, decoding serially");
+      flow = gst_gzdec_submit_job (filter);
+      if (flow == GST_FLOW_OK)
+        flow = gst_gzdec_finish_jobs (filter, 0);
+      if (flow != GST_FLOW_OK)
+        return flow;
+      gst_gzdec_end_blocks (filter);
+      return gst_gzdec_decode_adapter (filter);
+    }
+
+    if (avail < bsize)
+      break;
+
+    gst_adapter_copy (filter->adapter, &isize, bsize - 4, 4);
+    isize = GUINT32_FROM_LE (isize);
+    if (isize > GZDEC_BGZF_MAX_ISIZE) {
+      GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+          ("Invalid BGZF block, %u decoded bytes", isize));
+      return GST_FLOW_ERROR;
+    }
+
+    if (filter->job &&
+        filter->job_size + isize > gst_buffer_get_size (filter->job->output))
+      flow = gst_gzdec_submit_job (filter);
+    if (flow == GST_FLOW_OK && !filter->job)
+      flow = gst_gzdec_new_job (filter);
+    if (flow != GST_FLOW_OK)
+      break;
+
+    /* a sub-buffer in the common case, the adapter only copies when a
+     * block straddles two input buffers */
+    gst_buffer_list_add (filter->job->input,
+        gst_adapter_take_buffer (filter->adapter, bsize));
+    filter->job_size += isize;
+  }
+
+  if (flow == GST_FLOW_OK && drain) {
+    flow = gst_gzdec_submit_job (filter);
+    if (flow == GST_FLOW_OK)
+      flow = gst_gzdec_finish_jobs (filter, 0);
+  }
+
+  return flow;
+}
+
+/* Speculative member decoding
+ *
+ * Plain multi-member gzip has no BGZF sizes, but every member starts
+ * with 1f 8b 08 and ends with its decoded size. With member-lookahead set
+ * the input is cut where the next plausible member header is found, and
+ * the pieces are decoded as members by the workers like BGZF blocks. A
+ * piece is only right when it decodes completely, checks out and ends
+ * exactly at the next guess. The first one that doesn't was cut at
+ * compressed data that looked like a header, or is damaged, and from its
+ * start on everything is decoded serially.
+ */
+
+/* offset of the next plausible member header after the one at the start
+ * of the adapter, or -1. Where the search got to is kept in scan_pos. */
+static gssize
+gst_gzdec_find_member (Gstgzdec * filter, gsize avail)
+{
+  guint8 header[GZDEC_MEMBER_HEADER_SIZE];
+  gsize pos = MAX (filter->scan_pos, GZDEC_MEMBER_MIN_SIZE);
+
+  while (pos + GZDEC_MEMBER_HEADER_SIZE <= avail) {
+    guint32 isize;
+    gssize found;
+
+    found = gst_adapter_masked_scan_uint32 (filter->adapter, 0xffffff00,
+        0x1f8b0800, pos, avail - pos);
+    if (found < 0 || (gsize) found + GZDEC_MEMBER_HEADER_SIZE > avail) {
+      pos = found < 0 ? avail - 3 : (gsize) found;
+      break;
+    }
+
+    /* reserved flags clear, a known XFL and OS, and a decoded size deflate
+     * can get to from the piece before it */
+    gst_adapter_copy (filter->adapter, header, found, sizeof (header));
+    gst_adapter_copy (filter->adapter, &isize, found - 4, 4);
+    isize = GUINT32_FROM_LE (isize);
+    if ((header[3] & 0xe0) == 0 &&
+        (header[8] == 0 || header[8] == 2 || header[8] == 4) &&
+        (header[9] <= 13 || header[9] == 255) &&
+        isize <= (guint64) found * GZDEC_DEFLATE_MAX_RATIO) {
+      filter->scan_pos = found;
+      return found;
+    }
+    pos = found + 1;
+  }
+
+  filter->scan_pos = MAX (pos, GZDEC_MEMBER_MIN_SIZE);
+  return -1;
+}
+
+/* decode everything from the first wrong guess on serially */
+static GstFlowReturn
+gst_gzdec_replay_members (Gstgzdec * filter)
+{
+  GstFlowReturn flow = GST_FLOW_OK;
+  GstGzJob *job;
+  guint i;
+
+  while ((job = gst_gz_workers_pop (filter->workers, TRUE)))
+    g_queue_push_tail (&filter->replay, job);
+  if (filter->job) {
+    g_queue_push_tail (&filter->replay, filter->job);
+    filter->job = NULL;
+    filter->job_size = 0;
+  }
+  filter->mispredicted = FALSE;
+  filter->mode = GST_GZDEC_MODE_SERIAL;
+
+  while ((job = g_queue_pop_head (&filter->replay))) {
+    for (i = 0; flow == GST_FLOW_OK &&
+        i < gst_buffer_list_length (job->input); i++)
+      flow = gst_gzdec_process_data (filter,
+          gst_buffer_list_get (job->input, i));
+    gst_gz_job_free (job);
+  }
+  if (flow != GST_FLOW_OK)
+    return flow;
+
+  return gst_gzdec_decode_adapter (filter);
+}
+
+/* after the jobs so far, the rest is decoded serially */
+static GstFlowReturn
+gst_gzdec_members_to_serial (Gstgzdec * filter)
+{
+  GstFlowReturn flow;
+
+  flow = gst_gzdec_submit_job (filter);
+  if (flow == GST_FLOW_OK)
+    flow = gst_gzdec_finish_jobs (filter, 0);
+  if (flow != GST_FLOW_OK)
+    return flow;
+  if (filter->mispredicted)
+    return gst_gzdec_replay_members (filter);
+
+  filter->mode = GST_GZDEC_MODE_SERIAL;
+  return gst_gzdec_decode_adapter (filter);
+}
+
+/* cut the adapter at guessed member boundaries and queue the pieces. When
+ * draining, the rest is taken as the last member. */
+static GstFlowReturn
+gst_gzdec_member_decode (Gstgzdec * filter, gboolean drain)
+{
+  GstFlowReturn flow;
+
+  flow = gst_gzdec_finish_jobs (filter, G_MAXUINT);
+
+  while (flow == GST_FLOW_OK && !filter->mispredicted) {
+    gsize avail = gst_adapter_available (filter->adapter);
+    gssize found;
+    guint32 isize;
+
+    if (avail == 0)
+      break;
+
+    found = gst_gzdec_find_member (filter, avail);
+    if (found < 0 && drain) {
+      if (avail < GZDEC_MEMBER_MIN_SIZE)
+        return gst_gzdec_members_to_serial (filter);
+      found = avail;
+    } else if (found < 0) {
+      /* a member this long doesn't gain from being guessed at */
+      if (avail > filter->cur_member_lookahead) {
+        GST_DEBUG_OBJECT (filter, "no member header within %" G_GUINT64_FORMAT
+            " bytes, decoding serially", filter->cur_member_lookahead);
+        return gst_gzdec_members_to_serial (filter);
+      }
+      break;
+    }
+
+    gst_adapter_copy (filter->adapter, &isize, found - 4, 4);
+    isize = GUINT32_FROM_LE (isize);
+
+    if (isize > MAX (filter->output_size, GZDEC_MEMBER_MAX_ISIZE)) {
+      GST_DEBUG_OBJECT (filter, "member claims %u decoded bytes, decoding "
+          "serially", isize);
+      return gst_gzdec_members_to_serial (filter);
+    }
+
+    if (filter->job &&
+        filter->job_size + isize > gst_buffer_get_size (filter->job->output))
+      flow = gst_gzdec_submit_job (filter);
+    if (flow == GST_FLOW_OK && !filter->job && !filter->mispredicted)
+      flow = gst_gzdec_new_job (filter);
+    if (flow != GST_FLOW_OK || filter->mispredicted)
+      break;
+
+    /* bigger than a pool buffer, the member gets a buffer of its own of
+     * at most GZDEC_MEMBER_MAX_ISIZE and the job is full. A member claiming
+     * more than the limits allow is refused before it is allocated. */
+    if (isize > gst_buffer_get_size (filter->job->output)) {
+      if (gst_gzdec_exceeds_limits (filter, filter->job_size + isize))
+        return GST_FLOW_ERROR;
+      gst_buffer_unref (filter->job->output);
+      filter->job->output = gst_buffer_new_allocate (NULL, isize, NULL);
+      if (!filter->job->output) {
+        GST_ELEMENT_ERROR (filter, RESOURCE, NO_SPACE_LEFT, (NULL),
+            ("Failed to allocate %u bytes for a gzip member", isize));
+        return GST_FLOW_ERROR;
+      }
+    }
+
+    gst_buffer_list_add (filter->job->input,
+        gst_adapter_take_buffer (filter->adapter, found));
+    filter->job_size += isize;
+    filter->scan_pos = 0;
+  }
+
+  if (flow == GST_FLOW_OK && drain && !filter->mispredicted) {
+    flow = gst_gzdec_submit_job (filter);
+    if (flow == GST_FLOW_OK)
+      flow = gst_gzdec_finish_jobs (filter, 0);
+  }
+  if (flow == GST_FLOW_OK && filter->mispredicted)
+    flow = gst_gzdec_replay_members (filter);
+
+  return flow;
+}
+
+static GstFlowReturn
+gst_gzdec_parallel_chain (Gstgzdec * filter, GstBuffer * buf)
+{
+  GstFlowReturn flow;
+  gboolean flush;
+
+  gst_adapter_push (filter->adapter, buf);
+
+  if (filter->mode == GST_GZDEC_MODE_PROBE) {
+    gsize avail = gst_adapter_available (filter->adapter);
+    gsize peek = MIN (avail, GZDEC_BGZF_PEEK_SIZE);
+    gsize bsize;
+
+    if (avail < GZDEC_BGZF_HEADER_SIZE)
+      return GST_FLOW_OK;
+
+    bsize = gst_gzdec_bgzf_block_size (gst_adapter_map (filter->adapter, peek),
+        peek);
+    gst_adapter_unmap (filter->adapter);
+
+    if (bsize == 0 && filter->cur_member_lookahead > 0 &&
+        gst_adapter_masked_scan_uint32 (filter->adapter, 0xffffff00,
+            0x1f8b0800, 0, 4) == 0) {
+      GST_DEBUG_OBJECT (filter, "gzip input, guessing member boundaries "
+          "up to %" G_GUINT64_FORMAT " bytes ahead",
+          filter->cur_member_lookahead);
+      filter->mode = GST_GZDEC_MODE_MEMBERS;
+      filter->format = GST_GZ_FORMAT_GZIP;
+      filter->scan_pos = 0;
+    } else if (bsize == 0) {
+      GST_DEBUG_OBJECT (filter, "not BGZF, decoding serially");
+      filter->mode = GST_GZDEC_MODE_SERIAL;
+      return gst_gzdec_decode_adapter (filter);
+    } else {
+      GST_DEBUG_OBJECT (filter, "BGZF input, decoding on %u threads",
+          gst_gz_workers_get_n_threads (filter->workers));
+      filter->mode = GST_GZDEC_MODE_BGZF;
+      filter->format = GST_GZ_FORMAT_GZIP;
+    }
+  }
+
+  if (filter->mode == GST_GZDEC_MODE_MEMBERS)
+    flow = gst_gzdec_member_decode (filter, FALSE);
+  else
+    flow = gst_gzdec_parallel_decode (filter, FALSE);
+
+  /* on live input, blocks don't wait in jobs for more input unless
+   * flush-mode allows it */
+  GST_OBJECT_LOCK (filter);
+  flush = filter->live && filter->flush_mode != GST_GZDEC_FLUSH_NONE;
+  GST_OBJECT_UNLOCK (filter);
+  if (flow == GST_FLOW_OK && flush && filter->mode != GST_GZDEC_MODE_SERIAL) {
+    flow = gst_gzdec_submit_job (filter);
+    if (flow == GST_FLOW_OK)
+      flow = gst_gzdec_finish_jobs (filter, 0);
+    if (flow == GST_FLOW_OK && filter->mispredicted)
+      flow = gst_gzdec_replay_members (filter);
+  }
+
+  return flow;
+}
+
+/* called at EOS, decodes what is left. complete is set to FALSE if the
+ * input ended in the middle of a gzip member. */
+static GstFlowReturn
+gst_gzdec_drain (Gstgzdec * filter, gboolean * complete)
+{
+  GstFlowReturn flow;
+
+  *complete = TRUE;
+
+  if (filter->mode == GST_GZDEC_MODE_PROBE) {
+    /* too short to tell, it can't be more than one member anyway */
+    filter->mode = GST_GZDEC_MODE_SERIAL;
+    flow = gst_gzdec_decode_adapter (filter);
+    if (flow != GST_FLOW_OK)
+      return flow;
+  }
+
+  if (filter->mode == GST_GZDEC_MODE_BGZF) {
+    flow = gst_gzdec_parallel_decode (filter, TRUE);
+    if (flow != GST_FLOW_OK || filter->mode != GST_GZDEC_MODE_BGZF)
+      return flow;
+    if (gst_adapter_available (filter->adapter) == 0)
+      return GST_FLOW_OK;
+
+    /* less than a block header is left after the last block */
+    gst_gzdec_end_blocks (filter);
+    flow = gst_gzdec_decode_adapter (filter);
+    if (flow != GST_FLOW_OK)
+      return flow;
+  }
+
+  /* unless a guess was wrong every member decoded completely */
+  if (filter->mode == GST_GZDEC_MODE_MEMBERS) {
+    flow = gst_gzdec_member_decode (filter, TRUE);
+    if (flow != GST_FLOW_OK || filter->mode == GST_GZDEC_MODE_MEMBERS)
+      return flow;
+  }
+
+  /* a stream shorter than the magic, decode what there is */
+  if (filter->format == GST_GZ_FORMAT_UNKNOWN && filter->magic_len > 0) {
+    if (!gst_gzdec_select_format (filter,
+            gst_gz_format_sniff (filter->magic, filter->magic_len)))
+      return GST_FLOW_ERROR;
+    flow = gst_gzdec_decode_format (filter, filter->magic, filter->magic_len);
+    if (flow != GST_FLOW_OK)
+      return flow;
+  }
+
+  /* a partial magic after a member is trailing data too */
+  if (filter->member_end && filter->next_magic_len > 0) {
+    GstGzdecTrailing trailing;
+
+    GST_OBJECT_LOCK (filter);
+    trailing = filter->trailing;
+    GST_OBJECT_UNLOCK (filter);
+    *complete = trailing != GST_GZDEC_TRAILING_ERROR;
+    return GST_FLOW_OK;
+  }
+
+  *complete = filter->stream_end || filter->member_end ||
+      filter->magic_len == 0;
+  return GST_FLOW_OK;
+}
+
+/* Messages
+ *
+ * With messages=true every input buffer is a stream of its own. A whole
+ * buffer list is decoded in one go: the inflate state is reset for each
+ * message, the output of all of them goes into large slabs back to back
+ * and one buffer per message, sharing the slab memory, is pushed as one
+ * list.
+ */
+
+typedef struct
+{
+  guint slab;
+  gsize offset;
+  gsize size;
+} GstGzdecPiece;
+
+/* decoded size to expect from in_size compressed bytes, so a single small
+ * message pins no more than it needs. When the last slab of size prev
+ * was not enough the next one is at least twice that. */
+static gsize
+gst_gzdec_slab_size (Gstgzdec * filter, gsize in_size, gsize prev)
+{
+  guint64 expected;
+  guint max_size;
+
+  GST_OBJECT_LOCK (filter);
+  max_size = MAX (filter->max_output_size, GZDEC_SLAB_ALIGN);
+  GST_OBJECT_UNLOCK (filter);
+
+  if (filter->bytes_in > 0 && filter->offset > 0)
+    expected = gst_util_uint64_scale (in_size, filter->offset,
+        filter->bytes_in);
+  else
+    expected = (guint64) in_size * GZDEC_INITIAL_RATIO;
+  expected = MAX (expected, (guint64) prev * 2);
+  expected = (expected + GZDEC_SLAB_ALIGN - 1) &
+      ~(guint64) (GZDEC_SLAB_ALIGN - 1);
+
+  return (gsize) CLAMP (expected, GZDEC_SLAB_ALIGN, max_size);
+}
+
+/* set up inflate for the next message, from its magic bytes like
+ * gst_gzdec_select_format() does for a stream */
+static gboolean
+gst_gzdec_start_message (Gstgzdec * filter, const guint8 * data, gsize size)
+{
+  GstGzFormat format = gst_gz_format_sniff (data, size);
+  gint bits;
+
+  if (filter->caps_format == GST_GZ_FORMAT_DEFLATE ||
+      format == GST_GZ_FORMAT_UNKNOWN)
+    format = filter->caps_format;
+  if (format == GST_GZ_FORMAT_UNKNOWN)
+    format = GST_GZ_FORMAT_DEFLATE;
+
+  if (!gst_gz_format_is_deflate (format)) {
+    GST_ELEMENT_ERROR (filter, STREAM, CODEC_NOT_FOUND, (NULL),
+        ("%s messages are not supported, only gzip, zlib and deflate",
+            gst_gz_format_get_name (format)));
+    return FALSE;
+  }
+
+  /* a plain reset unless the wrapper changed */
+  bits = gst_gz_format_get_window_bits (format);
+  if ((bits == filter->message_bits ? inflateReset (filter->stream) :
+          inflateReset2 (filter->stream, bits)) != Z_OK) {
+    GST_ELEMENT_ERROR (filter, LIBRARY, INIT, (NULL),
+        ("Failed to set up inflate for %s", gst_gz_format_get_name (format)));
+    return FALSE;
+  }
+  filter->message_bits = bits;
+  filter->format = format;
+
+  if (format == GST_GZ_FORMAT_DEFLATE && filter->cur_dictionary &&
+      gst_gzdec_set_dictionary (filter) != Z_OK) {
+    GST_ELEMENT_ERROR (filter, LIBRARY, INIT, (NULL),
+        ("Failed to set the dictionary"));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_gzdec_decode_messages (Gstgzdec * filter, GstBufferList * list)
+{
+  GstClockTime start = gst_util_get_timestamp ();
+  z_stream *stream = filter->stream;
+  GstFlowReturn flow = GST_FLOW_OK;
+  GPtrArray *slabs = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) gst_memory_unref);
+  GArray *pieces = g_array_new (FALSE, FALSE, sizeof (GstGzdecPiece));
+  GArray *firsts = g_array_new (FALSE, FALSE, sizeof (guint));
+  GstBufferList *out;
+  GstMapInfo map = GST_MAP_INFO_INIT;
+  gsize in_size = 0, in_left, slab_used = 0;
+  guint i, j, len;
+
+  len = gst_buffer_list_length (list);
+  for (i = 0; i < len; i++)
+    in_size += gst_buffer_get_size (gst_buffer_list_get (list, i));
+  filter->limit_in += in_size;
+  if (!filter->name_done && len > 0) {
+    /* the first message names the data */
+    gst_gzdec_sniff_name (filter, gst_buffer_list_get (list, 0));
+    filter->name_done = TRUE;
+  }
+  in_left = in_size;
+
+  for (i = 0; i < len && flow == GST_FLOW_OK; i++) {
+    GstBuffer *inbuf = gst_buffer_list_get (list, i);
+    GstMapInfo in;
+    gint ret = Z_OK;
+    gsize short_slab = 0;
+
+    g_array_append_val (firsts, pieces->len);
+    if (!gst_buffer_map (inbuf, &in, GST_MAP_READ)) {
+      GST_ELEMENT_ERROR (filter, RESOURCE, READ, (NULL),
+          ("Failed to map input buffer"));
+      flow = GST_FLOW_ERROR;
+      break;
+    }
+    in_left -= in.size;
+
+    /* nothing to decode, it goes out as an empty buffer */
+    if (in.size == 0) {
+      gst_buffer_unmap (inbuf, &in);
+      continue;
+    }
+
+    if (!gst_gzdec_start_message (filter, in.data, in.size)) {
+      gst_buffer_unmap (inbuf, &in);
+      flow = GST_FLOW_ERROR;
+      break;
+    }
+
+    stream->next_in = (z_const Bytef *) in.data;
+    stream->avail_in = (uInt) MIN (in.size, G_MAXUINT);
+
+    while (ret != Z_STREAM_END) {
+      GstGzdecPiece piece;
+      guint8 *out_start;
+
+      if (slab_used == map.size) {
+        GstMemory *mem;
+
+        if (map.memory)
+          gst_memory_unmap (map.memory, &map);
+        mem = gst_allocator_alloc (NULL, gst_gzdec_slab_size (filter,
+                stream->avail_in + in_left, short_slab), NULL);
+        if (!mem || !gst_memory_map (mem, &map, GST_MAP_WRITE)) {
+          if (mem)
+            gst_memory_unref (mem);
+          map.memory = NULL;
+          GST_ELEMENT_ERROR (filter, RESOURCE, WRITE, (NULL),
+              ("Failed to allocate output"));
+          flow = GST_FLOW_ERROR;
+          break;
+        }
+        g_ptr_array_add (slabs, mem);
+        filter->cur_allocations++;
+        slab_used = 0;
+      }
+
+      out_start = map.data + slab_used;
+      stream->next_out = out_start;
+      stream->avail_out = (uInt) MIN (map.size - slab_used, G_MAXUINT);
+      ret = inflate (stream, Z_NO_FLUSH);
+      if (ret == Z_NEED_DICT)
+        ret = gst_gzdec_set_dictionary (filter);
+      /* the message goes on, the expected size was too small */
+      short_slab = ret == Z_OK && stream->avail_out == 0 ? map.size : 0;
+
+      piece.slab = slabs->len - 1;
+      piece.offset = slab_used;
+      piece.size = stream->next_out - out_start;
+      slab_used += piece.size;
+      if (gst_gzdec_exceeds_limits (filter, piece.size)) {
+        flow = GST_FLOW_ERROR;
+        break;
+      }
+      filter->limit_out += piece.size;
+      if (piece.size > 0)
+        g_array_append_val (pieces, piece);
+
+      /* concatenated gzip members within the message */
+      if (ret == Z_STREAM_END && filter->format == GST_GZ_FORMAT_GZIP &&
+          stream->avail_in >= 2 && stream->next_in[0] == 0x1f &&
+          stream->next_in[1] == 0x8b) {
+        ret = inflateReset (stream);
+        continue;
+      }
+      /* all input used and room left, yet no stream end */
+      if ((ret == Z_OK || ret == Z_BUF_ERROR) && stream->avail_in == 0 &&
+          stream->avail_out > 0) {
+        GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+            ("message %u is truncated", i));
+        flow = GST_FLOW_ERROR;
+        break;
+      }
+      if (ret != Z_OK && ret != Z_STREAM_END) {
+        GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+            ("message %u: inflate failed: %s (%d)", i,
+                stream->msg ? stream->msg : "", ret));
+        flow = GST_FLOW_ERROR;
+        break;
+      }
+    }
+    gst_buffer_unmap (inbuf, &in);
+  }
+  if (map.memory)
+    gst_memory_unmap (map.memory, &map);
+
+  if (flow != GST_FLOW_OK)
+    goto done;
+
+  /* every message becomes a buffer of shared slab memory */
+  out = gst_buffer_list_new_sized (len);
+  for (i = 0; i < len; i++) {
+    GstBuffer *inbuf = gst_buffer_list_get (list, i);
+    guint last = i + 1 < len ? g_array_index (firsts, guint, i + 1) :
+        pieces->len;
+    GstBuffer *buf = gst_buffer_new ();
+    gsize size;
+
+    gst_buffer_copy_into (buf, inbuf, GST_BUFFER_COPY_METADATA, 0, -1);
+    for (j = g_array_index (firsts, guint, i); j < last; j++) {
+      GstGzdecPiece *piece = &g_array_index (pieces, GstGzdecPiece, j);
+
+      gst_buffer_append_memory (buf,
+          gst_memory_share (g_ptr_array_index (slabs, piece->slab),
+              piece->offset, piece->size));
+    }
+
+    size = gst_buffer_get_size (buf);
+    GST_BUFFER_OFFSET (buf) = filter->offset;
+    filter->offset += size;
+    GST_BUFFER_OFFSET_END (buf) = filter->offset;
+    filter->cur_out += size;
+    gst_buffer_list_add (out, buf);
+  }
+
+  if (filter->src_pulling) {
+    for (i = 0; i < len; i++)
+      gst_adapter_push (filter->out_adapter,
+          gst_buffer_ref (gst_buffer_list_get (out, i)));
+    gst_buffer_list_unref (out);
+  } else {
+    GstClockTime push_start;
+
+    if (!filter->caps_sent)
+      gst_gzdec_negotiate (filter, len > 0 ? gst_buffer_list_get (out, 0) :
+          NULL);
+    push_start = gst_util_get_timestamp ();
+    if (filter->queue)
+      flow = gst_gz_queue_push (filter->queue, GST_MINI_OBJECT_CAST (out));
+    else
+      flow = gst_pad_push_list (filter->srcpad, out);
+    filter->cur_push_time += gst_util_get_timestamp () - push_start;
+  }
+
+done:
+  filter->bytes_in += in_size;
+  gst_gzdec_account (filter, in_size, start);
+  g_array_free (firsts, TRUE);
+  g_array_free (pieces, TRUE);
+  g_ptr_array_unref (slabs);
+  gst_buffer_list_unref (list);
+
+  return flow;
+}
+
+/* chain function
+ * this function does the actual processing
+ */
+static GstFlowReturn
+gst_gzdec_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  Gstgzdec *filter;
+
+  filter = GST_GZDEC (parent);
+
+  if (filter->silent == FALSE)
+    GST_LOG_OBJECT (filter, "Have data of size %" G_GSIZE_FORMAT " bytes",
+        gst_buffer_get_size (buf));
+
+  if (filter->cur_messages) {
+    GstBufferList *list = gst_buffer_list_new_sized (1);
+
+    gst_gzdec_track_rate (filter, buf);
+    gst_buffer_list_add (list, buf);
+    return gst_gzdec_decode_messages (filter, list);
+  }
+
+  return gst_gzdec_handle_buffer (filter, buf);
+}
+
+static GstFlowReturn
+gst_gzdec_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  Gstgzdec *filter = GST_GZDEC (parent);
+  GstFlowReturn flow = GST_FLOW_OK;
+  guint i, len;
+
+  len = gst_buffer_list_length (list);
+  if (filter->cur_messages) {
+    for (i = 0; i < len; i++)
+      gst_gzdec_track_rate (filter, gst_buffer_list_get (list, i));
+    return gst_gzdec_decode_messages (filter, list);
+  }
+
+  /* a stream split over several buffers */
+  for (i = 0; i < len && flow == GST_FLOW_OK; i++)
+    flow = gst_gzdec_handle_buffer (filter,
+        gst_buffer_ref (gst_buffer_list_get (list, i)));
+  gst_buffer_list_unref (list);
+
+  return flow;
+}
+
+/* Pull mode
+ *
+ * When upstream supports random access the sink pad is driven by our own
+ * task, or by downstream pulling from the src pad. Either way the input is
+ * read in GZDEC_PULL_SIZE ranges and fed through the same path as pushed
+ * buffers.
+ */
+
+/* read the next range of compressed data and decode it. At the end of the
+ * input in_eos is set and the remaining output is pushed. */
+static GstFlowReturn
+gst_gzdec_pull_input (Gstgzdec * filter)
+{
+  GstBuffer *buf = NULL;
+  GstFlowReturn flow;
+  guint size;
+
+  /* after a seek the first read only goes up to the next boundary */
+  size = GZDEC_PULL_SIZE - (guint) (filter->in_pos % GZDEC_PULL_SIZE);
+
+  flow = gst_pad_pull_range (filter->sinkpad, filter->in_pos, size, &buf);
+  if (flow == GST_FLOW_EOS) {
+    filter->in_eos = TRUE;
+    return gst_gzdec_finish (filter) ? GST_FLOW_OK : GST_FLOW_ERROR;
+  }
+  if (flow != GST_FLOW_OK)
+    return flow;
+
+  if (filter->silent == FALSE)
+    GST_LOG_OBJECT (filter, "Pulled %" G_GSIZE_FORMAT " bytes at offset %"
+        G_GUINT64_FORMAT, gst_buffer_get_size (buf), filter->in_pos);
+  filter->in_pos += gst_buffer_get_size (buf);
+
+  return gst_gzdec_handle_buffer (filter, buf);
+}
+
+/* stream-start goes out before the first segment, upstream doesn't send it
+ * in pull mode */
+static void
+gst_gzdec_push_segment (Gstgzdec * filter)
+{
+  GstSegment segment;
+  GstCaps *caps;
+
+  if (filter->need_stream_start) {
+    gchar *stream_id;
+
+    stream_id = gst_pad_create_stream_id (filter->srcpad, GST_ELEMENT (filter),
+        NULL);
+    gst_gzdec_push_event (filter, gst_event_new_stream_start (stream_id));
+    g_free (stream_id);
+
+    /* there is no caps event in pull mode, ask for the format hint */
+    caps = gst_pad_peer_query_caps (filter->sinkpad, NULL);
+    if (caps && gst_caps_is_fixed (caps))
+      filter->caps_format = gst_gz_format_from_caps (caps);
+    if (caps)
+      gst_caps_unref (caps);
+
+    filter->need_stream_start = FALSE;
+  }
+
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  segment.start = segment.position = segment.time = filter->segment_start;
+  gst_gzdec_send_segment (filter, gst_event_new_segment (&segment));
+  filter->need_segment = FALSE;
+}
+
+static void
+gst_gzdec_loop (GstPad * pad)
+{
+  Gstgzdec *filter = GST_GZDEC (GST_PAD_PARENT (pad));
+  GstFlowReturn flow;
+
+  /* the task pool only lends us the thread, gst_gzdec_loop_leave() gives
+   * it back the way it was */
+  if (filter->affinity && !filter->affinity_saved) {
+    if (!gst_gz_affinity_bind (filter->affinity, &filter->affinity_saved))
+      GST_WARNING_OBJECT (filter, "failed to bind the streaming thread");
+  }
+
+  if (filter->need_segment)
+    gst_gzdec_push_segment (filter);
+
+  flow = gst_gzdec_pull_input (filter);
+  if (flow != GST_FLOW_OK)
+    goto pause;
+
+  if (filter->in_eos || filter->stream_end)
+    goto eos;
+
+  return;
+
+eos:
+  {
+    /* anything after the end of the gzip stream is not read */
+    if (!filter->in_eos)
+      gst_gzdec_finish (filter);
+    GST_DEBUG_OBJECT (filter, "end of stream, pausing task");
+    gst_pad_pause_task (pad);
+    gst_gzdec_negotiate (filter, NULL);
+    gst_gzdec_push_event (filter, gst_event_new_eos ());
+    return;
+  }
+pause:
+  {
+    GST_DEBUG_OBJECT (filter, "pausing task, reason %s",
+        gst_flow_get_name (flow));
+    gst_pad_pause_task (pad);
+    if (flow == GST_FLOW_EOS) {
+      /* downstream wants no more, it still expects the EOS */
+      gst_gzdec_negotiate (filter, NULL);
+      gst_gzdec_push_event (filter, gst_event_new_eos ());
+    } else if (flow == GST_FLOW_NOT_LINKED || flow < GST_FLOW_EOS) {
+      /* our own errors were posted where they happened */
+      if (flow != GST_FLOW_ERROR)
+        GST_ELEMENT_FLOW_ERROR (filter, flow);
+      gst_gzdec_negotiate (filter, NULL);
+      gst_gzdec_push_event (filter, gst_event_new_eos ());
+    }
+    return;
+  }
+}
+
+/* runs on the task thread once the task stopped, before the thread goes
+ * back to the task pool. A paused task keeps its thread. */
+static void
+gst_gzdec_loop_leave (GstTask * task, GThread * thread, gpointer user_data)
+{
+  Gstgzdec *filter = user_data;
+
+  if (filter->affinity_saved) {
+    gst_gz_affinity_restore (filter->affinity_saved);
+    filter->affinity_saved = NULL;
+  }
+}
+
+static gboolean
+gst_gzdec_start_loop (Gstgzdec * filter)
+{
+  GstTask *task;
+
+  if (!gst_pad_start_task (filter->sinkpad, (GstTaskFunction) gst_gzdec_loop,
+          filter->sinkpad, NULL))
+    return FALSE;
+
+  /* the loop only stops from the deactivation after this */
+  GST_OBJECT_LOCK (filter->sinkpad);
+  task = GST_PAD_TASK (filter->sinkpad);
+  if (task)
+    gst_task_set_leave_callback (task, gst_gzdec_loop_leave, filter, NULL);
+  GST_OBJECT_UNLOCK (filter->sinkpad);
+
+  return TRUE;
+}
+
+/* serve decoded bytes to downstream pulling from us. Output is collected
+ * in out_adapter, starting at the last offset asked for, so rereading a
+ * range or reading on is cheap. Reading backwards restarts inflate from
+ * the closest checkpoint. */
+static GstFlowReturn
+gst_gzdec_src_getrange (GstPad * pad, GstObject * parent, guint64 offset,
+    guint length, GstBuffer ** buffer)
+{
+  Gstgzdec *filter = GST_GZDEC (parent);
+  const GstGzCheckpoint *point = NULL;
+  GstFlowReturn flow;
+  guint64 out_pos;
+  gsize avail;
+  GstBuffer *buf;
+
+  GST_PAD_STREAM_LOCK (filter->sinkpad);
+
+  /* activation set it up, only gone again while shutting down */
+  if (!filter->decoder_ready) {
+    flow = GST_FLOW_FLUSHING;
+    goto done;
+  }
+
+  avail = gst_adapter_available (filter->out_adapter);
+  out_pos = filter->offset - avail;
+
+  if (offset > filter->offset && filter->index)
+    point = gst_gz_index_lookup (filter->index, offset);
+
+  if (offset < out_pos || (point && point->out > filter->offset)) {
+    GST_DEBUG_OBJECT (filter, "restarting for range at %" G_GUINT64_FORMAT,
+        offset);
+    reset_decoder (filter);
+    gst_gzdec_prepare_seek (filter, offset);
+    gst_gzdec_apply_seek (filter);
+  } else if (offset > filter->offset) {
+    /* decode on and drop up to the offset */
+    gst_adapter_clear (filter->out_adapter);
+    filter->skip = offset - filter->offset;
+  } else {
+    gst_adapter_flush (filter->out_adapter, offset - out_pos);
+  }
+
+  while (gst_adapter_available (filter->out_adapter) < length &&
+      !filter->stream_end && !filter->in_eos) {
+    flow = gst_gzdec_pull_input (filter);
+    if (flow != GST_FLOW_OK)
+      goto done;
+  }
+
+  avail = gst_adapter_available (filter->out_adapter);
+  if (avail == 0) {
+    flow = GST_FLOW_EOS;
+    goto done;
+  }
+
+  buf = gst_adapter_get_buffer (filter->out_adapter, MIN (avail, length));
+  GST_BUFFER_OFFSET (buf) = offset;
+  GST_BUFFER_OFFSET_END (buf) = offset + gst_buffer_get_size (buf);
+  *buffer = buf;
+  flow = GST_FLOW_OK;
+
+done:
+  GST_PAD_STREAM_UNLOCK (filter->sinkpad);
+
+  return flow;
+}
+
+/* pull from upstream when it can seek, push otherwise */
+static gboolean
+gst_gzdec_sink_activate (GstPad * pad, GstObject * parent)
+{
+  GstQuery *query;
+  gboolean pull_mode;
+
+  /* messages are only delimited by the buffers upstream pushes */
+  GST_OBJECT_LOCK (parent);
+  pull_mode = !GST_GZDEC (parent)->messages;
+  GST_OBJECT_UNLOCK (parent);
+  if (!pull_mode)
+    goto activate_push;
+
+  query = gst_query_new_scheduling ();
+  if (!gst_pad_peer_query (pad, query)) {
+    gst_query_unref (query);
+    goto activate_push;
+  }
+
+  pull_mode = gst_query_has_scheduling_mode_with_flags (query,
+      GST_PAD_MODE_PULL, GST_SCHEDULING_FLAG_SEEKABLE);
+  gst_query_unref (query);
+
+  if (!pull_mode)
+    goto activate_push;
+
+  GST_DEBUG_OBJECT (parent, "activating in pull mode");
+  return gst_pad_activate_mode (pad, GST_PAD_MODE_PULL, TRUE);
+
+activate_push:
+  {
+    GST_DEBUG_OBJECT (parent, "activating in push mode");
+    return gst_pad_activate_mode (pad, GST_PAD_MODE_PUSH, TRUE);
+  }
+}
+
+static gboolean
+gst_gzdec_sink_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  Gstgzdec *filter = GST_GZDEC (parent);
+
+  switch (mode) {
+    case GST_PAD_MODE_PUSH:
+      return TRUE;
+    case GST_PAD_MODE_PULL:
+      filter->pulling = active;
+      if (!active)
+        return gst_pad_stop_task (pad);
+
+      filter->in_pos = 0;
+      filter->in_eos = FALSE;
+      filter->need_stream_start = TRUE;
+      filter->need_segment = TRUE;
+      /* downstream drives us through getrange */
+      if (filter->src_pulling)
+        return TRUE;
+      return gst_gzdec_start_loop (filter);
+    default:
+      return FALSE;
+  }
+}
+
+static gboolean
+gst_gzdec_src_activate_mode (GstPad * pad, GstObject * parent,
+    GstPadMode mode, gboolean active)
+{
+  Gstgzdec *filter = GST_GZDEC (parent);
+
+  switch (mode) {
+    case GST_PAD_MODE_PUSH:
+      return TRUE;
+    case GST_PAD_MODE_PULL:
+      /* getrange may come before our own READY->PAUSED */
+      if (active) {
+        GST_PAD_STREAM_LOCK (filter->sinkpad);
+        if (!gst_gzdec_open (filter)) {
+          GST_PAD_STREAM_UNLOCK (filter->sinkpad);
+          return FALSE;
+        }
+        GST_PAD_STREAM_UNLOCK (filter->sinkpad);
+      }
+      /* being pulled from means pulling from upstream, without a task */
+      filter->src_pulling = active;
+      if (!gst_pad_activate_mode (filter->sinkpad, GST_PAD_MODE_PULL, active)) {
+        filter->src_pulling = FALSE;
+        return FALSE;
+      }
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+/* pick the output buffer size for the next input buffer: what it is
+ * expected to decode to at the ratio seen so far, within
+ * min/max-output-size. For live input that is all one push has to hold,
+ * otherwise we round up for headroom. The pool is only renegotiated when
+ * the size is off by more than a factor of two. */
+static void
+gst_gzdec_update_output_size (Gstgzdec * filter, gsize in_size)
+{
+  guint min_size, max_size, size;
+  guint64 expected;
+
+  GST_OBJECT_LOCK (filter);
+  min_size = filter->min_output_size;
+  max_size = MAX (filter->max_output_size, min_size);
+  GST_OBJECT_UNLOCK (filter);
+
+  /* ask downstream: a sink that syncs to the clock takes the output as
+   * it plays, big buffers would only add to its latency */
+  if (filter->output_size == 0) {
+    GstQuery *query = gst_query_new_latency ();
+
+    filter->live = FALSE;
+    if (gst_pad_peer_query (filter->srcpad, query))
+      gst_query_parse_latency (query, &filter->live, NULL, NULL);
+    gst_query_unref (query);
+  }
+
+  filter->bytes_in += in_size;
+  if (filter->bytes_in > in_size && filter->offset > 0)
+    expected = gst_util_uint64_scale (in_size, filter->offset,
+        filter->bytes_in - in_size);
+  else
+    expected = (guint64) in_size * GZDEC_INITIAL_RATIO;
+
+  size = (guint) CLAMP (expected, min_size, max_size);
+  if (!filter->live && size < (1u << 31))
+    size = MIN (1u << g_bit_storage (size - 1), max_size);
+  /* a BGZF block has to fit into one buffer */
+  if (filter->workers)
+    size = MAX (size, GZDEC_BGZF_MAX_ISIZE);
+
+  if (filter->output_size != 0 && size <= filter->output_size * 2 &&
+      size >= filter->output_size / 2)
+    return;
+
+  GST_DEBUG_OBJECT (filter, "output buffer size %u -> %u%s",
+      filter->output_size, size, filter->live ? " (live)" : "");
+  filter->output_size = size;
+  gst_pad_mark_reconfigure (filter->srcpad);
+}
+
+static void
+gst_gzdec_post_stats (Gstgzdec * filter)
+{
+  GstStructure *stats;
+
+  stats = gst_gz_stats_to_structure (&filter->stats, "gzdec-stats");
+  gst_element_post_message (GST_ELEMENT (filter),
+      gst_message_new_element (GST_OBJECT (filter), stats));
+}
+
+/* add what one input buffer cost to the stats, posting them when
+ * stats-interval is due */
+static void
+gst_gzdec_account (Gstgzdec * filter, gsize in_size, GstClockTime start)
+{
+  GstClockTime now = gst_util_get_timestamp ();
+  guint interval;
+
+  gst_gz_stats_add_buffer (&filter->stats, in_size, filter->cur_out,
+      filter->cur_allocations, now - start, filter->cur_push_time);
+  filter->cur_out = 0;
+  filter->cur_allocations = 0;
+  filter->cur_push_time = 0;
+
+  GST_OBJECT_LOCK (filter);
+  interval = filter->stats_interval;
+  GST_OBJECT_UNLOCK (filter);
+
+  if (interval > 0 && now - filter->stats_last >= interval * GST_MSECOND) {
+    filter->stats_last = now;
+    gst_gzdec_post_stats (filter);
+  }
+}
+
+/* decode one buffer of compressed input, pushed or pulled */
+static GstFlowReturn
+gst_gzdec_handle_buffer (Gstgzdec * filter, GstBuffer * buf)
+{
+  GstClockTime start = gst_util_get_timestamp ();
+  gsize in_size = gst_buffer_get_size (buf);
+  GstFlowReturn flow;
+
+  /* anything after the end of the gzip stream is ignored */
+  if (filter->stream_end) {
+    GST_LOG_OBJECT (filter, "dropping %" G_GSIZE_FORMAT " bytes after the "
+        "end of the stream", gst_buffer_get_size (buf));
+    gst_buffer_unref (buf);
+    return GST_FLOW_OK;
+  }
+
+  gst_gzdec_track_rate (filter, buf);
+  gst_gzdec_check_index_head (filter, buf);
+  gst_gzdec_update_output_size (filter, in_size);
+  filter->limit_in += in_size;
+  if (!filter->name_done)
+    gst_gzdec_sniff_name (filter, buf);
+
+  if (filter->mode != GST_GZDEC_MODE_SERIAL) {
+    flow = gst_gzdec_parallel_chain (filter, buf);
+  } else {
+    /* output buffers are pushed from inside the decode loop */
+    flow = gst_gzdec_process_data (filter, buf);
+    gst_buffer_unref (buf);
+  }
+
+  gst_gzdec_account (filter, in_size, start);
+
+  return flow;
+}
+
+
+/* entry point to initialize the plug-in
+ * initialize the plug-in itself
+ * register the element factories and other features
+ */
+static gboolean
+gzdec_init (GstPlugin * gzdec)
+{
+  /* debug category for filtering log messages */
+  GST_DEBUG_CATEGORY_INIT (gst_gzdec_debug, "gzdec",
+      0, "gzip decoder plugin");
+
+  GST_INFO ("inflate backend: %s", gst_gz_backend_get_name ());
+
+  /* marginal, so decodebin plugs us for compressed files */
+  if (!gst_element_register (gzdec, "gzdec", GST_RANK_MARGINAL,
+          GST_TYPE_GZDEC))
+    return FALSE;
+
+  if (!gst_element_register (gzdec, "gzenc", GST_RANK_NONE,
+          GST_TYPE_GZENC))
+    return FALSE;
+
+  if (!gst_element_register (gzdec, "gzfiledec", GST_RANK_NONE,
+          GST_TYPE_GZFILEDEC))
+    return FALSE;
 
-  return gst_element_register (gzdec, "gzdec", GST_RANK_NONE,
-      GST_TYPE_GZDEC);
+  return gst_element_register (gzdec, "gztransform", GST_RANK_NONE,
+      GST_TYPE_GZTRANSFORM);
 }
 
 /* PACKAGE: this is usually set by autotools depending on some _INIT macro
@@ -419,7 +4436,7 @@ GST_PLUGIN_DEFINE (
     GST_VERSION_MAJOR,
     GST_VERSION_MINOR,
     gzdec,
-    "gzip decoder plugin",
+    "gzip decoder and encoder plugin",
     gzdec_init,
     VERSION,
     "LGPL",
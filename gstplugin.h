@@ -48,11 +48,18 @@
 #define __GST_GZDEC_H__
 
 #include <gst/gst.h>
+#include <gst/base/gstadapter.h>
 #include <zlib.h>
 #include <string.h>
 
-/* unit of decoding. 256k is the best as zlib said. */
-#define CHUNK (1024 * 256)
+#include "gstgzaffinity.h"
+#include "gstgzbackend.h"
+#include "gstgzformat.h"
+#include "gstgzindex.h"
+#include "gstgzqueue.h"
+#include "gstgzstats.h"
+#include "gstgzverify.h"
+#include "gstgzworkers.h"
 
 G_BEGIN_DECLS
 
@@ -68,6 +75,48 @@ G_BEGIN_DECLS
 #define GST_IS_GZDEC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_GZDEC))
 
+typedef enum
+{
+  GST_GZDEC_MODE_PROBE,         /* waiting for enough input to detect BGZF */
+  GST_GZDEC_MODE_SERIAL,        /* plain streaming inflate */
+  GST_GZDEC_MODE_BGZF,          /* BGZF blocks decoded in parallel */
+  GST_GZDEC_MODE_MEMBERS        /* guessed gzip members decoded in parallel */
+} GstGzdecMode;
+
+/* when output is pushed before its buffer is full */
+typedef enum
+{
+  GST_GZDEC_FLUSH_NONE,         /* only full buffers and the stream end */
+  GST_GZDEC_FLUSH_SYNC,         /* input ending on a deflate block boundary */
+  GST_GZDEC_FLUSH_PER_BUFFER    /* the end of every input buffer */
+} GstGzdecFlushMode;
+
+/* how the CRC32 and length in the gzip trailer are checked */
+typedef enum
+{
+  GST_GZDEC_VERIFY_FULL,        /* by inflate, as it decodes */
+  GST_GZDEC_VERIFY_DEFERRED,    /* on a helper thread, after pushing */
+  GST_GZDEC_VERIFY_NONE         /* not at all */
+} GstGzdecVerify;
+
+/* what to do with data after a gzip member that is not another member */
+typedef enum
+{
+  GST_GZDEC_TRAILING_CONTINUE,  /* skip to the next member header */
+  GST_GZDEC_TRAILING_STOP,      /* ignore the rest of the input */
+  GST_GZDEC_TRAILING_ERROR
+} GstGzdecTrailing;
+
+/* where in a gzip member decoding is when the framing is parsed by us
+ * instead of inflate */
+typedef enum
+{
+  GST_GZDEC_FRAMING_NONE,       /* inflate handles the whole stream */
+  GST_GZDEC_FRAMING_HEADER,
+  GST_GZDEC_FRAMING_BODY,       /* raw inflate */
+  GST_GZDEC_FRAMING_TRAILER
+} GstGzdecFraming;
+
 typedef struct _Gstgzdec      Gstgzdec;
 typedef struct _GstgzdecClass GstgzdecClass;
 
@@ -78,17 +127,186 @@ struct _Gstgzdec
   GstPad *sinkpad, *srcpad;
 
   gboolean silent;
-};
 
-struct ll_buffer {
-  guchar *data;
-  gulong len;
-  struct ll_buffer *next;
+  /* inflate state, taken from the shared pool in READY->PAUSED and given
+   * back in PAUSED->READY. Streams within that are restarted with
+   * inflateReset2(). */
+  z_stream *stream;
+  gboolean decoder_ready;
+  /* gst_gzdec_open() ran, by READY->PAUSED or by src pull activation */
+  gboolean opened;
+
+  /* inflate reported Z_STREAM_END, wait for EOS */
+  gboolean stream_end;
+  /* a gzip member ended, the next bytes tell whether another follows */
+  gboolean member_end;
+  guint8 next_magic[3];
+  guint next_magic_len;
+  GstGzdecTrailing trailing;
+
+  /* pool negotiated with downstream that inflate writes into */
+  GstBufferPool *pool;
+  /* decoded offset of the next output byte, used for the output buffer
+   * offsets */
+  guint64 offset;
+
+  /* upper bound of output memory outstanding downstream, 0 = unlimited */
+  guint64 max_output_memory;
+  /* output buffer size bounds and the size the pool currently hands out,
+   * 0 until the first input was seen */
+  guint min_output_size;
+  guint max_output_size;
+  guint output_size;
+  /* compressed bytes seen, against offset this gives the ratio */
+  guint64 bytes_in;
+  /* input bytes before the latest timestamp and the stream time since the
+   * first one, for the latency query, and the most we hold in compressed
+   * bytes. Protected by the object lock. */
+  GstClockTime rate_start;
+  GstClockTime rate_time;
+  guint64 rate_bytes;
+  guint64 rate_total;
+  guint64 rate_held;
+  /* downstream syncs to the clock, keep output buffers small */
+  gboolean live;
+
+  GstGzdecFlushMode flush_mode;
+  /* partly filled output buffer waiting for more input, mapped for inflate */
+  GstBuffer *outbuf;
+  GstMapInfo outmap;
+
+  /* format of the current stream, picked from its first bytes, and the
+   * one upstream caps named */
+  GstGzFormat format;
+  GstGzFormat caps_format;
+  /* what was sniffed, kept across the reset of a seek */
+  GstGzFormat stream_format;
+  guint8 magic[GST_GZ_FORMAT_MAGIC_SIZE];
+  guint magic_len;
+  /* decoder for the formats zlib doesn't handle */
+  GstGzStreamDecoder *decoder;
+
+  /* trailer checking. Unless it is full, gzip headers and trailers are
+   * parsed here and the body decoded with raw inflate, which keeps no
+   * CRC32. */
+  GstGzdecVerify verify;
+  GstGzdecFraming framing;
+  GstGzHeader header;
+  guint8 trailer[GST_GZ_TRAILER_SIZE];
+  guint trailer_len;
+  /* NULL unless verify is deferred. checking is set while the member
+   * being decoded was announced to it, verify_pos counts the decoded
+   * bytes handed to it. */
+  GstGzVerify *verifier;
+  gboolean checking;
+  guint64 verify_pos;
+
+  /* counters since READY->PAUSED, and the last time they were posted */
+  GstGzStats stats;
+  guint stats_interval;
+  GstClockTime stats_last;
+  /* what the input buffer being decoded produced so far */
+  guint64 cur_out;
+  guint cur_allocations;
+  GstClockTime cur_push_time;
+
+  /* parallel BGZF decoding, only set up when threads != 1 */
+  guint threads;
+  GstGzWorkers *workers;
+  GstAdapter *adapter;
+  GstGzdecMode mode;
+  /* job collecting blocks and the decoded size of those blocks */
+  GstGzJob *job;
+  gsize job_size;
+  /* member-lookahead, how far the adapter was searched for the next member
+   * header, and jobs to decode again after a wrong guess */
+  guint64 member_lookahead;
+  guint64 cur_member_lookahead;
+  gsize scan_pos;
+  gboolean mispredicted;
+  GQueue replay;
+
+  /* seek checkpoints, only kept with index-interval > 0 */
+  guint64 index_interval;
+  gchar *index_location;
+  /* preset dictionary properties, and the one in use until PAUSED->READY */
+  GBytes *dictionary;
+  gchar *dictionary_location;
+  GBytes *cur_dictionary;
+
+  /* every input buffer is a message of its own, and the windowBits the
+   * inflate state was last reset for */
+  gboolean messages;
+  gboolean cur_messages;
+  gint message_bits;
+  /* cpu-set and numa-node, resolved until PAUSED->READY, and what the
+   * streaming task's thread had before the loop bound it */
+  gchar *cpu_set;
+  gint numa_node;
+  GstGzAffinity *affinity;
+  GstGzAffinitySaved *affinity_saved;
+  /* decoded buffers waiting for the push thread, NULL when the decoding
+   * thread pushes */
+  guint max_queued_buffers;
+  guint64 max_queued_bytes;
+  GstGzQueue *queue;
+  /* max-output-bytes and max-ratio, and the compressed and decoded bytes of
+   * the stream they are held against */
+  guint64 max_output_bytes;
+  gdouble max_ratio;
+  guint64 limit_in;
+  guint64 limit_out;
+  /* the caps of the decoded data went out, the segment waiting for them,
+   * and the FNAME of the gzip header with what was collected to find it */
+  gboolean caps_sent;
+  GstEvent *pending_segment;
+  gchar *file_name;
+  GByteArray *name_head;
+  gboolean name_done;
+  GstGzIndex *index;
+  /* the sidecar as loaded, used only once the head of the input matched
+   * it, and the index decoding started with until then */
+  GstGzIndex *loaded_index;
+  GstGzIndex *head_index;
+  gboolean index_checked;
+  guint32 head_crc;
+  gsize head_len;
+  guint8 *window;
+  /* compressed and decoded offsets where the current inflate run started */
+  guint64 in_offset;
+  guint64 out_base;
+  /* decoded bytes still to drop before the seek target */
+  guint64 skip;
+  /* checkpoint to restart raw inflate from on the next input */
+  const GstGzCheckpoint *resume;
+  /* seek sent upstream, picked up by the FLUSH_STOP it causes */
+  gboolean seek_pending;
+  const GstGzCheckpoint *seek_point;
+  guint64 seek_target;
+  guint64 seek_in;
+  /* start of the decoded BYTES segment we push */
+  guint64 segment_start;
+
+  /* pull mode: the sink pad pulls, from our task or for src getrange */
+  gboolean pulling;
+  gboolean src_pulling;
+  /* next compressed offset to read and whether upstream ran out */
+  guint64 in_pos;
+  gboolean in_eos;
+  gboolean need_stream_start;
+  gboolean need_segment;
+  /* decoded data not yet handed out through getrange */
+  GstAdapter *out_adapter;
 };
 
-gint init_decoder (void);
-void deinit_decoder (void);
-gint decode_message (const guchar * srcmsg, const gint srclen, guchar ** outmsg, gulong * outlen);
+gint init_decoder (Gstgzdec * filter);
+void reset_decoder (Gstgzdec * filter);
+void deinit_decoder (Gstgzdec * filter);
+/* Feeds srcmsg to the inflate state of filter and pushes the decoded data
+ * downstream, one pooled buffer at a time. Sets stream_end once the gzip
+ * trailer has been seen. */
+GstFlowReturn decode_message (Gstgzdec * filter, const guchar * srcmsg,
+    const gsize srclen);
 struct _GstgzdecClass
 {
   GstElementClass parent_class;
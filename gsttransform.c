@@ -1,7 +1,29 @@
 /*
  * GStreamer
- * Copyright (C) 2006 Stefan Kost <ensonic@users.sf.net>
- * Copyright (C) YEAR AUTHOR_NAME AUTHOR_EMAIL
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
  *
  * This library is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Library General Public
@@ -20,48 +42,46 @@
  */
 
 /**
- * SECTION:element-plugin
+ * SECTION:element-gztransform
+ *
+ * gzdec built on #GstBaseTransform. Decodes gzip, zlib and raw deflate
+ * input, with concatenated members decoded one after the other, into
+ * buffers from the pool negotiated with downstream. The output caps are
+ * typefound from the decoded data.
  *
- * FIXME:Describe plugin here.
+ * Input that is neither announced as nor sniffed to be deflate based is
+ * not decoded: the element switches to passthrough and forwards the
+ * buffers untouched, so it can sit in front of files that may or may not
+ * be compressed without costing anything for the plain ones. Use gzdec
+ * for the other compressed formats.
+ *
+ * Decoded data gets no QoS handling: dropping compressed input would
+ * corrupt everything after it, so late buffers are decoded all the same.
+ * A stream that ends before the trailer of its last member is an error.
  *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
- * gst-launch -v -m fakesrc ! plugin ! fakesink silent=TRUE
+ * gst-launch -v -m filesrc location=file.txt.gz ! gztransform ! filesink location="file.txt"
  * ]|
  * </refsect2>
  */
 
 #ifdef HAVE_CONFIG_H
-#include "config.h"
+#  include <config.h>
 #endif
 
-#include <gst/gst.h>
-#include <gst/base/base.h>
-#include <gst/controller/controller.h>
+#include <gst/base/gsttypefindhelper.h>
 
+#include "gstgzbackend.h"
 #include "gsttransform.h"
 
-GST_DEBUG_CATEGORY_STATIC (gst_plugin_template_debug);
-#define GST_CAT_DEFAULT gst_plugin_template_debug
-
-/* Filter signals and args */
-enum
-{
-  /* FILL ME */
-  LAST_SIGNAL
-};
+GST_DEBUG_CATEGORY_STATIC (gst_gztransform_debug);
+#define GST_CAT_DEFAULT gst_gztransform_debug
 
-enum
-{
-  PROP_0,
-  PROP_SILENT,
-};
+/* output buffer size when downstream does not ask for larger ones */
+#define DEFAULT_BLOCKSIZE (256 * 1024)
 
-/* the capabilities of the inputs and outputs.
- *
- * FIXME:describe the real formats here.
- */
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -74,139 +94,558 @@ static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
     GST_STATIC_CAPS ("ANY")
     );
 
-#define gst_plugin_template_parent_class parent_class
-G_DEFINE_TYPE (GstPluginTemplate, gst_plugin_template, GST_TYPE_BASE_TRANSFORM);
-GST_ELEMENT_REGISTER_DEFINE (plugin_template, "plugin_template", GST_RANK_NONE,
-    GST_TYPE_PLUGIN_TEMPLATE);
-
-static void gst_plugin_template_set_property (GObject * object,
-    guint prop_id, const GValue * value, GParamSpec * pspec);
-static void gst_plugin_template_get_property (GObject * object,
-    guint prop_id, GValue * value, GParamSpec * pspec);
-
-static GstFlowReturn gst_plugin_template_transform_ip (GstBaseTransform *
-    base, GstBuffer * outbuf);
+#define gst_gztransform_parent_class parent_class
+G_DEFINE_TYPE (Gstgztransform, gst_gztransform, GST_TYPE_BASE_TRANSFORM);
+
+static void gst_gztransform_finalize (GObject * object);
+
+static gboolean gst_gztransform_start (GstBaseTransform * trans);
+static gboolean gst_gztransform_stop (GstBaseTransform * trans);
+static GstCaps *gst_gztransform_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter_caps);
+static gboolean gst_gztransform_transform_size (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, gsize size,
+    GstCaps * othercaps, gsize * othersize);
+static gboolean gst_gztransform_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_gztransform_decide_allocation (GstBaseTransform * trans,
+    GstQuery * query);
+static GstFlowReturn gst_gztransform_submit_input_buffer (GstBaseTransform *
+    trans, gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_gztransform_generate_output (GstBaseTransform *
+    trans, GstBuffer ** outbuf);
 
-/* GObject vmethod implementations */
-
-/* initialize the plugin's class */
 static void
-gst_plugin_template_class_init (GstPluginTemplateClass * klass)
+gst_gztransform_class_init (GstgztransformClass * klass)
 {
   GObjectClass *gobject_class;
   GstElementClass *gstelement_class;
+  GstBaseTransformClass *gstbasetransform_class;
 
   gobject_class = (GObjectClass *) klass;
   gstelement_class = (GstElementClass *) klass;
+  gstbasetransform_class = (GstBaseTransformClass *) klass;
 
-  gobject_class->set_property = gst_plugin_template_set_property;
-  gobject_class->get_property = gst_plugin_template_get_property;
-
-  g_object_class_install_property (gobject_class, PROP_SILENT,
-      g_param_spec_boolean ("silent", "Silent", "Produce verbose output ?",
-          FALSE, G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE));
+  gobject_class->finalize = gst_gztransform_finalize;
 
-  gst_element_class_set_details_simple (gstelement_class,
-      "Plugin",
-      "Generic/Filter",
-      "FIXME:Generic Template Filter", "AUTHOR_NAME AUTHOR_EMAIL");
+  gst_element_class_set_details_simple(gstelement_class,
+    "gzip transform decoder",
+    "Codec/Decoder",
+    "Decodes deflate based streams, passes anything else through",
+    "Sebastian Ovelar <<sebastianrovelar@gmail.com>>");
 
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&src_template));
   gst_element_class_add_pad_template (gstelement_class,
       gst_static_pad_template_get (&sink_template));
 
-  GST_BASE_TRANSFORM_CLASS (klass)->transform_ip =
-      GST_DEBUG_FUNCPTR (gst_plugin_template_transform_ip);
+  gstbasetransform_class->start = GST_DEBUG_FUNCPTR (gst_gztransform_start);
+  gstbasetransform_class->stop = GST_DEBUG_FUNCPTR (gst_gztransform_stop);
+  gstbasetransform_class->transform_caps =
+      GST_DEBUG_FUNCPTR (gst_gztransform_transform_caps);
+  gstbasetransform_class->transform_size =
+      GST_DEBUG_FUNCPTR (gst_gztransform_transform_size);
+  gstbasetransform_class->sink_event =
+      GST_DEBUG_FUNCPTR (gst_gztransform_sink_event);
+  gstbasetransform_class->decide_allocation =
+      GST_DEBUG_FUNCPTR (gst_gztransform_decide_allocation);
+  gstbasetransform_class->submit_input_buffer =
+      GST_DEBUG_FUNCPTR (gst_gztransform_submit_input_buffer);
+  gstbasetransform_class->generate_output =
+      GST_DEBUG_FUNCPTR (gst_gztransform_generate_output);
+
+  GST_DEBUG_CATEGORY_INIT (gst_gztransform_debug, "gztransform", 0,
+      "gzip decoder on GstBaseTransform");
+}
 
-  /* debug category for fltering log messages
-   *
-   * FIXME:exchange the string 'Template plugin' with your description
-   */
-  GST_DEBUG_CATEGORY_INIT (gst_plugin_template_debug, "plugin", 0,
-      "Template plugin");
+static void
+gst_gztransform_init (Gstgztransform * filter)
+{
+  g_queue_init (&filter->pending_events);
+  filter->output_size = DEFAULT_BLOCKSIZE;
+  gst_allocation_params_init (&filter->params);
 }
 
-/* initialize the new element
- * initialize instance structure
- */
 static void
-gst_plugin_template_init (GstPluginTemplate * filter)
+gst_gztransform_drop_input (Gstgztransform * filter)
 {
-  filter->silent = FALSE;
+  if (!filter->input)
+    return;
+
+  gst_buffer_unmap (filter->input, &filter->input_map);
+  gst_buffer_unref (filter->input);
+  filter->input = NULL;
 }
 
 static void
-gst_plugin_template_set_property (GObject * object, guint prop_id,
-    const GValue * value, GParamSpec * pspec)
+gst_gztransform_clear_allocation (Gstgztransform * filter)
 {
-  GstPluginTemplate *filter = GST_PLUGIN_TEMPLATE (object);
+  if (filter->pool) {
+    gst_buffer_pool_set_active (filter->pool, FALSE);
+    gst_object_unref (filter->pool);
+    filter->pool = NULL;
+  }
+  if (filter->allocator) {
+    gst_object_unref (filter->allocator);
+    filter->allocator = NULL;
+  }
+  gst_allocation_params_init (&filter->params);
+  filter->output_size = DEFAULT_BLOCKSIZE;
+}
 
-  switch (prop_id) {
-    case PROP_SILENT:
-      filter->silent = g_value_get_boolean (value);
-      break;
-    default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
-      break;
+static void
+gst_gztransform_finalize (GObject * object)
+{
+  Gstgztransform *filter = GST_GZTRANSFORM (object);
+
+  g_queue_clear_full (&filter->pending_events,
+      (GDestroyNotify) gst_event_unref);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gboolean
+gst_gztransform_start (GstBaseTransform * trans)
+{
+  Gstgztransform *filter = GST_GZTRANSFORM (trans);
+
+  filter->mode = GST_GZTRANSFORM_UNDECIDED;
+  filter->format = GST_GZ_FORMAT_UNKNOWN;
+  filter->caps_sent = FALSE;
+  filter->member_done = FALSE;
+  filter->offset = 0;
+  gst_base_transform_set_passthrough (trans, FALSE);
+
+  return TRUE;
+}
+
+static gboolean
+gst_gztransform_stop (GstBaseTransform * trans)
+{
+  Gstgztransform *filter = GST_GZTRANSFORM (trans);
+
+  gst_gztransform_drop_input (filter);
+  if (filter->stream) {
+    gst_gz_inflate_release (filter->stream);
+    filter->stream = NULL;
+  }
+  g_queue_clear_full (&filter->pending_events,
+      (GDestroyNotify) gst_event_unref);
+  gst_gztransform_clear_allocation (filter);
+
+  return TRUE;
+}
+
+/* hands the held back events to GstBaseTransform, which negotiates on the
+ * caps event and forwards the rest */
+static void
+gst_gztransform_release_events (Gstgztransform * filter)
+{
+  GstEvent *event;
+
+  while ((event = g_queue_pop_head (&filter->pending_events)))
+    GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (GST_BASE_TRANSFORM
+        (filter), event);
+}
+
+static void
+gst_gztransform_set_mode (Gstgztransform * filter, GstGztransformMode mode,
+    GstGzFormat format)
+{
+  filter->mode = mode;
+  filter->format = format;
+
+  if (mode == GST_GZTRANSFORM_PASSTHROUGH) {
+    GST_INFO_OBJECT (filter, "input is not deflate based, passing through");
+    gst_base_transform_set_passthrough (GST_BASE_TRANSFORM (filter), TRUE);
+    gst_gztransform_release_events (filter);
+  } else {
+    GST_INFO_OBJECT (filter, "decoding %s", gst_gz_format_get_name (format));
   }
 }
 
+/* pushes caps typefound from the first decoded data, or NULL when there
+ * was none, then the events held back for them and sets up the pool the
+ * following buffers are decoded into. GstBaseTransform only queries
+ * allocation when it negotiates itself, which it never does here since
+ * the upstream caps say nothing about the output. */
 static void
-gst_plugin_template_get_property (GObject * object, guint prop_id,
-    GValue * value, GParamSpec * pspec)
+gst_gztransform_negotiate (Gstgztransform * filter, const guint8 * data,
+    gsize size)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (filter);
+  GstTypeFindProbability prob = GST_TYPE_FIND_NONE;
+  GstCaps *caps = NULL;
+  GstQuery *query;
+  GstEvent *event;
+
+  filter->caps_sent = TRUE;
+
+  if (size > 0)
+    caps = gst_type_find_helper_for_data (GST_OBJECT (filter), data, size,
+        &prob);
+  if (!caps)
+    caps = gst_caps_new_empty_simple ("application/octet-stream");
+
+  GST_DEBUG_OBJECT (filter, "decoded data is %" GST_PTR_FORMAT
+      " (probability %d)", caps, prob);
+  gst_pad_push_event (trans->srcpad, gst_event_new_caps (caps));
+
+  /* upstream's caps described the compressed data, drop them */
+  while ((event = g_queue_pop_head (&filter->pending_events))) {
+    if (GST_EVENT_TYPE (event) == GST_EVENT_CAPS)
+      gst_event_unref (event);
+    else
+      GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
+  }
+
+  query = gst_query_new_allocation (caps, TRUE);
+  if (!gst_pad_peer_query (trans->srcpad, query))
+    GST_DEBUG_OBJECT (filter, "downstream did not answer the allocation query");
+  GST_BASE_TRANSFORM_GET_CLASS (trans)->decide_allocation (trans, query);
+  gst_query_unref (query);
+  gst_caps_unref (caps);
+}
+
+static gboolean
+gst_gztransform_caps_are_deflate (GstCaps * caps)
+{
+  return gst_gz_format_is_deflate (gst_gz_format_from_caps (caps));
+}
+
+/* decoded data can be anything, so compressed caps map to ANY and
+ * upstream may send compressed data for whatever downstream takes */
+static GstCaps *
+gst_gztransform_transform_caps (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, GstCaps * filter_caps)
+{
+  GstCaps *res;
+
+  if (direction == GST_PAD_SINK) {
+    if (gst_gztransform_caps_are_deflate (caps))
+      res = gst_caps_new_any ();
+    else
+      res = gst_caps_ref (caps);
+  } else if (gst_caps_is_any (caps)) {
+    res = gst_caps_ref (caps);
+  } else {
+    res = gst_caps_copy (caps);
+    res = gst_caps_merge (res,
+        gst_caps_from_string (GST_GZ_FORMAT_DEFLATE_CAPS));
+  }
+
+  if (filter_caps) {
+    GstCaps *tmp = gst_caps_intersect_full (filter_caps, res,
+        GST_CAPS_INTERSECT_FIRST);
+
+    gst_caps_unref (res);
+    res = tmp;
+  }
+
+  return res;
+}
+
+/* every output buffer is output_size bytes, whatever came in. The other
+ * way round depends on the compression ratio. */
+static gboolean
+gst_gztransform_transform_size (GstBaseTransform * trans,
+    GstPadDirection direction, GstCaps * caps, gsize size,
+    GstCaps * othercaps, gsize * othersize)
 {
-  GstPluginTemplate *filter = GST_PLUGIN_TEMPLATE (object);
+  Gstgztransform *filter = GST_GZTRANSFORM (trans);
 
-  switch (prop_id) {
-    case PROP_SILENT:
-      g_value_set_boolean (value, filter->silent);
+  if (direction != GST_PAD_SINK)
+    return FALSE;
+
+  *othersize = filter->output_size;
+  return TRUE;
+}
+
+static gboolean
+gst_gztransform_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  Gstgztransform *filter = GST_GZTRANSFORM (trans);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      if (filter->mode == GST_GZTRANSFORM_UNDECIDED &&
+          gst_gztransform_caps_are_deflate (caps))
+        gst_gztransform_set_mode (filter, GST_GZTRANSFORM_DECODE,
+            gst_gz_format_from_caps (caps));
+
+      /* the output caps come from typefinding the decoded data */
+      if (filter->mode == GST_GZTRANSFORM_DECODE && filter->caps_sent) {
+        gst_event_unref (event);
+        return TRUE;
+      }
+      break;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      gst_gztransform_drop_input (filter);
+      if (filter->stream)
+        inflateReset (filter->stream);
+      filter->member_done = FALSE;
+      break;
+    case GST_EVENT_EOS:
+      if (filter->mode == GST_GZTRANSFORM_UNDECIDED)
+        gst_gztransform_set_mode (filter, GST_GZTRANSFORM_PASSTHROUGH,
+            GST_GZ_FORMAT_UNKNOWN);
+      if (filter->mode != GST_GZTRANSFORM_DECODE)
+        break;
+
+      /* a truncated stream must not pass as a complete one */
+      if (!filter->member_done) {
+        GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+            ("Unexpected end of %s stream",
+                gst_gz_format_get_name (filter->format)));
+        gst_event_unref (event);
+        return FALSE;
+      }
+      if (!filter->caps_sent)
+        gst_gztransform_negotiate (filter, NULL, 0);
       break;
     default:
-      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
+
+  /* keep the sticky event order: caps first, then segment and the rest */
+  if (filter->mode != GST_GZTRANSFORM_PASSTHROUGH && !filter->caps_sent &&
+      GST_EVENT_IS_STICKY (event) &&
+      GST_EVENT_TYPE (event) != GST_EVENT_STREAM_START &&
+      GST_EVENT_TYPE (event) != GST_EVENT_EOS) {
+    g_queue_push_tail (&filter->pending_events, event);
+    return TRUE;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
 }
 
-/* GstBaseTransform vmethod implementations */
+/* use downstream's pool when it offers one that takes our buffer size,
+ * a pool of our own otherwise */
+static gboolean
+gst_gztransform_decide_allocation (GstBaseTransform * trans, GstQuery * query)
+{
+  Gstgztransform *filter = GST_GZTRANSFORM (trans);
+  GstCaps *caps;
+  GstBufferPool *pool = NULL;
+  GstAllocator *allocator = NULL;
+  GstAllocationParams params;
+  GstStructure *config;
+  guint size = DEFAULT_BLOCKSIZE, min = 0, max = 0;
+
+  gst_gztransform_clear_allocation (filter);
+
+  gst_query_parse_allocation (query, &caps, NULL);
+  gst_allocation_params_init (&params);
+
+  if (gst_query_get_n_allocation_params (query) > 0)
+    gst_query_parse_nth_allocation_param (query, 0, &allocator, &params);
+  if (gst_query_get_n_allocation_pools (query) > 0) {
+    gst_query_parse_nth_allocation_pool (query, 0, &pool, &size, &min, &max);
+    /* don't let downstream shrink our decode unit */
+    size = MAX (size, DEFAULT_BLOCKSIZE);
+  }
+
+  if (pool) {
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, size, min, max);
+    gst_buffer_pool_config_set_allocator (config, allocator, &params);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      GST_DEBUG_OBJECT (filter, "downstream pool rejected our config");
+      gst_object_unref (pool);
+      pool = NULL;
+    }
+  }
+
+  if (!pool) {
+    pool = gst_buffer_pool_new ();
+    config = gst_buffer_pool_get_config (pool);
+    gst_buffer_pool_config_set_params (config, caps, size, min, max);
+    gst_buffer_pool_config_set_allocator (config, allocator, &params);
+    if (!gst_buffer_pool_set_config (pool, config)) {
+      gst_object_unref (pool);
+      pool = NULL;
+    }
+  }
+
+  if (pool && !gst_buffer_pool_set_active (pool, TRUE)) {
+    gst_object_unref (pool);
+    pool = NULL;
+  }
+
+  /* without a pool the buffers are allocated one by one */
+  GST_DEBUG_OBJECT (filter, "decoding into %u byte buffers from %"
+      GST_PTR_FORMAT, size, pool);
+
+  filter->pool = pool;
+  filter->allocator = allocator;
+  filter->params = params;
+  filter->output_size = size;
+
+  return TRUE;
+}
 
-/* this function does the actual processing
- */
 static GstFlowReturn
-gst_plugin_template_transform_ip (GstBaseTransform * base, GstBuffer * outbuf)
+gst_gztransform_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input)
 {
-  GstPluginTemplate *filter = GST_PLUGIN_TEMPLATE (base);
+  Gstgztransform *filter = GST_GZTRANSFORM (trans);
 
-  if (GST_CLOCK_TIME_IS_VALID (GST_BUFFER_TIMESTAMP (outbuf)))
-    gst_object_sync_values (GST_OBJECT (filter), GST_BUFFER_TIMESTAMP (outbuf));
+  if (filter->mode == GST_GZTRANSFORM_UNDECIDED) {
+    GstMapInfo map;
+    GstGzFormat format = GST_GZ_FORMAT_UNKNOWN;
 
-  if (filter->silent == FALSE)
-    g_print ("I'm plugged, therefore I'm in.\n");
+    if (gst_buffer_map (input, &map, GST_MAP_READ)) {
+      format = gst_gz_format_sniff (map.data, map.size);
+      gst_buffer_unmap (input, &map);
+    }
 
-  /* FIXME: do something interesting here.  This simply copies the source
-   * to the destination. */
+    if (gst_gz_format_is_deflate (format))
+      gst_gztransform_set_mode (filter, GST_GZTRANSFORM_DECODE, format);
+    else
+      gst_gztransform_set_mode (filter, GST_GZTRANSFORM_PASSTHROUGH, format);
+  }
+
+  if (filter->mode == GST_GZTRANSFORM_PASSTHROUGH)
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->submit_input_buffer (trans,
+        is_discont, input);
+
+  if (!filter->stream) {
+    gint window_bits = gst_gz_format_get_window_bits (filter->format);
+
+    filter->stream = gst_gz_inflate_acquire (window_bits, -1);
+    if (!filter->stream) {
+      gst_buffer_unref (input);
+      GST_ELEMENT_ERROR (filter, LIBRARY, INIT, (NULL),
+          ("Failed to set up the inflate state"));
+      return GST_FLOW_ERROR;
+    }
+  }
+
+  /* generate_output() used up the previous one before we get here */
+  gst_gztransform_drop_input (filter);
+  if (!gst_buffer_map (input, &filter->input_map, GST_MAP_READ)) {
+    gst_buffer_unref (input);
+    GST_ELEMENT_ERROR (filter, RESOURCE, READ, (NULL),
+        ("Failed to map the input buffer"));
+    return GST_FLOW_ERROR;
+  }
+  filter->input = input;
+  filter->input_ts = TRUE;
+  filter->stream->next_in = filter->input_map.data;
+  filter->stream->avail_in = filter->input_map.size;
 
   return GST_FLOW_OK;
 }
 
-
-/* entry point to initialize the plug-in
- * initialize the plug-in itself
- * register the element factories and other features
- */
-static gboolean
-plugin_init (GstPlugin * plugin)
+static GstFlowReturn
+gst_gztransform_alloc_output (Gstgztransform * filter, GstBuffer ** out)
 {
-  return GST_ELEMENT_REGISTER (plugin_template, plugin);
+  if (filter->pool)
+    return gst_buffer_pool_acquire_buffer (filter->pool, out, NULL);
+
+  *out = gst_buffer_new_allocate (filter->allocator, filter->output_size,
+      &filter->params);
+  return *out ? GST_FLOW_OK : GST_FLOW_ERROR;
 }
 
-/* gstreamer looks for this structure to register plugins
- *
- * FIXME:exchange the string 'Template plugin' with you plugin description
- */
-GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
-    GST_VERSION_MINOR,
-    plugin,
-    "plugin_template",
-    plugin_init,
-    PACKAGE_VERSION, GST_LICENSE, GST_PACKAGE_NAME, GST_PACKAGE_ORIGIN)
+/* called until it returns no buffer, one output block per call */
+static GstFlowReturn
+gst_gztransform_generate_output (GstBaseTransform * trans,
+    GstBuffer ** outbuf)
+{
+  Gstgztransform *filter = GST_GZTRANSFORM (trans);
+  z_stream *stream = filter->stream;
+  GstBuffer *out;
+  GstMapInfo map;
+  GstFlowReturn flow;
+  gsize written;
+  gint ret = Z_OK;
+
+  if (filter->mode == GST_GZTRANSFORM_PASSTHROUGH)
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->generate_output (trans,
+        outbuf);
+
+  *outbuf = NULL;
+  if (!filter->input)
+    return GST_FLOW_OK;
+
+  flow = gst_gztransform_alloc_output (filter, &out);
+  if (flow != GST_FLOW_OK) {
+    gst_gztransform_drop_input (filter);
+    return flow;
+  }
+
+  if (!gst_buffer_map (out, &map, GST_MAP_WRITE)) {
+    gst_buffer_unref (out);
+    gst_gztransform_drop_input (filter);
+    GST_ELEMENT_ERROR (filter, RESOURCE, WRITE, (NULL),
+        ("Failed to map the output buffer"));
+    return GST_FLOW_ERROR;
+  }
+
+  stream->next_out = map.data;
+  stream->avail_out = map.size;
+
+  while (stream->avail_in > 0 && stream->avail_out > 0) {
+    ret = inflate (stream, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      /* concatenated members decode as one stream */
+      inflateReset (stream);
+      filter->member_done = TRUE;
+      ret = Z_OK;
+    } else if (ret != Z_OK) {
+      break;
+    } else {
+      filter->member_done = FALSE;
+    }
+  }
+
+  written = map.size - stream->avail_out;
+  gst_buffer_unmap (out, &map);
+
+  if (ret != Z_OK && ret != Z_BUF_ERROR) {
+    gst_buffer_unref (out);
+    gst_gztransform_drop_input (filter);
+    GST_ELEMENT_ERROR (filter, STREAM, DECODE, (NULL),
+        ("inflate failed: %s", stream->msg ? stream->msg : "unknown error"));
+    return GST_FLOW_ERROR;
+  }
+
+  if (written == 0) {
+    gst_buffer_unref (out);
+    gst_gztransform_drop_input (filter);
+    return GST_FLOW_OK;
+  }
+
+  gst_buffer_set_size (out, written);
+
+  if (!filter->caps_sent) {
+    if (gst_buffer_map (out, &map, GST_MAP_READ)) {
+      gst_gztransform_negotiate (filter, map.data, map.size);
+      gst_buffer_unmap (out, &map);
+    } else {
+      gst_gztransform_negotiate (filter, NULL, 0);
+    }
+  }
+
+  /* the input timestamp goes on the first block decoded from it */
+  if (filter->input_ts) {
+    GST_BUFFER_PTS (out) = GST_BUFFER_PTS (filter->input);
+    GST_BUFFER_DTS (out) = GST_BUFFER_DTS (filter->input);
+    filter->input_ts = FALSE;
+  }
+  GST_BUFFER_OFFSET (out) = filter->offset;
+  filter->offset += written;
+  GST_BUFFER_OFFSET_END (out) = filter->offset;
+
+  if (stream->avail_in == 0)
+    gst_gztransform_drop_input (filter);
+
+  *outbuf = out;
+  return GST_FLOW_OK;
+}
@@ -1,8 +1,29 @@
-/* 
+/*
  * GStreamer
- * Copyright (C) 2006 Stefan Kost <ensonic@users.sf.net>
- * Copyright (C) 2020 Niels De Graef <niels.degraef@gmail.com>
- * Copyright (C) YEAR AUTHOR_NAME AUTHOR_EMAIL
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
  *
  * This library is free software; you can redistribute it and/or
  * modify it under the terms of the GNU Library General Public
@@ -19,25 +40,78 @@
  * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
  * Boston, MA 02111-1307, USA.
  */
- 
-#ifndef __GST_PLUGIN_TEMPLATE_H__
-#define __GST_PLUGIN_TEMPLATE_H__
+
+#ifndef __GST_GZTRANSFORM_H__
+#define __GST_GZTRANSFORM_H__
 
 #include <gst/gst.h>
 #include <gst/base/gstbasetransform.h>
+#include <zlib.h>
+
+#include "gstgzformat.h"
 
 G_BEGIN_DECLS
 
-#define GST_TYPE_PLUGIN_TEMPLATE (gst_plugin_template_get_type())
-G_DECLARE_FINAL_TYPE (GstPluginTemplate, gst_plugin_template,
-    GST, PLUGIN_TEMPLATE, GstBaseTransform)
+#define GST_TYPE_GZTRANSFORM \
+  (gst_gztransform_get_type())
+#define GST_GZTRANSFORM(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_GZTRANSFORM,Gstgztransform))
+#define GST_GZTRANSFORM_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_GZTRANSFORM,GstgztransformClass))
+#define GST_IS_GZTRANSFORM(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_GZTRANSFORM))
+#define GST_IS_GZTRANSFORM_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_GZTRANSFORM))
+
+typedef enum
+{
+  GST_GZTRANSFORM_UNDECIDED,    /* waiting for caps or the first buffer */
+  GST_GZTRANSFORM_DECODE,
+  GST_GZTRANSFORM_PASSTHROUGH   /* input is not deflate, forwarded as is */
+} GstGztransformMode;
+
+typedef struct _Gstgztransform      Gstgztransform;
+typedef struct _GstgztransformClass GstgztransformClass;
 
-struct _GstPluginTemplate {
-  GstBaseTransform element;
+struct _Gstgztransform
+{
+  GstBaseTransform parent;
 
-  gboolean silent;
+  GstGztransformMode mode;
+  GstGzFormat format;
+
+  /* NULL until the first buffer to decode */
+  z_stream *stream;
+
+  /* input buffer generate_output() is working through */
+  GstBuffer *input;
+  GstMapInfo input_map;
+  /* its timestamp still has to go on an output buffer */
+  gboolean input_ts;
+  /* inflate saw the trailer of the last member, nothing after it yet */
+  gboolean member_done;
+
+  /* sticky events held back until the output caps are known */
+  GQueue pending_events;
+  gboolean caps_sent;
+
+  /* from decide_allocation, NULL pool when allocating directly */
+  GstBufferPool *pool;
+  GstAllocator *allocator;
+  GstAllocationParams params;
+  guint output_size;
+
+  /* bytes pushed so far, used for the output buffer offsets */
+  guint64 offset;
+};
+
+struct _GstgztransformClass
+{
+  GstBaseTransformClass parent_class;
 };
 
+GType gst_gztransform_get_type (void);
+
 G_END_DECLS
 
-#endif /* __GST_PLUGIN_TEMPLATE_H__ */
+#endif /* __GST_GZTRANSFORM_H__ */
@@ -0,0 +1,468 @@
+/*
+ * GStreamer
+ * Copyright (C) 2023 Sebastian Ovelar <<sebastianrovelar@gmail.com>>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ *
+ * Alternatively, the contents of this file may be used under the
+ * GNU Lesser General Public License Version 2.1 (the "LGPL"), in
+ * which case the following provisions apply instead of the ones
+ * mentioned above:
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/*
+ * Benchmarks for gzdec: decode_message() called directly on a gzdec for
+ * each corpus and input buffer size, and a filesrc ! gzdec ! fakesink
+ * pipeline. Each run reports the decoded MB/s, the output buffers
+ * allocated per decoded MB and its peak RSS. Every run is a process of
+ * its own, so the peak RSS is that of the run alone.
+ *
+ * Run through "meson test --benchmark" or by hand:
+ *
+ *   gzdec-bench [--micro] [--pipeline] [--size MiB]
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+#include <zlib.h>
+
+#include "gstplugin.h"
+
+/* output buffer size for the micro benchmark, where no input buffer size
+ * policy runs */
+#define MICRO_OUTPUT_SIZE (256 * 1024)
+
+typedef struct
+{
+  const gchar *name;
+  gchar *path;
+} Corpus;
+
+static const gsize chunk_sizes[] = { 512, 4096, 65536, 1024 * 1024 };
+
+static const gchar *words[] = {
+  "the", "decoder", "stream", "buffer", "of", "and", "gzip", "pad",
+  "element", "to", "caps", "pipeline", "a", "in", "segment", "is",
+};
+
+/* decoded bytes that reached the micro benchmark's sink pad */
+static guint64 micro_bytes;
+
+static void
+fill_text (GRand * rand, guint8 * data, gsize size)
+{
+  gsize pos = 0;
+
+  while (pos < size) {
+    const gchar *word = words[g_rand_int_range (rand, 0, G_N_ELEMENTS (words))];
+    gsize len = MIN (strlen (word), size - pos);
+
+    memcpy (data + pos, word, len);
+    pos += len;
+    if (pos < size)
+      data[pos++] = g_rand_int_range (rand, 0, 12) ? ' ' : '\n';
+  }
+}
+/* fixed size records with a counter, a few small fields and some noise,
+ * compressing somewhere between text and random data */
+static void
+fill_binary (GRand * rand, guint8 * data, gsize size)
+{
+  gsize pos;
+
+  for (pos = 0; pos < size; pos++) {
+    switch (pos % 16) {
+      case 0:
+        data[pos] = (pos / 16) & 0xff;
+        break;
+      case 1:
+        data[pos] = ((pos / 16) >> 8) & 0xff;
+        break;
+      case 2:
+      case 3:
+        data[pos] = 0;
+        break;
+      case 4:
+        data[pos] = g_rand_int_range (rand, 0, 4);
+        break;
+      default:
+        data[pos] = g_rand_int_range (rand, 0, 64) ? data[pos - 1] :
+            g_rand_int (rand) & 0xff;
+        break;
+    }
+  }
+}
+
+static void
+fill_zeros (GRand * rand, guint8 * data, gsize size)
+{
+  memset (data, 0, size);
+}
+
+static void
+fill_random (GRand * rand, guint8 * data, gsize size)
+{
+  gsize pos;
+
+  for (pos = 0; pos < size; pos++)
+    data[pos] = g_rand_int (rand) & 0xff;
+}
+
+static GBytes *
+gzip_bytes (const guint8 * data, gsize size)
+{
+  z_stream strm = { 0, };
+  gsize bound;
+  guint8 *out;
+
+  if (deflateInit2 (&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+          Z_DEFAULT_STRATEGY) != Z_OK)
+    g_error ("deflateInit2 failed");
+
+  bound = deflateBound (&strm, size);
+  out = g_malloc (bound);
+  strm.next_in = (Bytef *) data;
+  strm.avail_in = size;
+  strm.next_out = out;
+  strm.avail_out = bound;
+  if (deflate (&strm, Z_FINISH) != Z_STREAM_END)
+    g_error ("deflate failed");
+  deflateEnd (&strm);
+
+  return g_bytes_new_take (g_realloc (out, strm.total_out), strm.total_out);
+}
+
+/* gzip the corpus into a temporary file for the runs to read */
+static void
+corpus_init (Corpus * corpus, const gchar * name,
+    void (*fill) (GRand *, guint8 *, gsize), gsize size)
+{
+  GRand *rand = g_rand_new_with_seed (0x677a6463);
+  guint8 *plain = g_malloc (size);
+  GError *err = NULL;
+  GBytes *packed;
+  const guint8 *data;
+  gsize packed_size;
+  gint fd;
+
+  fill (rand, plain, size);
+  packed = gzip_bytes (plain, size);
+  g_free (plain);
+  g_rand_free (rand);
+
+  fd = g_file_open_tmp ("gzdec-bench-XXXXXX.gz", &corpus->path, &err);
+  if (fd < 0)
+    g_error ("no temporary file: %s", err->message);
+  close (fd);
+  data = g_bytes_get_data (packed, &packed_size);
+  if (!g_file_set_contents (corpus->path, (const gchar *) data, packed_size,
+          &err))
+    g_error ("writing %s: %s", corpus->path, err->message);
+  g_bytes_unref (packed);
+
+  corpus->name = name;
+}
+
+static glong
+peak_rss_kib (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return -1;
+  return usage.ru_maxrss;
+}
+
+static void
+report (const gchar * bench, const gchar * name, gsize chunk,
+    guint64 bytes_out, guint64 allocations, GstClockTime elapsed)
+{
+  gdouble mb = bytes_out / (1024.0 * 1024.0);
+
+  g_print ("%-8s %-14s %8" G_GSIZE_FORMAT " %10.1f MB/s %8.2f allocs/MB "
+      "%8ld KiB peak rss\n", bench, name, chunk,
+      elapsed ? mb / ((gdouble) elapsed / GST_SECOND) : 0.0,
+      mb > 0 ? allocations / mb : 0.0, peak_rss_kib ());
+}
+
+static void
+wait_eos (GstElement * pipeline)
+{
+  GstBus *bus = gst_element_get_bus (pipeline);
+  GstMessage *msg;
+
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+    GError *err = NULL;
+
+    gst_message_parse_error (msg, &err, NULL);
+    g_error ("pipeline error: %s", err->message);
+  }
+
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+}
+
+static GstFlowReturn
+micro_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  micro_bytes += gst_buffer_get_size (buf);
+  gst_buffer_unref (buf);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+micro_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  gst_event_unref (event);
+
+  return TRUE;
+}
+
+/* feed the corpus to decode_message() in pieces of chunk bytes. The
+ * output goes to a bare pad that drops it, so the time is the decode and
+ * the pushes it does. */
+static void
+bench_micro (const gchar * name, const gchar * path, gsize chunk)
+{
+  Gstgzdec *filter;
+  GstPad *sinkpad;
+  GstSegment segment;
+  GstClockTime start, elapsed;
+  GstFlowReturn flow = GST_FLOW_OK;
+  GError *err = NULL;
+  gchar *data;
+  gsize size, pos;
+  guint64 decoded;
+
+  if (!g_file_get_contents (path, &data, &size, &err))
+    g_error ("reading %s: %s", path, err->message);
+
+  filter = g_object_ref_sink (g_object_new (GST_TYPE_GZDEC, NULL));
+  sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function (sinkpad, micro_chain);
+  gst_pad_set_event_function (sinkpad, micro_event);
+  gst_pad_set_active (sinkpad, TRUE);
+  gst_pad_link (filter->srcpad, sinkpad);
+
+  /* sets up the inflate state through init_decoder() */
+  if (gst_element_set_state (GST_ELEMENT (filter), GST_STATE_PAUSED) ==
+      GST_STATE_CHANGE_FAILURE)
+    g_error ("gzdec did not go to PAUSED");
+  filter->output_size = MICRO_OUTPUT_SIZE;
+
+  gst_pad_push_event (filter->srcpad, gst_event_new_stream_start (name));
+  gst_segment_init (&segment, GST_FORMAT_BYTES);
+  gst_pad_push_event (filter->srcpad, gst_event_new_segment (&segment));
+
+  start = gst_util_get_timestamp ();
+  for (pos = 0; pos < size && !filter->stream_end; pos += chunk) {
+    flow = decode_message (filter, (const guchar *) data + pos,
+        MIN (chunk, size - pos));
+    if (flow != GST_FLOW_OK)
+      g_error ("decode_message failed at %" G_GSIZE_FORMAT ": %s", pos,
+          gst_flow_get_name (flow));
+  }
+  elapsed = gst_util_get_timestamp () - start;
+
+  /* flush-mode may keep the last partial buffer */
+  decoded = micro_bytes;
+  if (filter->outbuf)
+    decoded += filter->stream->next_out - filter->outmap.data;
+  report ("micro", name, chunk, decoded, filter->cur_allocations, elapsed);
+
+  gst_element_set_state (GST_ELEMENT (filter), GST_STATE_NULL);
+  gst_pad_set_active (sinkpad, FALSE);
+  gst_object_unref (sinkpad);
+  gst_object_unref (filter);
+  g_free (data);
+}
+
+static void
+bench_pipeline (const gchar * name, const gchar * path)
+{
+  GstElement *pipeline, *dec;
+  GstClockTime start, elapsed;
+  GError *err = NULL;
+  guint64 bytes_out, allocations;
+  gchar *desc;
+
+  desc = g_strdup_printf ("filesrc location=\"%s\" ! gzdec name=dec ! "
+      "fakesink sync=false", path);
+  pipeline = gst_parse_launch (desc, &err);
+  if (!pipeline)
+    g_error ("pipeline: %s", err->message);
+  dec = gst_bin_get_by_name (GST_BIN (pipeline), "dec");
+
+  start = gst_util_get_timestamp ();
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  wait_eos (pipeline);
+  elapsed = gst_util_get_timestamp () - start;
+
+  g_object_get (dec, "bytes-out", &bytes_out, "allocations", &allocations,
+      NULL);
+  report ("pipeline", name, 0, bytes_out, allocations, elapsed);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (dec);
+  gst_object_unref (pipeline);
+  g_free (desc);
+}
+
+/* run one benchmark in a child process. The micro runs use the gzdec
+ * linked in, so they must not load the plugin with the same types from
+ * GST_PLUGIN_PATH or a registry scan. */
+static void
+spawn_run (const gchar * self, const gchar * run, const Corpus * corpus,
+    gsize chunk)
+{
+  gchar *chunk_str = g_strdup_printf ("%" G_GSIZE_FORMAT, chunk);
+  gchar *argv[] = { (gchar *) self, (gchar *) "--run", (gchar *) run,
+    (gchar *) "--corpus", (gchar *) corpus->name, (gchar *) "--file",
+    corpus->path, (gchar *) "--chunk", chunk_str, NULL
+  };
+  gchar **envp = g_get_environ ();
+  GError *err = NULL;
+  gint status;
+
+  if (strcmp (run, "micro") == 0) {
+    envp = g_environ_unsetenv (envp, "GST_PLUGIN_PATH");
+    envp = g_environ_setenv (envp, "GST_REGISTRY_UPDATE", "no", TRUE);
+  }
+
+  if (!g_spawn_sync (NULL, argv, envp, G_SPAWN_DEFAULT, NULL, NULL, NULL,
+          NULL, &status, &err))
+    g_error ("running %s: %s", self, err->message);
+#if GLIB_CHECK_VERSION (2, 70, 0)
+  if (!g_spawn_check_wait_status (status, &err))
+#else
+  if (!g_spawn_check_exit_status (status, &err))
+#endif
+    g_error ("%s %s %s: %s", run, corpus->name, chunk_str, err->message);
+
+  g_strfreev (envp);
+  g_free (chunk_str);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gboolean micro = FALSE, pipeline = FALSE;
+  gint size_mib = 16;
+  gchar *run = NULL, *corpus_name = NULL, *file = NULL;
+  gint64 chunk = 0;
+  GOptionEntry entries[] = {
+    {"micro", 0, 0, G_OPTION_ARG_NONE, &micro,
+        "Call decode_message() directly at several buffer sizes", NULL},
+    {"pipeline", 0, 0, G_OPTION_ARG_NONE, &pipeline,
+        "Run filesrc ! gzdec ! fakesink", NULL},
+    {"size", 0, 0, G_OPTION_ARG_INT, &size_mib,
+        "Decoded size of each corpus in MiB (default 16)", "MIB"},
+    /* one run, as the child processes are started */
+    {"run", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &run, NULL, NULL},
+    {"corpus", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_STRING, &corpus_name,
+        NULL, NULL},
+    {"file", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_FILENAME, &file, NULL,
+        NULL},
+    {"chunk", 0, G_OPTION_FLAG_HIDDEN, G_OPTION_ARG_INT64, &chunk, NULL,
+        NULL},
+    {NULL}
+  };
+  GOptionContext *ctx;
+  GError *err = NULL;
+  Corpus corpora[4];
+  gsize size;
+  guint i, j;
+
+  ctx = g_option_context_new ("- gzdec benchmarks");
+  g_option_context_add_main_entries (ctx, entries, NULL);
+  g_option_context_add_group (ctx, gst_init_get_option_group ());
+  if (!g_option_context_parse (ctx, &argc, &argv, &err)) {
+    g_printerr ("%s\n", err->message);
+    return 1;
+  }
+  g_option_context_free (ctx);
+
+  if (run) {
+    if (!corpus_name || !file) {
+      g_printerr ("--run needs --corpus and --file\n");
+      return 1;
+    }
+    if (strcmp (run, "micro") == 0 && chunk > 0)
+      bench_micro (corpus_name, file, (gsize) chunk);
+    else if (strcmp (run, "pipeline") == 0)
+      bench_pipeline (corpus_name, file);
+    else {
+      g_printerr ("unknown run %s\n", run);
+      return 1;
+    }
+    return 0;
+  }
+
+  if (size_mib <= 0) {
+    g_printerr ("--size must be positive\n");
+    return 1;
+  }
+  size = (gsize) size_mib * 1024 * 1024;
+
+  if (!micro && !pipeline)
+    micro = pipeline = TRUE;
+
+  corpus_init (&corpora[0], "text", fill_text, size);
+  corpus_init (&corpora[1], "binary", fill_binary, size);
+  corpus_init (&corpora[2], "compressible", fill_zeros, size);
+  corpus_init (&corpora[3], "incompressible", fill_random, size);
+
+  for (i = 0; i < G_N_ELEMENTS (corpora); i++) {
+    if (micro)
+      for (j = 0; j < G_N_ELEMENTS (chunk_sizes); j++)
+        spawn_run (argv[0], "micro", &corpora[i], chunk_sizes[j]);
+    if (pipeline)
+      spawn_run (argv[0], "pipeline", &corpora[i], 0);
+    g_unlink (corpora[i].path);
+    g_free (corpora[i].path);
+  }
+
+  return 0;
+}